@@ -0,0 +1,160 @@
+#include "AccumulationStore.h"
+#include "ErrorLog.h"
+#include "ImageWriter.h"
+#include "Utils.h"
+
+#include <glm/gtc/packing.hpp>
+
+#include <winioctl.h>
+
+#include <algorithm>
+
+AccumulationStore::~AccumulationStore()
+{
+	while (!Resident.empty())
+		UnmapTile(Resident.size() - 1);
+	if (Mapping)
+		CloseHandle(Mapping);
+	if (File != INVALID_HANDLE_VALUE)
+		CloseHandle(File);
+}
+
+bool AccumulationStore::Create(const std::string& path, const glm::uvec2& size, uint32_t tileSize)
+{
+	SYSTEM_INFO info{};
+	GetSystemInfo(&info);
+	TileSize = tileSize;
+	if (TileSize == 0 || GetTileBytes() % info.dwAllocationGranularity != 0)
+		return false;
+
+	Size = size;
+	TileCount = (Size + TileSize - 1u) / TileSize;
+	const uint64_t total = uint64_t(TileCount.x) * TileCount.y * GetTileBytes();
+
+	File = CreateFileW(string_2_wstring(path).c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+					   FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, nullptr);
+	if (File == INVALID_HANDLE_VALUE)
+		return false;
+
+	// Tiles that were never touched take no space and read as zero
+	DWORD returned = 0;
+	DeviceIoControl(File, FSCTL_SET_SPARSE, nullptr, 0, nullptr, 0, &returned, nullptr);
+
+	Mapping = CreateFileMappingW(File, nullptr, PAGE_READWRITE, static_cast<DWORD>(total >> 32),
+								 static_cast<DWORD>(total), nullptr);
+	return Mapping != nullptr;
+}
+
+void AccumulationStore::Accumulate(const glm::uvec2& origin, const glm::uvec2& size, const uint8_t* pixels,
+								   uint32_t rowPitch)
+{
+	const glm::uvec2 end = glm::min(origin + size, Size);
+	const glm::uvec2 first = origin / TileSize;
+	const glm::uvec2 last = (end + TileSize - 1u) / TileSize;
+	for (uint32_t ty = first.y; ty < last.y; ty++)
+	{
+		for (uint32_t tx = first.x; tx < last.x; tx++)
+		{
+			glm::vec4* tile = MapTile(ty * TileCount.x + tx);
+			const glm::uvec2 tileOrigin = glm::uvec2(tx, ty) * TileSize;
+			const glm::uvec2 from = glm::max(origin, tileOrigin);
+			const glm::uvec2 to = glm::min(end, tileOrigin + TileSize);
+
+			// Frames carry the mean of their samples and the sample count in alpha
+			for (uint32_t y = from.y; y < to.y; y++)
+			{
+				const glm::vec4* source = reinterpret_cast<const glm::vec4*>(pixels + size_t(y - origin.y) * rowPitch);
+				glm::vec4* target = tile + (y - tileOrigin.y) * TileSize;
+				for (uint32_t x = from.x; x < to.x; x++)
+				{
+					const glm::vec4& frame = source[x - origin.x];
+					target[x - tileOrigin.x] += glm::vec4(glm::vec3(frame) * frame.a, frame.a);
+				}
+			}
+		}
+	}
+}
+
+void AccumulationStore::Prefetch(const glm::uvec2& origin, const glm::uvec2& size)
+{
+	const glm::uvec2 end = glm::min(origin + size, Size);
+	const glm::uvec2 first = origin / TileSize;
+	const glm::uvec2 last = (end + TileSize - 1u) / TileSize;
+
+	// Half of the resident tiles at most, the ones in use must not be evicted for the prefetch
+	std::vector<WIN32_MEMORY_RANGE_ENTRY> ranges;
+	for (uint32_t ty = first.y; ty < last.y; ty++)
+	{
+		for (uint32_t tx = first.x; tx < last.x && ranges.size() < MaxResidentTiles / 2; tx++)
+			ranges.push_back(WIN32_MEMORY_RANGE_ENTRY{ MapTile(ty * TileCount.x + tx), GetTileBytes() });
+	}
+	if (!ranges.empty())
+		PrefetchVirtualMemory(GetCurrentProcess(), ranges.size(), ranges.data(), 0);
+}
+
+// Tiles are visited in the row-major order of the file and the next one is read ahead
+bool AccumulationStore::WriteExr(const std::string& path)
+{
+	TiledExrWriter writer(path, Size, TileSize);
+	if (!writer.IsOpen())
+		return false;
+
+	std::vector<glm::u16vec4> pixels(TileSize * TileSize);
+	for (uint32_t t = 0; t < TileCount.x * TileCount.y; t++)
+	{
+		const glm::uvec2 tile(t % TileCount.x, t / TileCount.x);
+		if (t + 1 < TileCount.x * TileCount.y)
+			Prefetch(glm::uvec2((t + 1) % TileCount.x, (t + 1) / TileCount.x) * TileSize, glm::uvec2(1));
+
+		const glm::vec4* sums = MapTile(t);
+		const glm::uvec2 extent = writer.GetTileExtent(tile);
+		for (uint32_t y = 0; y < extent.y; y++)
+		{
+			for (uint32_t x = 0; x < extent.x; x++)
+			{
+				const glm::vec4& sum = sums[y * TileSize + x];
+				const glm::vec3 mean = sum.a > 0.0f ? glm::vec3(sum) / sum.a : glm::vec3(0.0f);
+				pixels[y * TileSize + x] = glm::u16vec4(glm::packHalf1x16(mean.r), glm::packHalf1x16(mean.g),
+														glm::packHalf1x16(mean.b), glm::packHalf1x16(1.0f));
+			}
+		}
+		writer.WriteTile(tile, pixels.data(), TileSize);
+	}
+	return writer.Close();
+}
+
+// Evicts the least recently used tile once MaxResidentTiles are mapped
+glm::vec4* AccumulationStore::MapTile(uint32_t tile)
+{
+	UseCounter++;
+	auto resident = std::find_if(Resident.begin(), Resident.end(),
+								 [tile](const ResidentTile& entry) { return entry.Tile == tile; });
+	if (resident != Resident.end())
+	{
+		resident->LastUse = UseCounter;
+		return resident->View;
+	}
+
+	if (Resident.size() >= MaxResidentTiles)
+	{
+		auto oldest = std::min_element(Resident.begin(), Resident.end(),
+									   [](const ResidentTile& a, const ResidentTile& b) { return a.LastUse < b.LastUse; });
+		UnmapTile(oldest - Resident.begin());
+	}
+
+	const uint64_t offset = uint64_t(tile) * GetTileBytes();
+	void* view = MapViewOfFile(Mapping, FILE_MAP_ALL_ACCESS, static_cast<DWORD>(offset >> 32),
+							   static_cast<DWORD>(offset), GetTileBytes());
+	if (!view)
+		GRAPHICS_ASSERT(HRESULT_FROM_WIN32(GetLastError()));
+
+	Resident.push_back(ResidentTile{ .Tile = tile, .View = static_cast<glm::vec4*>(view), .LastUse = UseCounter });
+	return Resident.back().View;
+}
+
+void AccumulationStore::UnmapTile(size_t resident)
+{
+	UnmapViewOfFile(Resident[resident].View);
+	Resident[resident] = Resident.back();
+	Resident.pop_back();
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "Core.h"
+
+// Accumulation buffer of an image larger than memory, in a file mapped one tile at a time. A
+// tile is TileSize x TileSize RGBA32F pixels, RGB the sum of the frames added to the pixel and
+// A their count, and is contiguous in the file so that it maps to a view of its own. Only the
+// most recently used tiles stay mapped; an evicted tile is written back by the memory manager.
+// The file is scratch space, sparse and deleted once the store is destroyed
+struct AccumulationStore
+{
+	AccumulationStore() = default;
+	~AccumulationStore();
+	AccumulationStore(const AccumulationStore&) = delete;
+	AccumulationStore& operator=(const AccumulationStore&) = delete;
+
+	bool Create(const std::string& path, const glm::uvec2& size, uint32_t tileSize = DefaultTileSize);
+
+	// Adds a frame covering the region at origin, rows rowPitch bytes apart
+	void Accumulate(const glm::uvec2& origin, const glm::uvec2& size, const uint8_t* pixels, uint32_t rowPitch);
+	// Maps the tiles of a region that is up next and has the OS read them in the background
+	void Prefetch(const glm::uvec2& origin, const glm::uvec2& size);
+	// Mean of every pixel as a tiled EXR with the tiles of the store, one tile resident at a time
+	bool WriteExr(const std::string& path);
+
+	inline glm::uvec2 GetSize() const { return Size; }
+	inline uint32_t GetTileSize() const { return TileSize; }
+	inline glm::uvec2 GetTileCount() const { return TileCount; }
+
+	// 1MB tiles, a multiple of the 64KB granularity views of a mapping start at
+	static constexpr uint32_t DefaultTileSize = 256;
+	static constexpr uint32_t MaxResidentTiles = 256;
+
+private:
+	glm::vec4* MapTile(uint32_t tile);
+	void UnmapTile(size_t resident);
+	inline uint64_t GetTileBytes() const { return uint64_t(TileSize) * TileSize * sizeof(glm::vec4); }
+
+private:
+	struct ResidentTile
+	{
+		uint32_t Tile = 0;
+		glm::vec4* View = nullptr;
+		uint64_t LastUse = 0;
+	};
+
+	HANDLE File = INVALID_HANDLE_VALUE;
+	HANDLE Mapping = nullptr;
+	glm::uvec2 Size = glm::uvec2(0);
+	glm::uvec2 TileCount = glm::uvec2(0);
+	uint32_t TileSize = DefaultTileSize;
+	std::vector<ResidentTile> Resident;
+	uint64_t UseCounter = 0;
+};
@@ -37,9 +37,9 @@ int Application::Run()
 	}
 }
 
-void Application::Init(int width, int height, HINSTANCE instance, const char* title)
+void Application::Init(int width, int height, HINSTANCE instance, const char* title, const Scene& scene)
 {
-	Instance = new Application(width, height, instance, title);
+	Instance = new Application(width, height, instance, title, scene);
 }
 
 void Application::OnEvent(Event& e)
@@ -65,11 +65,90 @@ void Application::Tick()
 			MainWindow->Input.SetRawInput(false);
 		}
 	}
+	if (MainWindow->Input.IsKeyPressed(VK_F2))
+		GraphicsInterface->BenchmarkLightSampling();
+	if (MainWindow->Input.IsKeyPressed(VK_F3))
+		GraphicsInterface->ToggleLightSampling();
+	if (MainWindow->Input.IsKeyPressed(VK_F4))
+		GraphicsInterface->ToggleRestir();
+	if (MainWindow->Input.IsKeyPressed(VK_F5))
+		GraphicsInterface->ToggleDenoiser();
+	if (MainWindow->Input.IsKeyPressed(VK_F6))
+		GraphicsInterface->CycleAOVView();
+	if (MainWindow->Input.IsKeyPressed(VK_F7))
+		GraphicsInterface->ToggleTemporalAccumulation();
+	if (MainWindow->Input.IsKeyPressed(VK_F8))
+		GraphicsInterface->ToggleFrameGovernor();
+	if (MainWindow->Input.IsKeyPressed(VK_F11))
+		GraphicsInterface->CycleRenderScale();
+	if (MainWindow->Input.IsKeyPressed(VK_HOME))
+		GraphicsInterface->ToggleProgressive();
+	if (MainWindow->Input.IsKeyPressed(VK_END))
+		GraphicsInterface->CycleTilePriority();
+	if (MainWindow->IsCursorVisible())
+	{
+		auto [x, y] = MainWindow->Input.GetMousePosition();
+		const glm::uvec2 cursor(x, y);
+		GraphicsInterface->SetFocus(glm::vec2(cursor));
+
+		// Dragging with the right button marks the region of interest
+		bool dragging = MainWindow->Input.IsMouseButtonPressed(MouseButtonCode::ButtonRight);
+		if (dragging && !RegionDragActive)
+			RegionDragStart = cursor;
+		else if (!dragging && RegionDragActive)
+			GraphicsInterface->SetRegionOfInterest(TileRect{ glm::min(RegionDragStart, cursor),
+															 glm::max(RegionDragStart, cursor) + 1u });
+		RegionDragActive = dragging;
+	}
+	if (MainWindow->Input.IsKeyPressed('C'))
+		GraphicsInterface->TogglePrimaryHitCache();
+	if (MainWindow->Input.IsKeyPressed('X'))
+		GraphicsInterface->ToggleAutoExposure();
+	if (MainWindow->Input.IsKeyPressed('F'))
+		GraphicsInterface->CyclePixelFilter();
+	if (MainWindow->Input.IsKeyPressed(VK_ADD))
+		GraphicsInterface->AdjustExposure(0.5f);
+	if (MainWindow->Input.IsKeyPressed(VK_SUBTRACT))
+		GraphicsInterface->AdjustExposure(-0.5f);
+	if (MainWindow->Input.IsKeyPressed(VK_INSERT))
+	{
+		// Lookdev shortcut, rotates the color channels of the first sphere
+		Sphere sphere = GraphicsInterface->GetSphere(0);
+		sphere.Albedo = glm::vec3(sphere.Albedo.y, sphere.Albedo.z, sphere.Albedo.x);
+		GraphicsInterface->EditSphere(0, sphere);
+	}
+	if (MainWindow->Input.IsKeyPressed('P'))
+		GraphicsInterface->CaptureFrame("capture_" + std::to_string(CaptureCount++) + ".png");
+	if (MainWindow->Input.IsKeyPressed('O'))
+		GraphicsInterface->CaptureFrame("capture_" + std::to_string(CaptureCount++) + ".exr");
+	if (MainWindow->Input.IsKeyPressed('M'))
+		GraphicsInterface->ToggleFrameServer();
+	// 32k x 32k print render, 16 frames of the current rays per pixel in every pixel
+	if (MainWindow->Input.IsKeyPressed('L'))
+		GraphicsInterface->StartLargeRender("large_" + std::to_string(CaptureCount++) + ".exr", glm::uvec2(32768), 16);
+	if (MainWindow->Input.IsKeyPressed('K'))
+		GraphicsInterface->ToggleCheckpoints("render.checkpoint");
+	// 'V' records numbered QOI files, 'Y' a Y4M stream on stdout for piping into an encoder
+	const bool recordFiles = MainWindow->Input.IsKeyPressed('V');
+	const bool recordStream = MainWindow->Input.IsKeyPressed('Y');
+	if (recordFiles || recordStream)
+	{
+		if (GraphicsInterface->IsRecordingSequence())
+			GraphicsInterface->StopFrameSequence();
+		else if (recordFiles)
+			GraphicsInterface->StartFrameSequence("sequence/frame_", FrameSequenceFormat::FrameSequenceQOI);
+		else
+			GraphicsInterface->StartFrameSequence("-", FrameSequenceFormat::FrameSequenceY4M);
+	}
+	if (MainWindow->Input.IsKeyPressed(VK_PRIOR))
+		GraphicsInterface->SetRaysPerPixel(GraphicsInterface->GetRaysPerPixel() * 2);
+	if (MainWindow->Input.IsKeyPressed(VK_NEXT))
+		GraphicsInterface->SetRaysPerPixel(GraphicsInterface->GetRaysPerPixel() / 2);
 	if (MainWindow->Input.IsKeyPressed(VK_ESCAPE))
 		PostQuitMessage(0);
 }
 
-Application::Application(int width, int height, HINSTANCE instance, const char* title)
+Application::Application(int width, int height, HINSTANCE instance, const char* title, const Scene& scene)
 	:MainWindow(std::make_unique<Window>(width, height, instance, title))
 {
 	assert(!Instance && "App instance not initialized");
@@ -80,5 +159,5 @@ Application::Application(int width, int height, HINSTANCE instance, const char*
 										 {
 											 OnEvent(e);
 										 });
-	GraphicsInterface = std::make_unique<Graphics>(*MainWindow);
+	GraphicsInterface = std::make_unique<Graphics>(*MainWindow, scene);
 }
\ No newline at end of file
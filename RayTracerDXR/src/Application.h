@@ -22,13 +22,13 @@ class Application
 public:
 	static Application& GetApp();
 	int Run();
-	static void Init(int width, int height, HINSTANCE instance, const char* title);
+	static void Init(int width, int height, HINSTANCE instance, const char* title, const Scene& scene);
 
 	const std::unique_ptr<Window>& GetWindow() { return MainWindow; }
 	void OnEvent(Event& e);
 
 private:
-	Application(int width, int height, HINSTANCE instance, const char* title);
+	Application(int width, int height, HINSTANCE instance, const char* title, const Scene& scene);
 	Application(const Application&) = delete;
 	Application& operator=(const Application&) = delete;
 
@@ -39,4 +39,8 @@ private:
 
 	static Application* Instance;
 	Timer Benchmarker;
+
+	glm::uvec2 RegionDragStart = glm::uvec2(0);
+	bool RegionDragActive = false;
+	uint32_t CaptureCount = 0;
 };
\ No newline at end of file
@@ -36,6 +36,11 @@ const glm::mat4x4& Projection::GetMatrix() const
 	return ProjectionMatrix;
 }
 
+Projection Projection::WithAspectRatio(float aspectRatio) const
+{
+	return Projection(FovY, aspectRatio, NearZ, FarZ);
+}
+
 void Projection::Tick(float delta)
 {
 	ProjectionMatrix = glm::perspectiveLH_NO(glm::degrees(FovY), AspectRatio, NearZ, FarZ);
@@ -45,6 +50,7 @@ Camera::Camera()
 	:Projection(), View(glm::mat4x4(1.0f)), RotationMatrix(1.0f)
 {
 	ViewProjection = Projection.GetMatrix() * View;
+	PreviousViewProjection = ViewProjection;
 }
 
 
@@ -60,8 +66,20 @@ Camera::Camera()
 	UpdateViewMatrix();
 }
 
+ void Camera::SetProjection(float fovY, float aspectRatio, float nearZ, float farZ)
+{
+	Projection = ::Projection(fovY, aspectRatio, nearZ, farZ);
+	UpdateViewMatrix();
+}
+
+ glm::mat4x4 Camera::GetViewProjection(float aspectRatio) const
+{
+	return Projection.WithAspectRatio(aspectRatio).GetMatrix() * View;
+}
+
  void Camera::Tick(float delta)
  {
+	 PreviousViewProjection = ViewProjection;
 
 	 auto& input = Application::GetApp().GetWindow()->Input;
 
@@ -107,5 +125,8 @@ Camera::Camera()
 	 glm::vec3 directionVector = glm::normalize(glm::vec3(RotationMatrix[2]));
 
 	 View = glm::lookAtLH(Position, Position + directionVector, glm::vec3(0, 1, 0));
-	 ViewProjection = Projection.GetMatrix() * View;
+	 glm::mat4x4 viewProjection = Projection.GetMatrix() * View;
+	 if (viewProjection != ViewProjection)
+		 Epoch++;
+	 ViewProjection = viewProjection;
  }
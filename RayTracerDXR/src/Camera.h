@@ -9,6 +9,8 @@ public:
 	Projection(float fovY, float aspectRatio, float nearZ, float farZ);
 
 	const glm::mat4x4& GetMatrix() const;
+	// Same field of view and depth range for an image of another shape
+	Projection WithAspectRatio(float aspectRatio) const;
 
 	void Tick(float delta);
 private:
@@ -26,6 +28,7 @@ public:
 
 	void SetPosition(const glm::vec3& position);
 	void SetRotation(const glm::vec3& rotation);
+	void SetProjection(float fovY, float aspectRatio, float nearZ, float farZ);
 
 	inline glm::vec3 GetPosition() const { return Position; }
 	inline glm::vec3 GetRotation() const { return Rotation; }
@@ -33,6 +36,10 @@ public:
 	inline const glm::mat4x4& GetProjection() const { return Projection.GetMatrix(); }
 	inline const glm::mat4x4& GetView() const { return View; }
 	inline const glm::mat4x4& GetViewProjection() const { return ViewProjection; }
+	glm::mat4x4 GetViewProjection(float aspectRatio) const;
+	inline const glm::mat4x4& GetPreviousViewProjection() const { return PreviousViewProjection; }
+	// Incremented whenever the view projection changes, work for an older epoch is stale
+	inline uint64_t GetEpoch() const { return Epoch; }
 
 	void Tick(float delta);
 
@@ -43,10 +50,12 @@ private:
 	Projection Projection;
 	glm::mat4x4 View;
 	glm::mat4x4 ViewProjection;
+	glm::mat4x4 PreviousViewProjection;
 	glm::mat4x4 RotationMatrix;
 
 	glm::vec3 Position = { 0.0f, 0.0f, 0.0f };
 	glm::vec3 Rotation = { 0.0f, 0.0f, 0.0f };
 
 	float TranslationSpeed = 10.0f, RotationSpeed = 0.05f;
+	uint64_t Epoch = 0;
 };
\ No newline at end of file
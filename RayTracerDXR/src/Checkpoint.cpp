@@ -0,0 +1,153 @@
+#include "Checkpoint.h"
+
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+
+namespace
+{
+	// Fixed size part at the start of the file, followed by the tiles, the tile order and the
+	// radiance rows without padding
+	struct CheckpointHeader
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint64_t SceneHash;
+		uint32_t Width;
+		uint32_t Height;
+		uint32_t FrameIndex;
+		uint32_t ProgressiveLevel;
+		uint32_t AccumulatedFrames;
+		uint32_t TileSize;
+		uint32_t TileCount;
+		uint32_t PrimaryHitCacheJitter;
+		uint32_t PrimaryHitCacheAge;
+		uint32_t Reserved;
+	};
+
+	// Bounds and priority are derived, they are not stored
+	struct CheckpointTile
+	{
+		uint32_t Visits;
+		float Error;
+		float VirtualTime;
+		uint32_t ResetPending;
+	};
+
+	template<typename T>
+	void WriteValues(std::ofstream& file, const T* values, size_t count)
+	{
+		file.write(reinterpret_cast<const char*>(values), count * sizeof(T));
+	}
+
+	template<typename T>
+	bool ReadValues(std::ifstream& file, T* values, size_t count)
+	{
+		file.read(reinterpret_cast<char*>(values), count * sizeof(T));
+		return static_cast<size_t>(file.gcount()) == count * sizeof(T);
+	}
+}
+
+bool Checkpoint::Write(const std::string& path, const uint8_t* radiance, uint32_t rowPitch) const
+{
+	assert(Schedule.Tiles.size() == Schedule.Order.size() && "Incomplete tile schedule");
+
+	const std::string temporary = path + ".tmp";
+	{
+		std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+		if (!file)
+			return false;
+
+		const CheckpointHeader header{
+			.Magic = Magic,
+			.Version = Version,
+			.SceneHash = SceneHash,
+			.Width = Size.x,
+			.Height = Size.y,
+			.FrameIndex = FrameIndex,
+			.ProgressiveLevel = ProgressiveLevel,
+			.AccumulatedFrames = AccumulatedFrames,
+			.TileSize = TileSize,
+			.TileCount = static_cast<uint32_t>(Schedule.Tiles.size()),
+			.PrimaryHitCacheJitter = PrimaryHitCacheJitter,
+			.PrimaryHitCacheAge = PrimaryHitCacheAge,
+			.Reserved = 0 };
+		WriteValues(file, &header, 1);
+
+		std::vector<CheckpointTile> tiles;
+		tiles.reserve(Schedule.Tiles.size());
+		for (const TileInfo& tile : Schedule.Tiles)
+			tiles.push_back(CheckpointTile{ tile.Visits, tile.Error, tile.VirtualTime, tile.ResetPending ? 1u : 0u });
+		WriteValues(file, tiles.data(), tiles.size());
+		WriteValues(file, Schedule.Order.data(), Schedule.Order.size());
+
+		for (uint32_t y = 0; y < Size.y && file; y++)
+			WriteValues(file, reinterpret_cast<const glm::vec4*>(radiance + size_t(y) * rowPitch), Size.x);
+
+		file.close();
+		if (file.fail())
+		{
+			std::error_code ignored;
+			std::filesystem::remove(temporary, ignored);
+			return false;
+		}
+	}
+
+	// Replaces the previous checkpoint in one step
+	std::error_code error;
+	std::filesystem::rename(temporary, path, error);
+	return !error;
+}
+
+bool Checkpoint::Read(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	CheckpointHeader header{};
+	if (!file || !ReadValues(file, &header, 1) || header.Magic != Magic || header.Version != Version)
+		return false;
+
+	// Checked before allocating anything from the sizes in the header
+	const uint64_t expected = sizeof(CheckpointHeader) +
+		uint64_t(header.TileCount) * (sizeof(CheckpointTile) + sizeof(uint32_t)) +
+		uint64_t(header.Width) * header.Height * sizeof(glm::vec4);
+	std::error_code error;
+	if (std::filesystem::file_size(path, error) != expected || error)
+		return false;
+
+	std::vector<CheckpointTile> tiles(header.TileCount);
+	std::vector<uint32_t> order(header.TileCount);
+	std::vector<glm::vec4> radiance(size_t(header.Width) * header.Height);
+	if (!ReadValues(file, tiles.data(), tiles.size()) || !ReadValues(file, order.data(), order.size()) ||
+		!ReadValues(file, radiance.data(), radiance.size()))
+		return false;
+
+	SceneHash = header.SceneHash;
+	Size = glm::uvec2(header.Width, header.Height);
+	FrameIndex = header.FrameIndex;
+	ProgressiveLevel = header.ProgressiveLevel;
+	AccumulatedFrames = header.AccumulatedFrames;
+	TileSize = header.TileSize;
+	PrimaryHitCacheJitter = header.PrimaryHitCacheJitter;
+	PrimaryHitCacheAge = header.PrimaryHitCacheAge;
+	Schedule.Tiles.clear();
+	for (const CheckpointTile& tile : tiles)
+	{
+		TileInfo info;
+		info.Visits = tile.Visits;
+		info.Error = tile.Error;
+		info.VirtualTime = tile.VirtualTime;
+		info.ResetPending = tile.ResetPending != 0;
+		Schedule.Tiles.push_back(info);
+	}
+	Schedule.Order = std::move(order);
+	Radiance = std::move(radiance);
+	return true;
+}
+
+uint64_t Checkpoint::Hash(const void* data, size_t size, uint64_t hash)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	for (size_t i = 0; i < size; i++)
+		hash = (hash ^ bytes[i]) * 1099511628211ull;
+	return hash;
+}
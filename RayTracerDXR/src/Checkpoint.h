@@ -0,0 +1,50 @@
+#pragma once
+
+#include "Core.h"
+
+#include "TileScheduler.h"
+
+#include <type_traits>
+
+// State of a progressive render at the end of one frame. Together with a deterministic random
+// texture it is enough to continue the render in a later run and get the same frames an
+// uninterrupted one would have produced. SceneHash covers everything the frames depend on that
+// is not stored, a checkpoint is only resumed if it matches the hash of the current scene.
+// ReSTIR reservoirs are not stored either, a resumed render starts them over. With ReSTIR it
+// converges to the same image, but its frames are not the ones of an uninterrupted run
+struct Checkpoint
+{
+	uint64_t SceneHash = 0;
+	glm::uvec2 Size = glm::uvec2(0);
+	uint32_t FrameIndex = 0;
+	uint32_t ProgressiveLevel = 0;
+	uint32_t AccumulatedFrames = 0;
+	uint32_t TileSize = 0;
+	// Seed and age of the sub-pixel positions of the cached primary hits
+	uint32_t PrimaryHitCacheJitter = 0;
+	uint32_t PrimaryHitCacheAge = 0;
+	TileSchedulerState Schedule;
+	// Accumulated radiance, alpha is the number of samples in the pixel. Only filled by Read,
+	// Write takes the rows from the caller so they can come straight from a readback buffer
+	std::vector<glm::vec4> Radiance;
+
+	// Writes to a temporary file next to path and renames it over path once it is complete, so a
+	// crash while writing leaves the previous checkpoint intact. Rows are rowPitch bytes apart
+	bool Write(const std::string& path, const uint8_t* radiance, uint32_t rowPitch) const;
+	// False if the file is missing, truncated or of another version
+	bool Read(const std::string& path);
+
+	// FNV-1a, chained through hash to cover several blocks of memory. Pointers always go to the
+	// first overload, hashing their value would make the hash differ between runs
+	static uint64_t Hash(const void* data, size_t size, uint64_t hash = HashBasis);
+	template<typename T> requires (!std::is_pointer_v<T>)
+	static uint64_t Hash(const T& value, uint64_t hash)
+	{
+		static_assert(std::is_trivially_copyable_v<T>);
+		return Hash(&value, sizeof(T), hash);
+	}
+
+	static constexpr uint64_t HashBasis = 14695981039346656037ull;
+	static constexpr uint32_t Magic = 0x4B435452; // "RTCK"
+	static constexpr uint32_t Version = 2;
+};
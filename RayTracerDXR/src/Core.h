@@ -37,10 +37,13 @@ MAKE_SMART_COM_PTR(IDXGIAdapter1);
 MAKE_SMART_COM_PTR(ID3D12Fence);
 MAKE_SMART_COM_PTR(ID3D12CommandAllocator);
 MAKE_SMART_COM_PTR(ID3D12Resource);
+MAKE_SMART_COM_PTR(ID3D12Heap);
 MAKE_SMART_COM_PTR(ID3D12DescriptorHeap);
 MAKE_SMART_COM_PTR(ID3D12Debug);
 MAKE_SMART_COM_PTR(ID3D12Debug1);
 MAKE_SMART_COM_PTR(ID3D12StateObject);
+MAKE_SMART_COM_PTR(ID3D12PipelineState);
+MAKE_SMART_COM_PTR(ID3D12QueryHeap);
 MAKE_SMART_COM_PTR(ID3D12RootSignature);
 MAKE_SMART_COM_PTR(ID3DBlob);
 MAKE_SMART_COM_PTR(IDxcBlobEncoding);
@@ -113,6 +113,16 @@ bool InputManager::IsKeyPressed(uint8 keycode) noexcept
 	return false;
 }
 
+bool InputManager::IsMouseButtonPressed(MouseButtonCode button) const noexcept
+{
+	return MouseStates[static_cast<uint32_t>(button)];
+}
+
+std::pair<uint32_t, uint32_t> InputManager::GetMousePosition() const noexcept
+{
+	return MousePosition;
+}
+
 bool InputManager::IsKeyBufferEmpty() const noexcept
 {
 	return KeyEventBuffer.empty();
@@ -209,6 +219,7 @@ bool InputManager::OnMouseButtonReleased(MouseButtonReleasedEvent& event) noexce
 
 bool InputManager::OnMouseMoved(MouseMovedEvent& event) noexcept
 {
+	MousePosition = { event.GetXPos(), event.GetYPos() };
 	MouseEventBuffer.emplace(std::make_unique<MouseMovedEvent>(event.GetXPos(), event.GetYPos()));
 	PreventBufferOverflow(MouseEventBuffer);
 	return true;
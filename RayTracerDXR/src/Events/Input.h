@@ -32,6 +32,9 @@ public:
 	void SetAutoRepeat(bool autoRepeat) noexcept;
 
 	bool IsKeyPressed(uint8 keycode) noexcept;
+	bool IsMouseButtonPressed(MouseButtonCode button) const noexcept;
+	// Client area position of the last MouseMovedEvent
+	std::pair<uint32_t, uint32_t> GetMousePosition() const noexcept;
 	bool IsKeyBufferEmpty() const noexcept;
 	bool IsMouseBufferEmpty() const noexcept;
 	bool IsAutoRepeatEnabled() const noexcept;
@@ -71,6 +74,7 @@ private:
 
 	std::bitset<NumberOfKeys> KeyStates;
 	std::bitset<8> MouseStates;
+	std::pair<uint32_t, uint32_t> MousePosition = { 0u, 0u };
 
 	std::list<std::unique_ptr<Event>> KeyEventBuffer;
 	std::queue<std::unique_ptr<Event>> MouseEventBuffer;
@@ -0,0 +1,121 @@
+#include "FrameGovernor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+std::string FrameWorkload::ToString() const
+{
+	std::ostringstream oss;
+	oss << RaysPerPixel << " spp at " << static_cast<int>(RenderScale * 100.0f + 0.5f) << "% resolution";
+	return oss.str();
+}
+
+FrameGovernor::FrameGovernor(const FrameGovernorSettings& settings, const FrameWorkload& initial)
+	:Settings(settings)
+{
+	Reset(initial);
+}
+
+void FrameGovernor::Reset(const FrameWorkload& workload)
+{
+	Workload = workload;
+	LogWorkload = std::log(GetCost(workload));
+	PreviousError = 0.0f;
+	PreviousPreviousError = 0.0f;
+	PendingFrames = 0;
+}
+
+const FrameWorkload& FrameGovernor::Update(float milliseconds)
+{
+	MeasuredMilliseconds = milliseconds;
+	if (!(milliseconds > 0.0f))
+		return Workload;
+
+	float error = std::log(Settings.TargetMilliseconds / milliseconds);
+	if (std::abs(error) < Settings.Deadband)
+		error = 0.0f;
+
+	// Velocity form, the workload itself integrates the corrections so there is no windup
+	LogWorkload += Settings.Kp * (error - PreviousError) + Settings.Ki * error +
+		Settings.Kd * (error - 2.0f * PreviousError + PreviousPreviousError);
+	PreviousPreviousError = PreviousError;
+	PreviousError = error;
+
+	// The measurement only reflects the applied workload, keep the controller state close to it
+	// while the hysteresis holds a setting back
+	const float applied = std::log(GetCost(Workload));
+	const float band = 2.0f * std::log(Settings.Hysteresis);
+	const float minScale = Settings.MinRenderScale;
+	const float minWorkload = std::log(Settings.MinRaysPerPixel * minScale * minScale);
+	const float maxWorkload = std::log(Settings.MaxRaysPerPixel * Settings.MaxRenderScale * Settings.MaxRenderScale);
+	LogWorkload = std::clamp(LogWorkload, applied - band, applied + band);
+	LogWorkload = std::clamp(LogWorkload, minWorkload, maxWorkload);
+
+	FrameWorkload candidate = ToWorkload(LogWorkload);
+	// Increases must be predicted to fit the budget, otherwise quantized settings oscillate
+	// between one that is too cheap and one that is too expensive
+	float predicted = milliseconds * GetCost(candidate) / GetCost(Workload);
+	if (!ExceedsHysteresis(candidate) ||
+		(predicted > milliseconds && predicted > Settings.TargetMilliseconds * (1.0f + Settings.Deadband)))
+	{
+		PendingFrames = 0;
+		return Workload;
+	}
+
+	if (++PendingFrames >= Settings.HoldFrames)
+	{
+		Workload = candidate;
+		PendingFrames = 0;
+	}
+	return Workload;
+}
+
+float FrameGovernor::GetCost(const FrameWorkload& workload)
+{
+	return workload.RaysPerPixel * workload.RenderScale * workload.RenderScale;
+}
+
+// Samples are given up before resolution, a lower resolution is only used at the minimum rate
+FrameWorkload FrameGovernor::ToWorkload(float logWorkload) const
+{
+	FrameWorkload result;
+	float workload = std::exp(logWorkload);
+	float minRays = static_cast<float>(Settings.MinRaysPerPixel);
+	float fullScale = Settings.MaxRenderScale * Settings.MaxRenderScale;
+
+	if (workload >= minRays * fullScale)
+	{
+		result.RenderScale = Settings.MaxRenderScale;
+		result.RaysPerPixel = static_cast<uint32_t>(std::floor(workload / fullScale));
+		result.RaysPerPixel = std::clamp(result.RaysPerPixel, Settings.MinRaysPerPixel, Settings.MaxRaysPerPixel);
+	}
+	else
+	{
+		result.RaysPerPixel = Settings.MinRaysPerPixel;
+		result.RenderScale = std::clamp(std::sqrt(workload / minRays), Settings.MinRenderScale, Settings.MaxRenderScale);
+	}
+	return result;
+}
+
+bool FrameGovernor::ExceedsHysteresis(const FrameWorkload& candidate) const
+{
+	if (candidate.RaysPerPixel != Workload.RaysPerPixel)
+	{
+		float ratio = static_cast<float>(candidate.RaysPerPixel) / Workload.RaysPerPixel;
+		if (ratio > Settings.Hysteresis || ratio < 1.0f / Settings.Hysteresis)
+			return true;
+	}
+
+	float scaleRatio = candidate.RenderScale / Workload.RenderScale;
+	float scaleHysteresis = std::sqrt(Settings.Hysteresis);
+	return scaleRatio > scaleHysteresis || scaleRatio < 1.0f / scaleHysteresis;
+}
+
+std::string FrameGovernor::ToString() const
+{
+	std::ostringstream oss;
+	oss << "Frame governor: " << MeasuredMilliseconds << " ms (target " << Settings.TargetMilliseconds
+		<< " ms), " << Workload.ToString() << std::endl;
+	return oss.str();
+}
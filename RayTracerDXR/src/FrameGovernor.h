@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Core.h"
+
+struct FrameGovernorSettings
+{
+	float TargetMilliseconds = 16.6f;
+
+	// Gains of the velocity form PID acting on log(workload), the error is log(target / measured)
+	float Kp = 0.2f;
+	float Ki = 0.3f;
+	float Kd = 0.05f;
+
+	// Relative frame time error that is tolerated without any correction
+	float Deadband = 0.08f;
+	// A discrete setting only changes after the continuous one left it by this factor for
+	// HoldFrames consecutive frames
+	float Hysteresis = 1.25f;
+	uint32_t HoldFrames = 4;
+
+	uint32_t MinRaysPerPixel = 1;
+	uint32_t MaxRaysPerPixel = 64;
+	float MinRenderScale = 0.25f;
+	float MaxRenderScale = 1.0f;
+};
+
+struct FrameWorkload
+{
+	uint32_t RaysPerPixel = 32;
+	float RenderScale = 1.0f;
+
+	std::string ToString() const;
+};
+
+// Keeps the GPU frame time at a target by trading samples per pixel and, once those reached their
+// minimum, the internal render resolution. The cost of a frame is modelled as proportional to
+// RaysPerPixel * RenderScale^2
+struct FrameGovernor
+{
+	FrameGovernor() = default;
+	FrameGovernor(const FrameGovernorSettings& settings, const FrameWorkload& initial);
+
+	// Feeds the measured time of the last frame and returns the workload for the next one
+	const FrameWorkload& Update(float milliseconds);
+	void Reset(const FrameWorkload& workload);
+
+	inline const FrameWorkload& GetWorkload() const { return Workload; }
+	inline float GetMeasuredMilliseconds() const { return MeasuredMilliseconds; }
+	inline FrameGovernorSettings& GetSettings() { return Settings; }
+
+	std::string ToString() const;
+
+private:
+	static float GetCost(const FrameWorkload& workload);
+	FrameWorkload ToWorkload(float logWorkload) const;
+	bool ExceedsHysteresis(const FrameWorkload& candidate) const;
+
+private:
+	FrameGovernorSettings Settings;
+	FrameWorkload Workload;
+
+	float LogWorkload = 0.0f;
+	float PreviousError = 0.0f;
+	float PreviousPreviousError = 0.0f;
+	float MeasuredMilliseconds = 0.0f;
+	uint32_t PendingFrames = 0;
+};
@@ -0,0 +1,108 @@
+#include "FrameSequence.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+namespace
+{
+	// One frame of a Y4M stream. The planes are separate, so the rows are converted as they arrive
+	// and the frame goes out in one piece once it is complete
+	struct Y4mFrameWriter : ImageWriter
+	{
+		Y4mFrameWriter(const std::string& name, uint32_t width, uint32_t height, std::shared_ptr<std::ostream> out)
+			:ImageWriter(name, width, height, ImagePixelRGBA8, false), Out(std::move(out)),
+			Planes(3 * static_cast<size_t>(width) * height)
+		{
+		}
+
+		// BT.601 limited range, what decoders assume for untagged YUV
+		void WriteRows(const ImageRows& rows) override
+		{
+			const size_t planeSize = static_cast<size_t>(Width) * Height;
+			for (uint32_t r = 0; r < rows.Count; r++)
+			{
+				const size_t line = static_cast<size_t>(rows.FirstRow + r) * Width;
+				const uint8_t* pixel = rows.Data.data() + static_cast<size_t>(r) * GetRowSize();
+				for (uint32_t x = 0; x < Width; x++, pixel += 4)
+				{
+					const float red = pixel[0], green = pixel[1], blue = pixel[2];
+					const float y = 16.0f + (65.481f * red + 128.553f * green + 24.966f * blue) / 255.0f;
+					const float u = 128.0f + (-37.797f * red - 74.203f * green + 112.0f * blue) / 255.0f;
+					const float v = 128.0f + (112.0f * red - 93.786f * green - 18.214f * blue) / 255.0f;
+					Planes[line + x] = static_cast<uint8_t>(y + 0.5f);
+					Planes[planeSize + line + x] = static_cast<uint8_t>(u + 0.5f);
+					Planes[2 * planeSize + line + x] = static_cast<uint8_t>(v + 0.5f);
+				}
+				RowsWritten++;
+			}
+		}
+
+		bool Close() override
+		{
+			if (RowsWritten != Height)
+				return false;
+
+			*Out << "FRAME\n";
+			Out->write(reinterpret_cast<const char*>(Planes.data()), Planes.size());
+			Out->flush();
+			return !Out->fail();
+		}
+
+		std::shared_ptr<std::ostream> Out;
+		std::vector<uint8_t> Planes;
+		uint32_t RowsWritten = 0;
+	};
+}
+
+FrameSequence::FrameSequence(const std::string& target, FrameSequenceFormat format, uint32_t width, uint32_t height,
+							 uint32_t framesPerSecond)
+	:Target(target), Format(format), Width(width), Height(height)
+{
+	if (Format == FrameSequenceQOI)
+	{
+		const std::filesystem::path directory = std::filesystem::path(Target).parent_path();
+		if (!directory.empty())
+			std::filesystem::create_directories(directory);
+		return;
+	}
+
+	if (Target == "-")
+	{
+#ifdef _WIN32
+		_setmode(_fileno(stdout), _O_BINARY);
+#endif
+		// The stream is shared with the writers, stdout itself must outlive all of them anyway
+		Output = std::shared_ptr<std::ostream>(&std::cout, [](std::ostream*) {});
+	}
+	else
+	{
+		Output = std::make_shared<std::ofstream>(Target, std::ios::binary | std::ios::trunc);
+	}
+
+	*Output << "YUV4MPEG2 W" << Width << " H" << Height << " F" << framesPerSecond << ":1 Ip A1:1 C444\n";
+}
+
+std::shared_ptr<ImageWriter> FrameSequence::NextFrame()
+{
+	const uint32_t index = FrameCount++;
+	if (Format == FrameSequenceQOI)
+	{
+		std::ostringstream path;
+		path << Target << std::setw(5) << std::setfill('0') << index << ".qoi";
+		return ImageWriter::Create(path.str(), Width, Height);
+	}
+
+	if (!Output || Output->fail())
+		return nullptr;
+
+	std::ostringstream name;
+	name << (Target == "-" ? "stdout" : Target) << " frame " << index;
+	return std::make_shared<Y4mFrameWriter>(name.str(), Width, Height, Output);
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "Core.h"
+#include "ImageWriter.h"
+
+enum FrameSequenceFormat : uint32_t
+{
+	FrameSequenceQOI = 0,
+	FrameSequenceY4M
+};
+
+// Sink for the frames of an animation render. QOI writes one numbered file per frame, target is
+// the path prefix. Y4M appends every frame to a single 4:4:4 stream in the target file, or on
+// stdout for "-" so that the renderer can be piped into an encoder. The writers go through the
+// ImageWriterQueue like any capture, so a frame encodes while the next one renders
+struct FrameSequence
+{
+	FrameSequence(const std::string& target, FrameSequenceFormat format, uint32_t width, uint32_t height,
+				  uint32_t framesPerSecond = 30);
+
+	// Writer for the next frame, nullptr if the output could not be opened
+	std::shared_ptr<ImageWriter> NextFrame();
+
+	inline uint32_t GetFrameCount() const { return FrameCount; }
+
+private:
+	std::string Target;
+	FrameSequenceFormat Format;
+	uint32_t Width;
+	uint32_t Height;
+	uint32_t FrameCount = 0;
+	// Destination of the Y4M frames, shared by the writers of all frames in flight
+	std::shared_ptr<std::ostream> Output;
+};
@@ -1,6 +1,11 @@
 #include "Graphics.h"
+#include "SceneArchive.h"
 #include "Utils.h"
 
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <limits>
 #include <random>
 
 static void InitializeRTConstants(RayTracingConstants& rtConstants)
@@ -12,31 +17,103 @@ static void InitializeRTConstants(RayTracingConstants& rtConstants)
 	rtConstants.SpheresOfsset = 0;
 	rtConstants.MaterialsOffset = 0;
 	rtConstants.RandomNumbersIndex = 0;
+
+	rtConstants.LightsOffset = 0;
+	rtConstants.LightCount = 0;
+	rtConstants.LightSampling = LightSamplingMode::PowerLightSampling;
+	rtConstants.FrameIndex = 0;
+	rtConstants.LightNodesOffset = 0;
+	rtConstants.Restir = RestirFlags::RestirEnabled | RestirFlags::RestirTemporalReuse | RestirFlags::RestirSpatialReuse;
+	rtConstants.RestirCandidates = 8;
+	rtConstants.ReservoirsOffset = 0;
+	rtConstants.RestirStamp = 1;
+	rtConstants.PreviousViewProjection = mat4x4(1.0f);
+
+	rtConstants.RadianceIndex = 0;
+	rtConstants.AlbedoIndex = 0;
+	rtConstants.NormalIndex = 0;
+	rtConstants.DepthIndex = 0;
+
+	rtConstants.AOVMask = 0;
+	rtConstants.InstanceIDIndex = 0;
+	rtConstants.BounceCountIndex = 0;
+	rtConstants.RaysPerPixel = 32;
+
+	rtConstants.PreviousCameraPosition = vec3(0.0f);
+	rtConstants.HistoryOffset = 0;
+	rtConstants.RenderSize = uvec2(1);
+	rtConstants.UpscaleGuidesOffset = 0;
+	rtConstants.ProgressiveStride = 0;
+	rtConstants.TileSize = 0;
+	rtConstants.TileCount = 0;
+	rtConstants.TileResets = uvec2(0);
+	rtConstants.TileErrorsIndex = 0;
+	std::memset(rtConstants.TileOrigins, 0, sizeof(rtConstants.TileOrigins));
+	rtConstants.PrimaryHitCacheIndex = 0;
+	rtConstants.PrimaryHitCacheSamples = 0;
+	rtConstants.PrimaryHitCacheStamp = 1;
+	rtConstants.PrimaryHitCacheJitter = 0;
+	rtConstants.PixelFilterWeight = 1.0f;
+	std::memset(rtConstants.PixelFilterTable, 0, sizeof(rtConstants.PixelFilterTable));
+
+	rtConstants.SkyHorizon = vec3(1.0f);
+	rtConstants.MaxDepth = maxTraceRecursionDepth;
+	rtConstants.SkyZenith = vec3(0.5f, 0.7f, 1.0f);
+	rtConstants.SkyPadding = 0;
 }
 
-Graphics::Graphics(Window& window)
+Graphics::Graphics(Window& window, const Scene& scene)
 	:WinHandle(window.Handle), SceneCamera()
 {
 	Init();
 	SwapChainSize = glm::vec2(window.Width, window.Height);
+	RenderSize = SwapChainSize;
 
 
-	SceneCamera.SetPosition(glm::vec3(0, 0, -4));
+	SceneCamera.SetProjection(scene.View.FovY, float(SwapChainSize.x) / SwapChainSize.y, scene.View.NearZ, scene.View.FarZ);
+	SceneCamera.SetRotation(scene.View.Rotation);
+	SceneCamera.SetPosition(scene.View.Position);
 	InitializeRTConstants(GlobalResources.RTConstantsData);
+	GlobalResources.RTConstantsData.RenderSize = RenderSize;
+	GlobalResources.RTConstantsData.RaysPerPixel = std::max(scene.Settings.RaysPerPixel, 1u);
+	GlobalResources.RTConstantsData.MaxDepth = std::clamp(scene.Settings.MaxDepth, 1u, maxTraceRecursionDepth);
+	GlobalResources.RTConstantsData.SkyHorizon = scene.Sky.Horizon;
+	GlobalResources.RTConstantsData.SkyZenith = scene.Sky.Zenith;
+	SetPixelFilter(PixelFilterBox);
 	GlobalResources.Initialize(Device);
+	Governor = FrameGovernor(FrameGovernorSettings{},
+							 FrameWorkload{ .RaysPerPixel = GlobalResources.RTConstantsData.RaysPerPixel, .RenderScale = 1.0f });
 
 	Spheres.SetDevice(Device);
-	Spheres.AddSphere(Sphere{ glm::vec3(0), 1, glm::vec3(0.8f, 0.0f, 0.0f) });
-	Spheres.AddSphere(Sphere{ glm::vec3(0, -101, 0), 100, glm::vec3(0.3f, 0.4f, 0.8f) });
-	Spheres.AddSphere(Sphere(glm::vec3(-2, 0, 0), 1, glm::vec3(1.0f, 1.0f, 1.0f), MaterialType::Dielectric));
-	Spheres.AddSphere(Sphere(glm::vec3(2, 0, 0), 1, glm::vec3(0.8f, 0.6f, 0.2f), MaterialType::Metal));
-
-	InitializeMaterials();
+	InitializeMaterials(scene.Materials);
+	if (scene.Archive)
+	{
+		// Spheres are uploaded straight from the mapped file, the light hierarchy is built only if
+		// the archive has none or it does not pass its checks
+		SceneData = scene.Archive;
+		Spheres.Reference(scene.GetSpheres());
+		if (!Lights.Load(Spheres, SceneData->GetSection<LightInfo>(SceneSection::Lights),
+						 SceneData->GetSection<LightBVHNode>(SceneSection::LightNodes)))
+			Lights.Build(Spheres);
+	}
+	else
+	{
+		Spheres.AddSpheres(scene.Spheres);
+		Lights.Build(Spheres);
+	}
+	Uploads.Initialize(Device, kDefaultSwapChainBuffers);
+	Uploads.Begin(SwapChain->GetCurrentBackBufferIndex());
+	Spheres.Upload(CmdList, Uploads);
+	Snapshots = std::make_unique<SceneSnapshots>(scene.GetSpheres(), scene.Archive != nullptr,
+												 static_cast<uint32_t>(MatArray.size()));
+	AppliedChunks = Snapshots->Pin()->Chunks;
 
 	CreateAccelerationStructures();
 	CreateRTPipelaneState();
+	CreatePostProcessPrograms();
 	CreateShaderResources();
 	CreateShaderTable();
+	CreateTimestampQueries();
 }
 
 Graphics::~Graphics()
@@ -47,46 +124,1055 @@ Graphics::~Graphics()
 void Graphics::Tick(float delta)
 {
 	uint32_t frameIndex = SwapChain->GetCurrentBackBufferIndex();
+	FrameDelta = delta;
+
+	float frameTime = ReadFrameTime(frameIndex);
+	ReadTileErrors(frameIndex);
+	ReadCapture(frameIndex);
+	WriteCheckpoint(frameIndex);
+	ReadLargeRender(frameIndex);
+	PublishSharedFrame(frameIndex, frameTime);
+	if (GovernorEnabled && !LargeRender && frameTime > 0.0f)
+	{
+		// The hysteresis keeps changes rare, each one is logged with the frame time behind it
+		const FrameWorkload previous = Governor.GetWorkload();
+		const FrameWorkload& workload = Governor.Update(frameTime);
+		if (workload.RaysPerPixel != previous.RaysPerPixel || workload.RenderScale != previous.RenderScale)
+			OutputDebugStringA(Governor.ToString().c_str());
+		ApplyWorkload(workload);
+	}
+
+	// The frame sees one version of the scene, edits published from here on wait for the next one
+	{
+		const SnapshotPin snapshot = Snapshots->Pin();
+		ApplySnapshot(*snapshot);
+	}
+	Snapshots->Reclaim();
+	ApplySceneEdits(frameIndex);
 
 	D3D::ResourceBarrier(CmdList, OutputTexture, D3D12_RESOURCE_STATE_COPY_SOURCE,
 						 D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
 	UpdateTexture();
 
+	GlobalResources.RTConstantsData.PreviousCameraPosition = GlobalResources.RTConstantsData.CameraPosition;
 	GlobalResources.RTConstantsData.CameraPosition = SceneCamera.GetPosition();
 	GlobalResources.RTConstantsData.ViewProjectionInv = (glm::inverse(SceneCamera.GetViewProjection()));
+	GlobalResources.RTConstantsData.PreviousViewProjection = SceneCamera.GetPreviousViewProjection();
+	GlobalResources.RTConstantsData.FrameIndex++;
+	AccumulatedFrames++;
+	const bool largeRenderFrame = LargeRender && UpdateLargeRender();
+	const glm::uvec3 dispatchSize = ProgressiveEnabled ? UpdateProgressive(frameIndex) : glm::uvec3(RenderSize, 1);
+	UpdatePrimaryHitCache();
 	GlobalResources.Tick();
+	// Reservoirs written by this frame are valid history from the next one on
+	GlobalResources.RTConstantsData.Restir |= RestirFlags::RestirHistoryValid;
 	SceneCamera.Tick(delta);
 
-	D3D12_DISPATCH_RAYS_DESC rayTraceDesc{};
-	rayTraceDesc.Width = SwapChainSize.x;
-	rayTraceDesc.Height = SwapChainSize.y;
-	rayTraceDesc.Depth = 1;
+	D3D12_DISPATCH_RAYS_DESC rayTraceDesc = GetDispatchRaysDesc(ShaderTableLayout::RayGenEntry, dispatchSize);
+	GlobalResources.Bind(CmdList);
 
-	rayTraceDesc.RayGenerationShaderRecord.StartAddress = ShaderTable->GetGPUVirtualAddress() + 0 * ShaderTableEntrySize;
-	rayTraceDesc.RayGenerationShaderRecord.SizeInBytes = ShaderTableEntrySize;
+	CmdList->EndQuery(TimestampHeap, D3D12_QUERY_TYPE_TIMESTAMP, 2 * frameIndex);
 
-	size_t missOffset = ShaderTableEntrySize;
-	rayTraceDesc.MissShaderTable.StartAddress = ShaderTable->GetGPUVirtualAddress() + missOffset;
-	rayTraceDesc.MissShaderTable.StrideInBytes = ShaderTableEntrySize;
-	rayTraceDesc.MissShaderTable.SizeInBytes = ShaderTableEntrySize;
+	CmdList->SetPipelineState1(PipelineState.GetInterfacePtr());
+	CmdList->DispatchRays(&rayTraceDesc);
 
-	size_t hitOffset = 2 * ShaderTableEntrySize;
-	rayTraceDesc.HitGroupTable.StartAddress = ShaderTable->GetGPUVirtualAddress() + hitOffset;
-	rayTraceDesc.HitGroupTable.StrideInBytes = ShaderTableEntrySize;
-	rayTraceDesc.HitGroupTable.SizeInBytes = ShaderTableEntrySize;
+	if (RenderSize != SwapChainSize)
+	{
+		D3D12_DISPATCH_RAYS_DESC guideDesc = GetDispatchRaysDesc(ShaderTableLayout::GuideRayGenEntry,
+																 glm::uvec3(SwapChainSize, 1));
+		CmdList->DispatchRays(&guideDesc);
+	}
 
-	GlobalResources.Bind(CmdList);
+	PostProcess();
+	if (GlobalResources.RTConstantsData.TileCount != 0)
+		CopyTileErrors(frameIndex);
+	CopyCheckpoint(frameIndex);
+	if (largeRenderFrame)
+		CopyLargeRender(frameIndex);
 
-	CmdList->SetPipelineState1(PipelineState.GetInterfacePtr());
-	CmdList->DispatchRays(&rayTraceDesc);
+	CmdList->EndQuery(TimestampHeap, D3D12_QUERY_TYPE_TIMESTAMP, 2 * frameIndex + 1);
+	CmdList->ResolveQueryData(TimestampHeap, D3D12_QUERY_TYPE_TIMESTAMP, 2 * frameIndex, 2,
+							  TimestampReadback, 2 * frameIndex * sizeof(uint64_t));
+	TimestampsPending[frameIndex] = true;
 
 	D3D::ResourceBarrier(CmdList, OutputTexture, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE);
+	CopyCapture(frameIndex);
+	CopySharedFrame(frameIndex);
 	D3D::ResourceBarrier(CmdList, FrameObjects[frameIndex].SwapChainBuffer, D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_COPY_DEST);
 	CmdList->CopyResource(FrameObjects[frameIndex].SwapChainBuffer, OutputTexture);
 
 	EndFrame(frameIndex);
 }
 
+void Graphics::ToggleLightSampling()
+{
+	auto& mode = GlobalResources.RTConstantsData.LightSampling;
+	mode = (mode + 1) % LightSamplingMode::LightSamplingModeCount;
+}
+
+void Graphics::ToggleRestir()
+{
+	GlobalResources.RTConstantsData.Restir ^= RestirFlags::RestirEnabled;
+}
+
+void Graphics::ToggleDenoiser()
+{
+	DenoiserEnabled = !DenoiserEnabled;
+	if (DenoiserEnabled)
+		EnableAOVs(DenoiserAOVs);
+	else
+		DisableAOVs(DenoiserAOVs);
+}
+
+void Graphics::CaptureFrame(const std::string& path)
+{
+	CaptureRequests.push_back(path);
+}
+
+void Graphics::StartFrameSequence(const std::string& target, FrameSequenceFormat format)
+{
+	CaptureWriter.ResetStats();
+	Sequence = std::make_unique<FrameSequence>(target, format, SwapChainSize.x, SwapChainSize.y);
+}
+
+// Frames already copied keep their writers and still reach the output
+void Graphics::StopFrameSequence()
+{
+	if (!Sequence)
+		return;
+
+	Sequence.reset();
+	OutputDebugStringA(CaptureWriter.GetStats().ToString().c_str());
+}
+
+void Graphics::ToggleFrameServer()
+{
+	if (FrameServer)
+	{
+		// The GPU may still copy into the mapping
+		Fence->SetEventOnCompletion(FenceValue, FenceEvent);
+		WaitForSingleObject(FenceEvent, INFINITE);
+		FrameServer.reset();
+		PendingSharedFrames = {};
+		return;
+	}
+
+	FrameServer = std::make_unique<SharedFrameServer>();
+	if (!FrameServer->Create(Device, SharedFrameLayout::DefaultName, SwapChainSize))
+	{
+		OutputDebugStringA("Cannot create the shared frame mapping\n");
+		FrameServer.reset();
+	}
+}
+
+void Graphics::CopySharedFrame(uint32_t frameIndex)
+{
+	if (!FrameServer)
+		return;
+
+	PendingSharedFrame& pending = PendingSharedFrames[frameIndex];
+	pending.Slot = FrameServer->BeginFrame();
+	pending.Stats.FrameNumber = GlobalResources.RTConstantsData.FrameIndex;
+	pending.Stats.RaysPerPixel = GetRaysPerPixel();
+	pending.Stats.AccumulatedFrames = AccumulatedFrames;
+	pending.Stats.CpuMilliseconds = FrameDelta * 1000.0f;
+
+	CD3DX12_TEXTURE_COPY_LOCATION destination(FrameServer->GetBuffer(), FrameServer->GetFootprint(pending.Slot));
+	CD3DX12_TEXTURE_COPY_LOCATION source(OutputTexture, 0);
+	CmdList->CopyTextureRegion(&destination, 0, 0, 0, &source, nullptr);
+}
+
+void Graphics::PublishSharedFrame(uint32_t frameIndex, float gpuMilliseconds)
+{
+	PendingSharedFrame& pending = PendingSharedFrames[frameIndex];
+	if (!FrameServer || pending.Slot == ~0u)
+		return;
+
+	pending.Stats.GpuMilliseconds = gpuMilliseconds;
+	FrameServer->PublishFrame(pending.Slot, pending.Stats);
+	pending.Slot = ~0u;
+}
+
+void Graphics::CopyCapture(uint32_t frameIndex)
+{
+	PendingCapture& capture = PendingCaptures[frameIndex];
+	if (capture.Writer || (!Sequence && CaptureRequests.empty()))
+		return;
+
+	std::shared_ptr<ImageWriter> writer;
+	if (Sequence)
+	{
+		writer = Sequence->NextFrame();
+		if (!writer)
+		{
+			OutputDebugStringA("Frame sequence output failed, stopping\n");
+			StopFrameSequence();
+			return;
+		}
+	}
+	else
+	{
+		const std::string path = CaptureRequests.front();
+		CaptureRequests.erase(CaptureRequests.begin());
+		writer = ImageWriter::Create(path, SwapChainSize.x, SwapChainSize.y);
+		if (!writer)
+		{
+			OutputDebugStringA(("Cannot write " + path + "\n").c_str());
+			return;
+		}
+	}
+
+	// OutputTexture is already in the copy source state for the swap chain copy
+	const bool linear = writer->GetPixelFormat() == ImagePixelRGBA16F;
+	ID3D12ResourcePtr source = linear ? ResolvedTexture : OutputTexture;
+	const D3D12_RESOURCE_DESC desc = source->GetDesc();
+	uint64_t size = 0;
+	Device->GetCopyableFootprints(&desc, 0, 1, 0, &capture.Footprint, nullptr, nullptr, &size);
+
+	ID3D12ResourcePtr& readback = CaptureReadbacks[frameIndex];
+	if (!readback || readback->GetDesc().Width < size)
+		readback = D3D::CreateBuffer(Device, size, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_COPY_DEST,
+									 D3D::ReadbackHeapProps);
+
+	if (linear)
+		D3D::ResourceBarrier(CmdList, source, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE);
+	CD3DX12_TEXTURE_COPY_LOCATION destination(readback, capture.Footprint);
+	CD3DX12_TEXTURE_COPY_LOCATION location(source, 0);
+	CmdList->CopyTextureRegion(&destination, 0, 0, 0, &location, nullptr);
+	if (linear)
+		D3D::ResourceBarrier(CmdList, source, D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+
+	capture.Writer = std::move(writer);
+}
+
+// The frame of this swap chain buffer has finished, its rows only need to be repacked without
+// the row pitch padding, the encoding happens on the I/O thread
+void Graphics::ReadCapture(uint32_t frameIndex)
+{
+	PendingCapture& capture = PendingCaptures[frameIndex];
+	if (!capture.Writer)
+		return;
+
+	const uint32_t rowSize = capture.Writer->GetRowSize();
+	const uint32_t height = capture.Footprint.Footprint.Height;
+	uint8_t* data = nullptr;
+	GRAPHICS_ASSERT(CaptureReadbacks[frameIndex]->Map(0, nullptr, reinterpret_cast<void**>(&data)));
+
+	for (uint32_t first = 0; first < height; first += CaptureRowsPerBlock)
+	{
+		ImageRows rows;
+		rows.FirstRow = first;
+		rows.Count = std::min(CaptureRowsPerBlock, height - first);
+		rows.Data.resize(rows.Count * rowSize);
+		for (uint32_t r = 0; r < rows.Count; r++)
+		{
+			const uint8_t* row = data + capture.Footprint.Offset + (first + r) * capture.Footprint.Footprint.RowPitch;
+			std::memcpy(rows.Data.data() + r * rowSize, row, rowSize);
+		}
+		CaptureWriter.Submit(capture.Writer, std::move(rows));
+	}
+
+	D3D12_RANGE written{ 0, 0 };
+	CaptureReadbacks[frameIndex]->Unmap(0, &written);
+	CaptureWriter.Close(std::move(capture.Writer));
+	capture.Writer.reset();
+}
+
+void Graphics::ToggleCheckpoints(const std::string& path)
+{
+	if (!CheckpointPath.empty())
+	{
+		CheckpointPath.clear();
+		return;
+	}
+
+	if (!ProgressiveEnabled)
+		ToggleProgressive();
+	// The file may still be written by the last checkpoint
+	if (CheckpointWrite.valid())
+		CheckpointWrite.wait();
+	CheckpointPath = path;
+	CheckpointAge = 0.0f;
+	ResumeFromCheckpoint();
+}
+
+// Only states that the next frame continues from are saved: full resolution passes without a
+// restart coming up because the camera moved or edits still wait for their refresh
+void Graphics::CopyCheckpoint(uint32_t frameIndex)
+{
+	CheckpointAge += FrameDelta;
+	const auto& rtConstants = GlobalResources.RTConstantsData;
+	if (CheckpointPath.empty() || !ProgressiveEnabled || CheckpointAge < CheckpointInterval ||
+		rtConstants.ProgressiveStride != 1 || StaleFrames != 0 ||
+		SceneCamera.GetEpoch() + Spheres.GetEpoch() != ProgressiveEpoch || CheckpointFrame != ~0u)
+		return;
+	if (CheckpointWrite.valid() && CheckpointWrite.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		return;
+
+	const D3D12_RESOURCE_DESC desc = RadianceTexture->GetDesc();
+	uint64_t size = 0;
+	Device->GetCopyableFootprints(&desc, 0, 1, 0, &CheckpointFootprint, nullptr, nullptr, &size);
+	if (!CheckpointReadback || CheckpointReadback->GetDesc().Width < size)
+		CheckpointReadback = D3D::CreateBuffer(Device, size, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_COPY_DEST,
+											   D3D::ReadbackHeapProps);
+
+	D3D::ResourceBarrier(CmdList, RadianceTexture, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE);
+	CD3DX12_TEXTURE_COPY_LOCATION destination(CheckpointReadback, CheckpointFootprint);
+	CD3DX12_TEXTURE_COPY_LOCATION location(RadianceTexture, 0);
+	CmdList->CopyTextureRegion(&destination, 0, 0, 0, &location, nullptr);
+	D3D::ResourceBarrier(CmdList, RadianceTexture, D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+
+	PendingCheckpoint = Checkpoint{};
+	PendingCheckpoint.SceneHash = GetCheckpointHash();
+	PendingCheckpoint.Size = glm::uvec2(desc.Width, desc.Height);
+	PendingCheckpoint.FrameIndex = rtConstants.FrameIndex;
+	PendingCheckpoint.ProgressiveLevel = ProgressiveLevel;
+	PendingCheckpoint.AccumulatedFrames = AccumulatedFrames;
+	PendingCheckpoint.TileSize = Tiles.GetTileSize();
+	PendingCheckpoint.PrimaryHitCacheJitter = rtConstants.PrimaryHitCacheJitter;
+	PendingCheckpoint.PrimaryHitCacheAge = PrimaryHitCacheAge;
+	PendingCheckpoint.Schedule = Tiles.GetState();
+	CheckpointFrame = frameIndex;
+	CheckpointAge = 0.0f;
+}
+
+// The buffer stays mapped until the thread is done with it, no later checkpoint is copied before
+void Graphics::WriteCheckpoint(uint32_t frameIndex)
+{
+	if (CheckpointFrame != frameIndex)
+		return;
+
+	CheckpointFrame = ~0u;
+	if (CheckpointPath.empty())
+		return;
+
+	uint8_t* data = nullptr;
+	GRAPHICS_ASSERT(CheckpointReadback->Map(0, nullptr, reinterpret_cast<void**>(&data)));
+	CheckpointWrite = std::async(std::launch::async,
+		[checkpoint = std::move(PendingCheckpoint), readback = CheckpointReadback,
+		 rows = data + CheckpointFootprint.Offset, rowPitch = CheckpointFootprint.Footprint.RowPitch,
+		 path = CheckpointPath]()
+		{
+			const bool written = checkpoint.Write(path, rows, rowPitch);
+			D3D12_RANGE range{ 0, 0 };
+			readback->Unmap(0, &range);
+
+			OutputDebugStringA(((written ? "Checkpoint of frame " : "Cannot write the checkpoint of frame ") +
+								std::to_string(checkpoint.FrameIndex) + " to " + path + "\n").c_str());
+			return written;
+		});
+}
+
+// Frames still in flight are ordered before the upload on the queue, their tile errors belong to
+// the discarded accumulation and are dropped
+bool Graphics::ResumeFromCheckpoint()
+{
+	Checkpoint checkpoint;
+	if (!checkpoint.Read(CheckpointPath))
+		return false;
+
+	const D3D12_RESOURCE_DESC desc = RadianceTexture->GetDesc();
+	if (checkpoint.SceneHash != GetCheckpointHash() || checkpoint.Size != glm::uvec2(desc.Width, desc.Height) ||
+		checkpoint.TileSize != Tiles.GetTileSize() || checkpoint.ProgressiveLevel >= ProgressiveStrides.size() ||
+		!Tiles.SetState(std::move(checkpoint.Schedule)))
+	{
+		OutputDebugStringA(("Checkpoint " + CheckpointPath + " is of another scene or view, starting over\n").c_str());
+		Tiles.Reset(RenderSize, ProgressiveTileSize);
+		return false;
+	}
+
+	D3D::UploadTexture(Device, FrameObjects[SwapChain->GetCurrentBackBufferIndex()].CmdAllocator, RadianceTexture,
+					   checkpoint.Radiance, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+	GlobalResources.RTConstantsData.FrameIndex = checkpoint.FrameIndex;
+	ProgressiveLevel = checkpoint.ProgressiveLevel;
+	AccumulatedFrames = checkpoint.AccumulatedFrames;
+	// Cached primary hits continue with the same jitter, the entries in the cache may be of
+	// another view though
+	GlobalResources.RTConstantsData.PrimaryHitCacheJitter = checkpoint.PrimaryHitCacheJitter;
+	PrimaryHitCacheAge = checkpoint.PrimaryHitCacheAge;
+	InvalidatePrimaryHitCache();
+	ProgressiveEpoch = SceneCamera.GetEpoch() + Spheres.GetEpoch();
+	StaleFrames = 0;
+	for (std::vector<uint32_t>& tiles : PendingTiles)
+		tiles.clear();
+	// The reservoirs are not part of the checkpoint, they hold whatever ran before the resume
+	GlobalResources.RTConstantsData.Restir &= ~RestirFlags::RestirHistoryValid;
+	GlobalResources.RTConstantsData.RestirStamp++;
+
+	OutputDebugStringA(("Resumed from " + CheckpointPath + " at frame " + std::to_string(checkpoint.FrameIndex) +
+						" with " + std::to_string(AccumulatedFrames) + " frames accumulated\n").c_str());
+	return true;
+}
+
+// Everything the progressive frames depend on besides the saved state. The focus and region
+// tile priorities follow the cursor and are not covered, they only change the order of tiles
+uint64_t Graphics::GetCheckpointHash() const
+{
+	const auto& rtConstants = GlobalResources.RTConstantsData;
+	uint64_t hash = Checkpoint::Hash(Spheres.Data(), Spheres.Size() * sizeof(Sphere));
+	hash = Checkpoint::Hash(MatArray.data(), MatArray.size() * sizeof(Material), hash);
+	hash = Checkpoint::Hash(SceneCamera.GetViewProjection(), hash);
+	hash = Checkpoint::Hash(SwapChainSize, hash);
+	hash = Checkpoint::Hash(rtConstants.RaysPerPixel, hash);
+	hash = Checkpoint::Hash(rtConstants.MaxDepth, hash);
+	hash = Checkpoint::Hash(rtConstants.SkyHorizon, hash);
+	hash = Checkpoint::Hash(rtConstants.SkyZenith, hash);
+	hash = Checkpoint::Hash(rtConstants.LightSampling, hash);
+	hash = Checkpoint::Hash(rtConstants.Restir & RestirFlags::RestirEnabled, hash);
+	hash = Checkpoint::Hash(rtConstants.PrimaryHitCacheSamples != 0, hash);
+	hash = Checkpoint::Hash(Filter.GetType(), hash);
+	hash = Checkpoint::Hash(TilePriority, hash);
+	return hash;
+}
+
+bool Graphics::StartLargeRender(const std::string& outputPath, const glm::uvec2& size, uint32_t framesPerBlock)
+{
+	if (LargeRender || (LargeRenderWrite.valid() &&
+		LargeRenderWrite.wait_for(std::chrono::seconds(0)) != std::future_status::ready))
+		return false;
+
+	auto render = std::make_unique<LargeRenderState>();
+	const uint32_t tileSize = AccumulationStore::DefaultTileSize;
+	const glm::uvec2 blockTiles = SwapChainSize / tileSize;
+	if (blockTiles.x == 0 || blockTiles.y == 0 || !render->Store.Create(outputPath + ".accumulation", size, tileSize))
+	{
+		OutputDebugStringA(("Cannot render " + outputPath + "\n").c_str());
+		return false;
+	}
+
+	if (ProgressiveEnabled)
+		ToggleProgressive();
+	GovernorEnabled = false;
+
+	render->OutputPath = outputPath;
+	// The field of view of the window spread over the shape of the image, not the window's
+	render->ViewProjection = SceneCamera.GetViewProjection(static_cast<float>(size.x) / size.y);
+	render->CameraPosition = SceneCamera.GetPosition();
+	render->BlockSize = blockTiles * tileSize;
+	render->Blocks = TileScheduler::HilbertOrder((size + render->BlockSize - 1u) / render->BlockSize);
+	render->FramesPerBlock = std::max(framesPerBlock, 1u);
+	LargeRender = std::move(render);
+	return true;
+}
+
+// Moves on to the next block once the current one has all its frames and narrows the view to the
+// block: the block maps to the whole render size, which is the part of the clip space of the
+// image it covers. False once all blocks are traced
+bool Graphics::UpdateLargeRender()
+{
+	LargeRenderState& render = *LargeRender;
+	if (render.FramesLeft == 0)
+	{
+		if (render.NextBlock == render.Blocks.size())
+			return false;
+
+		render.Origin = render.Blocks[render.NextBlock++] * render.BlockSize;
+		render.FramesLeft = render.FramesPerBlock;
+		SetRenderSize(glm::min(render.BlockSize, render.Store.GetSize() - render.Origin));
+		InvalidateHistory();
+		InvalidatePrimaryHitCache();
+
+		render.Store.Prefetch(render.Origin, RenderSize);
+		if (render.NextBlock < render.Blocks.size())
+			render.Store.Prefetch(render.Blocks[render.NextBlock] * render.BlockSize, render.BlockSize);
+	}
+	render.FramesLeft--;
+
+	const glm::vec2 image(render.Store.GetSize());
+	const glm::vec2 scale = glm::vec2(RenderSize) / image;
+	const glm::vec2 origin(render.Origin);
+	const glm::vec2 offset((2.0f * origin.x + RenderSize.x) / image.x - 1.0f,
+						   1.0f - (2.0f * origin.y + RenderSize.y) / image.y);
+	const glm::mat4x4 blockToImage = glm::translate(glm::vec3(offset, 0.0f)) * glm::scale(glm::vec3(scale, 1.0f));
+
+	auto& rtConstants = GlobalResources.RTConstantsData;
+	rtConstants.ViewProjectionInv = glm::inverse(render.ViewProjection) * blockToImage;
+	rtConstants.PreviousViewProjection = glm::inverse(blockToImage) * render.ViewProjection;
+	rtConstants.CameraPosition = render.CameraPosition;
+	rtConstants.PreviousCameraPosition = render.CameraPosition;
+	return true;
+}
+
+void Graphics::CopyLargeRender(uint32_t frameIndex)
+{
+	PendingLargeFrame& pending = PendingLargeFrames[frameIndex];
+	pending.Origin = LargeRender->Origin;
+	pending.Size = RenderSize;
+
+	D3D12_RESOURCE_DESC desc = RadianceTexture->GetDesc();
+	desc.Width = RenderSize.x;
+	desc.Height = RenderSize.y;
+	uint64_t size = 0;
+	Device->GetCopyableFootprints(&desc, 0, 1, 0, &pending.Footprint, nullptr, nullptr, &size);
+
+	ID3D12ResourcePtr& readback = LargeRenderReadbacks[frameIndex];
+	if (!readback || readback->GetDesc().Width < size)
+		readback = D3D::CreateBuffer(Device, size, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_COPY_DEST,
+									 D3D::ReadbackHeapProps);
+
+	const D3D12_BOX box{ 0, 0, 0, RenderSize.x, RenderSize.y, 1 };
+	D3D::ResourceBarrier(CmdList, RadianceTexture, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE);
+	CD3DX12_TEXTURE_COPY_LOCATION destination(readback, pending.Footprint);
+	CD3DX12_TEXTURE_COPY_LOCATION location(RadianceTexture, 0);
+	CmdList->CopyTextureRegion(&destination, 0, 0, 0, &location, &box);
+	D3D::ResourceBarrier(CmdList, RadianceTexture, D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+}
+
+// Adds the completed frame to the store. After the last one the store goes to a thread of its
+// own, which writes the image while the window goes back to the camera view
+void Graphics::ReadLargeRender(uint32_t frameIndex)
+{
+	PendingLargeFrame& pending = PendingLargeFrames[frameIndex];
+	if (LargeRender && pending.Size != glm::uvec2(0))
+	{
+		uint8_t* data = nullptr;
+		GRAPHICS_ASSERT(LargeRenderReadbacks[frameIndex]->Map(0, nullptr, reinterpret_cast<void**>(&data)));
+		LargeRender->Store.Accumulate(pending.Origin, pending.Size, data + pending.Footprint.Offset,
+									  pending.Footprint.Footprint.RowPitch);
+		D3D12_RANGE written{ 0, 0 };
+		LargeRenderReadbacks[frameIndex]->Unmap(0, &written);
+		pending.Size = glm::uvec2(0);
+	}
+
+	const bool framesPending = std::any_of(PendingLargeFrames.begin(), PendingLargeFrames.end(),
+										   [](const PendingLargeFrame& frame) { return frame.Size != glm::uvec2(0); });
+	if (!LargeRender || LargeRender->NextBlock < LargeRender->Blocks.size() || LargeRender->FramesLeft > 0 ||
+		framesPending)
+		return;
+
+	LargeRenderWrite = std::async(std::launch::async, [render = std::shared_ptr<LargeRenderState>(std::move(LargeRender))]()
+	{
+		const bool written = render->Store.WriteExr(render->OutputPath);
+		OutputDebugStringA(((written ? "Wrote " : "Cannot write ") + render->OutputPath + "\n").c_str());
+		return written;
+	});
+	ApplyWorkload(FrameWorkload{ .RaysPerPixel = GetRaysPerPixel(), .RenderScale = 1.0f });
+	InvalidateHistory();
+	InvalidatePrimaryHitCache();
+}
+
+void Graphics::ToggleAutoExposure()
+{
+	AutoExposure = !AutoExposure;
+}
+
+void Graphics::AdjustExposure(float stops)
+{
+	ExposureBias = glm::clamp(ExposureBias + stops, -MaxExposureBias, MaxExposureBias);
+}
+
+void Graphics::SetPixelFilter(PixelFilterType type)
+{
+	Filter = PixelFilter(type);
+	auto& rtConstants = GlobalResources.RTConstantsData;
+	rtConstants.PixelFilterWeight = Filter.BuildSampleTable(rtConstants.PixelFilterTable);
+	InvalidateHistory();
+}
+
+void Graphics::CyclePixelFilter()
+{
+	SetPixelFilter(static_cast<PixelFilterType>((Filter.GetType() + 1) % PixelFilterTypeCount));
+}
+
+void Graphics::ToggleTemporalAccumulation()
+{
+	TemporalEnabled = !TemporalEnabled;
+	HistoryValid = false;
+	if (TemporalEnabled)
+		EnableAOVs(TemporalAOVs);
+	else
+		DisableAOVs(TemporalAOVs);
+}
+
+void Graphics::SetRaysPerPixel(uint32_t raysPerPixel)
+{
+	GlobalResources.RTConstantsData.RaysPerPixel = std::clamp(raysPerPixel, 1u, 64u);
+	Governor.Reset(FrameWorkload{ .RaysPerPixel = GlobalResources.RTConstantsData.RaysPerPixel,
+								  .RenderScale = Governor.GetWorkload().RenderScale });
+}
+
+void Graphics::ToggleProgressive()
+{
+	if (LargeRender)
+		return;
+
+	ProgressiveEnabled = !ProgressiveEnabled;
+	GlobalResources.RTConstantsData.ProgressiveStride = 0;
+	GlobalResources.RTConstantsData.TileCount = 0;
+	if (ProgressiveEnabled)
+	{
+		GovernorEnabled = false;
+		RenderScaleIndex = 0;
+		ApplyWorkload(FrameWorkload{ .RaysPerPixel = GetRaysPerPixel(), .RenderScale = 1.0f });
+	}
+	InvalidateHistory();
+}
+
+// Picks the ladder level and the tiles of this frame. A camera move or scene edit bumps the
+// epoch, which drops the rest of the stale pass and restarts from the coarsest level right away
+glm::uvec3 Graphics::UpdateProgressive(uint32_t frameIndex)
+{
+	auto& rtConstants = GlobalResources.RTConstantsData;
+	const uint64_t epoch = SceneCamera.GetEpoch() + Spheres.GetEpoch();
+	if (epoch != ProgressiveEpoch)
+	{
+		ProgressiveEpoch = epoch;
+		InvalidateHistory();
+	}
+	// Indirect light outside the footprints of edits is stale, it is refreshed after a while
+	if (StaleFrames > 0 && --StaleFrames == 0)
+		InvalidateHistory();
+
+	const uint32_t stride = ProgressiveStrides[ProgressiveLevel];
+	rtConstants.ProgressiveStride = stride;
+
+	if (stride > 1)
+	{
+		ProgressiveLevel++;
+		rtConstants.TileCount = 0;
+		return glm::uvec3((RenderSize + stride - 1u) / stride, 1);
+	}
+
+	// Full resolution passes trace the most urgent tiles, so new input waits for one batch of
+	// tiles at most instead of a whole pass with all rays per pixel
+	const std::vector<uint32_t>& tiles = Tiles.Schedule(MaxTilesPerFrame);
+	rtConstants.TileResets = glm::uvec2(0);
+	for (uint32_t i = 0; i < tiles.size(); i++)
+	{
+		const glm::uvec2 origin = Tiles[tiles[i]].Bounds.Min;
+		rtConstants.TileOrigins[i / 4][i % 4] = origin.x | (origin.y << 16);
+		if (Tiles.ConsumeReset(tiles[i]))
+			rtConstants.TileResets[i / 32] |= 1u << (i % 32);
+	}
+	rtConstants.TileSize = Tiles.GetTileSize();
+	rtConstants.TileCount = static_cast<uint32_t>(tiles.size());
+	PendingTiles[frameIndex] = tiles;
+	PendingTileEpochs[frameIndex] = epoch;
+
+	return glm::uvec3(rtConstants.TileSize, rtConstants.TileSize, rtConstants.TileCount);
+}
+
+void Graphics::CycleTilePriority()
+{
+	TilePriority = (TilePriority + 1) % TilePriorityModeCount;
+	UpdateTilePriority();
+}
+
+void Graphics::SetFocus(const glm::vec2& focus)
+{
+	Focus = focus;
+	if (TilePriority == TilePriorityFocus)
+		UpdateTilePriority();
+}
+
+void Graphics::SetRegionOfInterest(const TileRect& region)
+{
+	RegionOfInterest = region;
+	if (TilePriority == TilePriorityRegion)
+		UpdateTilePriority();
+}
+
+void Graphics::UpdateTilePriority()
+{
+	switch (TilePriority)
+	{
+	case TilePriorityFocus:
+		Tiles.SetPriority(TileScheduler::FocusPriority(Focus, 4.0f * ProgressiveTileSize));
+		break;
+	case TilePriorityRegion:
+		Tiles.SetPriority(TileScheduler::RegionPriority({ RegionOfInterest }));
+		break;
+	case TilePriorityError:
+		Tiles.SetPriority(TileScheduler::ErrorPriority());
+		break;
+	default:
+		Tiles.SetPriority(nullptr);
+		break;
+	}
+}
+
+void Graphics::TogglePrimaryHitCache()
+{
+	auto& rtConstants = GlobalResources.RTConstantsData;
+	if (rtConstants.PrimaryHitCacheSamples != 0)
+	{
+		rtConstants.PrimaryHitCacheSamples = 0;
+		return;
+	}
+
+	// Three words per sample, created on first use like the AOVs
+	if (PrimaryHitCache == nullptr)
+	{
+		const uint32_t count = 3 * PrimaryHitCacheSamples * SwapChainSize.x * SwapChainSize.y;
+		PrimaryHitCache = D3D::CreateBuffer(Device, static_cast<uint64_t>(count) * sizeof(uint32_t),
+											D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
+											D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D::DefaultHeapProps);
+
+		D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc{};
+		uavDesc.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
+		uavDesc.Format = DXGI_FORMAT_R32_UINT;
+		uavDesc.Buffer.FirstElement = 0;
+		uavDesc.Buffer.NumElements = count;
+		rtConstants.PrimaryHitCacheIndex = CreateUAV(PrimaryHitCache, uavDesc);
+	}
+
+	rtConstants.PrimaryHitCacheSamples = PrimaryHitCacheSamples;
+	InvalidatePrimaryHitCache();
+}
+
+// Every view, render size or geometry change gets a new stamp, entries with an older one are
+// traced again and overwritten, so the cache never has to be cleared
+void Graphics::InvalidatePrimaryHitCache()
+{
+	GlobalResources.RTConstantsData.PrimaryHitCacheStamp++;
+}
+
+// The jitter of the cached samples advances every PrimaryHitCacheFrames frames. Otherwise their
+// sub-pixel positions would stay fixed and accumulation would converge to the image of those few
+// positions instead of the filtered one. It only depends on the frames since the start, so a
+// checkpoint can restore it
+void Graphics::UpdatePrimaryHitCache()
+{
+	const uint64_t epoch = SceneCamera.GetEpoch() + Spheres.GetEpoch();
+	if (epoch != PrimaryHitCacheEpoch)
+	{
+		PrimaryHitCacheEpoch = epoch;
+		InvalidatePrimaryHitCache();
+	}
+	if (++PrimaryHitCacheAge >= PrimaryHitCacheFrames)
+	{
+		PrimaryHitCacheAge = 0;
+		GlobalResources.RTConstantsData.PrimaryHitCacheJitter++;
+		InvalidatePrimaryHitCache();
+	}
+}
+
+void Graphics::ToggleFrameGovernor()
+{
+	if (ProgressiveEnabled || LargeRender)
+		return;
+
+	GovernorEnabled = !GovernorEnabled;
+	if (!GovernorEnabled)
+		ApplyWorkload(FrameWorkload{ .RaysPerPixel = GetRaysPerPixel(), .RenderScale = 1.0f });
+	Governor.Reset(FrameWorkload{ .RaysPerPixel = GetRaysPerPixel(),
+								  .RenderScale = static_cast<float>(RenderSize.x) / SwapChainSize.x });
+	OutputDebugStringA(GovernorEnabled ? Governor.ToString().c_str() : "Frame governor off\n");
+}
+
+D3D12_DISPATCH_RAYS_DESC Graphics::GetDispatchRaysDesc(uint32_t rayGenEntry, const glm::uvec3& size) const
+{
+	D3D12_DISPATCH_RAYS_DESC desc{};
+	desc.Width = size.x;
+	desc.Height = size.y;
+	desc.Depth = size.z;
+
+	const D3D12_GPU_VIRTUAL_ADDRESS start = ShaderTable->GetGPUVirtualAddress();
+	desc.RayGenerationShaderRecord.StartAddress = start + rayGenEntry * ShaderTableEntrySize;
+	desc.RayGenerationShaderRecord.SizeInBytes = ShaderTableEntrySize;
+
+	desc.MissShaderTable.StartAddress = start + ShaderTableLayout::MissEntries * ShaderTableEntrySize;
+	desc.MissShaderTable.StrideInBytes = ShaderTableEntrySize;
+	desc.MissShaderTable.SizeInBytes = ShaderTableLayout::NumMissEntries * ShaderTableEntrySize;
+
+	desc.HitGroupTable.StartAddress = start + ShaderTableLayout::HitGroupEntries * ShaderTableEntrySize;
+	desc.HitGroupTable.StrideInBytes = ShaderTableEntrySize;
+	desc.HitGroupTable.SizeInBytes = ShaderTableLayout::NumHitGroupEntries * ShaderTableEntrySize;
+	return desc;
+}
+
+// Timestamps of a swap chain buffer are read back when the buffer comes around again, by then
+// EndFrame has waited for the frame that wrote them
+float Graphics::ReadFrameTime(uint32_t frameIndex)
+{
+	if (!TimestampsPending[frameIndex])
+		return 0.0f;
+	TimestampsPending[frameIndex] = false;
+
+	D3D12_RANGE range{ 2 * frameIndex * sizeof(uint64_t), (2 * frameIndex + 2) * sizeof(uint64_t) };
+	uint64_t* timestamps = nullptr;
+	GRAPHICS_ASSERT(TimestampReadback->Map(0, &range, reinterpret_cast<void**>(&timestamps)));
+	uint64_t ticks = timestamps[2 * frameIndex + 1] - timestamps[2 * frameIndex];
+	D3D12_RANGE written{ 0, 0 };
+	TimestampReadback->Unmap(0, &written);
+
+	return static_cast<float>(1000.0 * ticks / TimestampFrequency);
+}
+
+// Error sums of the tiles traced by a frame, read back once the frame completed. Results of an
+// older epoch belong to a pass that was already dropped
+void Graphics::ReadTileErrors(uint32_t frameIndex)
+{
+	std::vector<uint32_t>& tiles = PendingTiles[frameIndex];
+	if (tiles.empty())
+		return;
+
+	if (PendingTileEpochs[frameIndex] == ProgressiveEpoch)
+	{
+		const uint64_t offset = frameIndex * MaxTilesPerFrame * sizeof(uint32_t);
+		D3D12_RANGE range{ offset, offset + tiles.size() * sizeof(uint32_t) };
+		uint8_t* data = nullptr;
+		GRAPHICS_ASSERT(TileErrorReadback->Map(0, &range, reinterpret_cast<void**>(&data)));
+		const uint32_t* sums = reinterpret_cast<const uint32_t*>(data + offset);
+
+		for (uint32_t i = 0; i < tiles.size(); i++)
+		{
+			const TileRect& bounds = Tiles[tiles[i]].Bounds;
+			const glm::uvec2 size = bounds.Max - bounds.Min;
+			Tiles.ReportError(tiles[i], sums[i] / (1024.0f * size.x * size.y));
+		}
+
+		D3D12_RANGE written{ 0, 0 };
+		TileErrorReadback->Unmap(0, &written);
+	}
+	tiles.clear();
+}
+
+void Graphics::CopyTileErrors(uint32_t frameIndex)
+{
+	const uint64_t size = MaxTilesPerFrame * sizeof(uint32_t);
+	D3D::ResourceBarrier(CmdList, TileErrors, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE);
+	CmdList->CopyBufferRegion(TileErrorReadback, frameIndex * size, TileErrors, 0, size);
+	D3D::ResourceBarrier(CmdList, TileErrors, D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_COPY_DEST);
+	CmdList->CopyBufferRegion(TileErrors, 0, TileErrorZeros, 0, size);
+	D3D::ResourceBarrier(CmdList, TileErrors, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+}
+
+void Graphics::ApplyWorkload(const FrameWorkload& workload)
+{
+	GlobalResources.RTConstantsData.RaysPerPixel = workload.RaysPerPixel;
+
+	glm::uvec2 renderSize = glm::max(glm::uvec2(glm::vec2(SwapChainSize) * workload.RenderScale + 0.5f), glm::uvec2(1));
+	SetRenderSize(glm::min(renderSize, SwapChainSize));
+}
+
+void Graphics::SetRenderSize(const glm::uvec2& renderSize)
+{
+	if (renderSize != RenderSize)
+	{
+		RenderSize = renderSize;
+		GlobalResources.RTConstantsData.RenderSize = RenderSize;
+		InvalidateHistory();
+		InvalidatePrimaryHitCache();
+
+		if (RenderSize != SwapChainSize)
+			EnableAOVs(UpscaleAOVs);
+		else
+			DisableAOVs(UpscaleAOVs);
+	}
+}
+
+void Graphics::CycleRenderScale()
+{
+	if (ProgressiveEnabled || LargeRender)
+		return;
+
+	const std::array<float, 3> scales = { 1.0f, 0.5f, 0.25f };
+	RenderScaleIndex = (RenderScaleIndex + 1) % scales.size();
+
+	FrameWorkload workload{ .RaysPerPixel = GetRaysPerPixel(), .RenderScale = scales[RenderScaleIndex] };
+	ApplyWorkload(workload);
+	Governor.Reset(workload);
+}
+
+// Per-pixel history is addressed by render resolution and can not survive a change of it
+void Graphics::InvalidateHistory()
+{
+	HistoryValid = false;
+	GlobalResources.RTConstantsData.Restir &= ~RestirFlags::RestirHistoryValid;
+	GlobalResources.RTConstantsData.RestirStamp++;
+	ProgressiveLevel = 0;
+	StaleFrames = 0;
+	AccumulatedFrames = 0;
+	Tiles.Reset(RenderSize, ProgressiveTileSize);
+}
+
+bool Graphics::EditSphere(uint32_t index, const Sphere& sphere)
+{
+	const SphereEdit edit{ .Index = index, .Value = sphere };
+	return Snapshots->Publish(std::span<const SphereEdit>(&edit, 1)) != 0;
+}
+
+Sphere Graphics::GetSphere(uint32_t index) const
+{
+	const SnapshotPin snapshot = Snapshots->Pin();
+	assert(index < snapshot->Size && "Sphere index out of range");
+	return (*snapshot)[index];
+}
+
+// Only chunks a writer copied since the last frame can differ from the spheres
+void Graphics::ApplySnapshot(const SceneSnapshot& snapshot)
+{
+	assert(snapshot.Chunks.size() == AppliedChunks.size() && "Edits must keep the number of spheres");
+	for (uint32_t chunk = 0; chunk < snapshot.Chunks.size(); chunk++)
+	{
+		if (snapshot.Chunks[chunk] == AppliedChunks[chunk])
+			continue;
+
+		const uint32_t first = chunk * SceneSnapshot::ChunkSize;
+		const std::span<const Sphere> spheres = snapshot.Chunks[chunk]->Spheres;
+		for (uint32_t i = 0; i < spheres.size(); i++)
+		{
+			if (std::memcmp(&spheres[i].Data, &Spheres[first + i].Data, sizeof(SphereInfo)) != 0)
+				QueueEdit(first + i, spheres[i]);
+		}
+		AppliedChunks[chunk] = snapshot.Chunks[chunk];
+	}
+}
+
+void Graphics::QueueEdit(uint32_t index, const Sphere& sphere)
+{
+	if (ProgressiveEnabled)
+	{
+		TileRect footprint = GetScreenFootprint(Spheres[index]);
+		const TileRect footprintAfter = GetScreenFootprint(sphere);
+		footprint.Min = glm::min(footprint.Min, footprintAfter.Min);
+		footprint.Max = glm::max(footprint.Max, footprintAfter.Max);
+		Tiles.Invalidate(footprint);
+
+		if (StaleFrames == 0)
+			StaleFrames = EditRefreshFrames;
+	}
+	PendingEdits[index] = sphere;
+}
+
+void Graphics::SetEditRefreshFrames(uint32_t frames)
+{
+	EditRefreshFrames = frames;
+}
+
+// Conservative pixel rectangle covered by the bounds of a sphere, grown by EditMargin for the
+// reconstruction and denoising filters. Bounds reaching behind the camera cover everything
+TileRect Graphics::GetScreenFootprint(const Sphere& sphere) const
+{
+	const TileRect everything{ glm::uvec2(0), RenderSize };
+	const glm::mat4x4& viewProjection = SceneCamera.GetViewProjection();
+
+	glm::vec2 lower(std::numeric_limits<float>::max()), upper(std::numeric_limits<float>::lowest());
+	for (uint32_t corner = 0; corner < 8; corner++)
+	{
+		glm::vec3 offset((corner & 1) ? 1.0f : -1.0f, (corner & 2) ? 1.0f : -1.0f, (corner & 4) ? 1.0f : -1.0f);
+		glm::vec4 clip = viewProjection * glm::vec4(sphere.Center + sphere.Radius * offset, 1.0f);
+		if (clip.w <= 0.0f)
+			return everything;
+
+		// Same convention as reprojectToPreviousFrame in the shaders
+		glm::vec2 ndc = glm::vec2(clip) / clip.w;
+		glm::vec2 pixel = glm::vec2(0.5f * ndc.x + 0.5f, 0.5f - 0.5f * ndc.y) * glm::vec2(RenderSize);
+		lower = glm::min(lower, pixel);
+		upper = glm::max(upper, pixel);
+	}
+
+	lower = glm::clamp(lower - float(EditMargin), glm::vec2(0.0f), glm::vec2(RenderSize));
+	upper = glm::clamp(upper + float(EditMargin) + 1.0f, glm::vec2(0.0f), glm::vec2(RenderSize));
+	return TileRect{ glm::uvec2(lower), glm::uvec2(upper) };
+}
+
+// Edits are copied into the scene buffers on the command list of the frame, the frames still in
+// flight keep the version they were recorded with and nothing waits for them
+void Graphics::ApplySceneEdits(uint32_t frameIndex)
+{
+	// EndFrame has waited for the last frame that used the slot
+	Uploads.Begin(frameIndex);
+	if (PendingEdits.empty())
+		return;
+
+	bool moved = false;
+	bool lightsChanged = false;
+	for (const auto& [index, sphere] : PendingEdits)
+	{
+		const Sphere& current = Spheres[index];
+		const bool emissive = sphere.Type == MaterialType::Emissive;
+		// Light buffers are only refitted, Publish rejects edits that add or remove a light
+		assert(emissive == (current.Type == MaterialType::Emissive) && "Edits must not change the set of lights");
+		moved |= sphere.Center != current.Center || sphere.Radius != current.Radius;
+		lightsChanged |= emissive;
+		Spheres.Update(index, sphere);
+	}
+	PendingEdits.clear();
+
+	// Only the edited ranges are copied to the sphere and instance buffers and refitted
+	const SphereChanges changes = Spheres.Commit();
+	assert(!changes.Reallocated && !changes.Resized && "Only Update may change spheres after the build");
+	Spheres.Upload(CmdList, Uploads);
+	if (moved)
+	{
+		DXR::UpdateTopLevelAS(CmdList, BottomLevelAS, Spheres, changes, TopLevelBuffers, Uploads);
+		InvalidatePrimaryHitCache();
+	}
+
+	if (lightsChanged)
+	{
+		Lights.Refit(Spheres, changes);
+		Uploads.Write(CmdList, LightsBuffer, Lights.Data());
+		Uploads.Write(CmdList, LightNodesBuffer, Lights.GetHierarchy().Data());
+	}
+}
+
+void Graphics::CycleAOVView()
+{
+	uint32_t previous = View;
+	View = (View + 1) % AOVView::AOVViewCount;
+	if (previous != AOVView::AOVViewNone)
+		DisableAOVs(1u << (previous - 1));
+	if (View != AOVView::AOVViewNone)
+		EnableAOVs(1u << (View - 1));
+}
+
+void Graphics::EnableAOVs(uint32_t mask)
+{
+	auto& rtConstants = GlobalResources.RTConstantsData;
+	const std::array<UINT*, AOVFlags::AOVCount> indices =
+	{
+		&rtConstants.AlbedoIndex,
+		&rtConstants.NormalIndex,
+		&rtConstants.DepthIndex,
+		&rtConstants.InstanceIDIndex,
+		&rtConstants.BounceCountIndex
+	};
+	const std::array<DXGI_FORMAT, AOVFlags::AOVCount> formats =
+	{
+		DXGI_FORMAT_R32G32B32A32_FLOAT,
+		DXGI_FORMAT_R32G32B32A32_FLOAT,
+		DXGI_FORMAT_R32_FLOAT,
+		DXGI_FORMAT_R32_UINT,
+		DXGI_FORMAT_R32_UINT
+	};
+
+	for (uint32_t i = 0; i < AOVFlags::AOVCount; i++)
+	{
+		if (!(mask & (1u << i)) || AOVTextures[i])
+			continue;
+
+		AOVTextures[i] = D3D::CreateTexture2D(Device, SwapChainSize, formats[i], D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
+											  D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		*indices[i] = CreateTextureUAV(AOVTextures[i], formats[i]);
+	}
+
+	rtConstants.AOVMask |= mask;
+}
+
+void Graphics::DisableAOVs(uint32_t mask)
+{
+	if (DenoiserEnabled)
+		mask &= ~DenoiserAOVs;
+	if (TemporalEnabled)
+		mask &= ~TemporalAOVs;
+	if (RenderSize != SwapChainSize)
+		mask &= ~UpscaleAOVs;
+	if (View != AOVView::AOVViewNone)
+		mask &= ~(1u << (View - 1));
+	GlobalResources.RTConstantsData.AOVMask &= ~mask;
+}
+
+// Logs the result like the other reports of the renderer, it is also returned for tools
+LightSelectionBenchmark Graphics::BenchmarkLightSampling() const
+{
+	const LightSelectionBenchmark result = Lights.Benchmark(Spheres, 1.0f);
+	OutputDebugStringA(result.ToString().c_str());
+	return result;
+}
+
 void Graphics::Init()
 {
 #ifndef NDEBUG
@@ -207,14 +1293,24 @@ void Graphics::CreateSwapChain()
 void Graphics::CreateRTPipelaneState()
 {
 	std::vector<D3D12_STATE_SUBOBJECT> subobjects;
-	subobjects.reserve(12);
+	// ExportAssociation keeps a pointer into the vector, it must never reallocate
+	subobjects.reserve(16);
 
 	ShaderProgram rayGenShader("RayGen.hlsl", L"rayGen");
 	subobjects.push_back(rayGenShader.Subobject);
 
+	ShaderProgram guideRayGenShader("GuideRayGen.hlsl", L"guideRayGen");
+	subobjects.push_back(guideRayGenShader.Subobject);
+
 	ShaderProgram missShader("Miss.hlsl", L"miss");
 	subobjects.push_back(missShader.Subobject);
 
+	ShaderProgram shadowMissShader("ShadowMiss.hlsl", L"shadowMiss");
+	subobjects.push_back(shadowMissShader.Subobject);
+
+	ShaderProgram guideMissShader("GuideMiss.hlsl", L"guideMiss");
+	subobjects.push_back(guideMissShader.Subobject);
+
 	ShaderProgram intersectionShader("Intersection.hlsl", L"intersection");
 	subobjects.push_back(intersectionShader.Subobject);
 
@@ -224,10 +1320,17 @@ void Graphics::CreateRTPipelaneState()
 	HitGroup hitGroup(L"intersection", nullptr, L"chs", L"HitGroup");
 	subobjects.push_back(hitGroup.Subobject);
 
+	ShaderProgram guideClosestHitShader("GuideClosestHit.hlsl", L"guideChs");
+	subobjects.push_back(guideClosestHitShader.Subobject);
+
+	HitGroup guideHitGroup(L"intersection", nullptr, L"guideChs", L"GuideHitGroup");
+	subobjects.push_back(guideHitGroup.Subobject);
+
 	ShaderConfig shaderConfig(10 * sizeof(float));
 	subobjects.push_back(shaderConfig.Subobject);
 
-	const WCHAR* shaderConfigExportNames[] = { L"rayGen", L"miss", L"HitGroup" };
+	const WCHAR* shaderConfigExportNames[] = { L"rayGen", L"guideRayGen", L"miss", L"shadowMiss", L"guideMiss",
+											   L"HitGroup", L"GuideHitGroup" };
 	ExportAssociation shaderConfigAssociation(shaderConfigExportNames, arraysize(shaderConfigExportNames), &subobjects.back());
 	subobjects.push_back(shaderConfigAssociation.Subobject);
 
@@ -251,8 +1354,8 @@ void Graphics::CreateAccelerationStructures()
 	//ID3D12ResourcePtr vertexBuffer = createTriangleVB(Device);
 	ID3D12ResourcePtr vertexBuffer = Sphere::CreateSphereAABB(Device);
 	DXR::AccelerationStructureBuffers bottomLevelBuffers = DXR::CreateBottomLevelAS(Device, CmdList, vertexBuffer);
-	DXR::AccelerationStructureBuffers topLevelBuffers = DXR::CreateTopLevelAS(Device, CmdList, bottomLevelBuffers.Result,
-																			  Spheres, tLasSize);
+	TopLevelBuffers = DXR::CreateTopLevelAS(Device, CmdList, bottomLevelBuffers.Result, Spheres, Uploads, tLasSize);
+	BottomLevelAS = bottomLevelBuffers.Result;
 
 	FenceValue = D3D::SubmitCommandList(CmdList, CmdQueue, Fence, FenceValue);
 	Fence->SetEventOnCompletion(FenceValue, FenceEvent);
@@ -260,30 +1363,18 @@ void Graphics::CreateAccelerationStructures()
 	uint32_t bufferIndex = SwapChain->GetCurrentBackBufferIndex();
 	CmdList->Reset(FrameObjects[0].CmdAllocator, nullptr);
 
-	GlobalResources.SetSceneAccelerationStructures(bottomLevelBuffers.Result, topLevelBuffers.Result, tLasSize);
+	GlobalResources.SetSceneAccelerationStructures(bottomLevelBuffers.Result, TopLevelBuffers.Result, tLasSize);
 }
 
 void Graphics::CreateShaderResources()
 {
-	D3D12_RESOURCE_DESC resDesc{};
-	resDesc.DepthOrArraySize = 1;
-	resDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
-	resDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-	resDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
-	resDesc.Width = SwapChainSize.x;
-	resDesc.Height = SwapChainSize.y;
-	resDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
-	resDesc.MipLevels = 1;
-	resDesc.SampleDesc.Count = 1;
-	resDesc.SampleDesc.Quality = 0;
-	GRAPHICS_ASSERT(Device->CreateCommittedResource(&D3D::DefaultHeapProps, D3D12_HEAP_FLAG_NONE,
-													&resDesc, D3D12_RESOURCE_STATE_COPY_SOURCE, nullptr, IID_PPV_ARGS(&OutputTexture)));
+	OutputTexture = D3D::CreateTexture2D(Device, SwapChainSize, DXGI_FORMAT_R8G8B8A8_UNORM,
+										 D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE);
+	// gOutput is bound to u0 of space0, it has to take the first slot
+	CreateTextureUAV(OutputTexture, DXGI_FORMAT_UNKNOWN);
 
-	auto uavHandle = GlobalResources.UAVHeap->GetCPUDescriptorHandleForHeapStart();
-	D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc{};
-	uavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
-	Device->CreateUnorderedAccessView(OutputTexture, nullptr, &uavDesc,
-									  uavHandle);
+	CreateReservoirBuffers();
+	CreatePostProcessResources();
 
 	auto srvHandle = GlobalResources.SRVHeap->GetCPUDescriptorHandleForHeapStart();
 
@@ -301,26 +1392,18 @@ void Graphics::CreateShaderResources()
 	GlobalResources.RTConstantsData.TexturesOffset = 1;
 
 	// Describe and create a Texture2D.
-	resDesc.Format = DXGI_FORMAT_R32G32B32_FLOAT;
-	resDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
-
-	GRAPHICS_ASSERT(Device->CreateCommittedResource(
-		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-		D3D12_HEAP_FLAG_NONE,
-		&resDesc,
-		D3D12_RESOURCE_STATE_GENERIC_READ,
-		nullptr,
-		IID_PPV_ARGS(&Texture)));
+	Texture = D3D::CreateTexture2D(Device, SwapChainSize, DXGI_FORMAT_R32G32B32_FLOAT,
+								   D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_GENERIC_READ);
 
 	// Describe and create a SRV for the texture.
 	srvDesc = {};
 	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	srvDesc.Format = resDesc.Format;
+	srvDesc.Format = DXGI_FORMAT_R32G32B32_FLOAT;
 	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
 	srvDesc.Texture2D.MipLevels = 1;
 	Device->CreateShaderResourceView(Texture, &srvDesc, srvHandle);
 
-	std::vector<glm::vec3> texture = GenerateTextureData(SwapChainSize);
+	std::vector<glm::vec3> texture = GenerateTextureData(SwapChainSize, GlobalResources.RTConstantsData.FrameIndex);
 	D3D::UploadTexture(Device, FrameObjects[SwapChain->GetCurrentBackBufferIndex()].CmdAllocator, Texture, texture);
 	GlobalResources.RTConstantsData.RandomNumbersIndex = 0;
 
@@ -339,6 +1422,30 @@ void Graphics::CreateShaderResources()
 	srvDesc.Buffer.StructureByteStride = sizeof(decltype(MatArray)::value_type);
 	srvDesc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_NONE;
 	Device->CreateShaderResourceView(Materials, &srvDesc, srvHandle);
+
+	srvHandle.ptr += Device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+	GlobalResources.RTConstantsData.LightsOffset = 3;
+	GlobalResources.RTConstantsData.LightCount = Lights.Size();
+
+	// Edits write the light buffers on the command list, they live in the default heap
+	LightsBuffer = D3D::CreateBuffer(Device, sizeof(decltype(Lights)::ValueType) * Lights.Data().size(), D3D12_RESOURCE_FLAG_NONE,
+									 D3D12_RESOURCE_STATE_COMMON, D3D::DefaultHeapProps);
+	Uploads.Write(CmdList, LightsBuffer, Lights.Data());
+
+	srvDesc.Buffer.NumElements = Lights.BufferSize();
+	srvDesc.Buffer.StructureByteStride = sizeof(decltype(Lights)::ValueType);
+	Device->CreateShaderResourceView(LightsBuffer, &srvDesc, srvHandle);
+
+	srvHandle.ptr += Device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+	GlobalResources.RTConstantsData.LightNodesOffset = 4;
+
+	LightNodesBuffer = D3D::CreateBuffer(Device, sizeof(LightBVH::ValueType) * Lights.GetHierarchy().Data().size(), D3D12_RESOURCE_FLAG_NONE,
+										 D3D12_RESOURCE_STATE_COMMON, D3D::DefaultHeapProps);
+	Uploads.Write(CmdList, LightNodesBuffer, Lights.GetHierarchy().Data());
+
+	srvDesc.Buffer.NumElements = Lights.GetHierarchy().Size();
+	srvDesc.Buffer.StructureByteStride = sizeof(LightBVH::ValueType);
+	Device->CreateShaderResourceView(LightNodesBuffer, &srvDesc, srvHandle);
 	
 	// -----------------------------------------------------------------------------
 	// GPU-CPU synchronization for not releasing stack-allocated resources too early
@@ -348,13 +1455,254 @@ void Graphics::CreateShaderResources()
 	CmdList->Reset(FrameObjects[0].CmdAllocator, nullptr);
 }
 
+void Graphics::CreateReservoirBuffers()
+{
+	// Per set: light index, sample position, weights, surface. Two sets for ping-ponging
+	const std::array<DXGI_FORMAT, NumReservoirBuffers / 2> formats =
+	{
+		DXGI_FORMAT_R32_UINT,
+		DXGI_FORMAT_R32G32B32A32_FLOAT,
+		DXGI_FORMAT_R32G32B32A32_FLOAT,
+		DXGI_FORMAT_R32G32B32A32_FLOAT
+	};
+	const std::array<uint32_t, NumReservoirBuffers / 2> strides = { 4, 16, 16, 16 };
+	const uint32_t count = SwapChainSize.x * SwapChainSize.y;
+
+	for (uint32_t i = 0; i < NumReservoirBuffers; i++)
+	{
+		const uint32_t field = i % formats.size();
+		ReservoirBuffers[i] = D3D::CreateBuffer(Device, static_cast<uint64_t>(count) * strides[field],
+												D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
+												D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D::DefaultHeapProps);
+
+		D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc{};
+		uavDesc.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
+		uavDesc.Format = formats[field];
+		uavDesc.Buffer.FirstElement = 0;
+		uavDesc.Buffer.NumElements = count;
+		uint32_t index = CreateUAV(ReservoirBuffers[i], uavDesc);
+		if (i == 0)
+			GlobalResources.RTConstantsData.ReservoirsOffset = index;
+	}
+}
+
+void Graphics::CreatePostProcessResources()
+{
+	auto createTexture = [this](DXGI_FORMAT format, ID3D12ResourcePtr& texture)
+	{
+		texture = D3D::CreateTexture2D(Device, SwapChainSize, format, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
+									   D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		return CreateTextureUAV(texture, format);
+	};
+
+	GlobalResources.RTConstantsData.RadianceIndex = createTexture(DXGI_FORMAT_R32G32B32A32_FLOAT, RadianceTexture);
+	for (uint32_t i = 0; i < DenoiseTargets.size(); i++)
+		DenoiseTargetIndices[i] = createTexture(DXGI_FORMAT_R32G32B32A32_FLOAT, DenoiseTargets[i]);
+
+	if (DenoiserEnabled)
+		EnableAOVs(DenoiserAOVs);
+	if (TemporalEnabled)
+		EnableAOVs(TemporalAOVs);
+
+	CreateHistoryTextures();
+	CreateUpscaleGuides();
+	CreateTileErrorBuffers();
+	CreateOutputStageResources();
+}
+
+void Graphics::CreateUpscaleGuides()
+{
+	const std::array<DXGI_FORMAT, 3> formats =
+	{
+		DXGI_FORMAT_R32G32B32A32_FLOAT,
+		DXGI_FORMAT_R32G32B32A32_FLOAT,
+		DXGI_FORMAT_R32_UINT
+	};
+
+	for (uint32_t i = 0; i < UpscaleGuides.size(); i++)
+	{
+		UpscaleGuides[i] = D3D::CreateTexture2D(Device, SwapChainSize, formats[i], D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
+												D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		uint32_t index = CreateTextureUAV(UpscaleGuides[i], formats[i]);
+		if (i == 0)
+			GlobalResources.RTConstantsData.UpscaleGuidesOffset = index;
+	}
+}
+
+// Per tile error sums of the progressive passes, copied to a readback slice per swap chain
+// buffer and cleared from an upload buffer of zeros after every frame
+void Graphics::CreateTileErrorBuffers()
+{
+	const uint64_t size = MaxTilesPerFrame * sizeof(uint32_t);
+	TileErrors = D3D::CreateBuffer(Device, size, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
+								   D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D::DefaultHeapProps);
+	TileErrorReadback = D3D::CreateBuffer(Device, kDefaultSwapChainBuffers * size, D3D12_RESOURCE_FLAG_NONE,
+										  D3D12_RESOURCE_STATE_COPY_DEST, D3D::ReadbackHeapProps);
+	TileErrorZeros = D3D::CreateBuffer(Device, size, D3D12_RESOURCE_FLAG_NONE,
+									   D3D12_RESOURCE_STATE_GENERIC_READ, D3D::UploadHeapProps);
+
+	uint8_t* data;
+	GRAPHICS_ASSERT(TileErrorZeros->Map(0, nullptr, reinterpret_cast<void**>(&data)));
+	std::memset(data, 0, size);
+	TileErrorZeros->Unmap(0, nullptr);
+
+	D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc{};
+	uavDesc.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
+	uavDesc.Format = DXGI_FORMAT_R32_UINT;
+	uavDesc.Buffer.FirstElement = 0;
+	uavDesc.Buffer.NumElements = MaxTilesPerFrame;
+	GlobalResources.RTConstantsData.TileErrorsIndex = CreateUAV(TileErrors, uavDesc);
+}
+
+void Graphics::CreateHistoryTextures()
+{
+	const std::array<DXGI_FORMAT, HistoryTexture::HistoryTextureCount> formats =
+	{
+		DXGI_FORMAT_R32G32B32A32_FLOAT,
+		DXGI_FORMAT_R32G32B32A32_FLOAT,
+		DXGI_FORMAT_R32_UINT
+	};
+
+	for (uint32_t i = 0; i < HistoryTextures.size(); i++)
+	{
+		DXGI_FORMAT format = formats[i / 2];
+		HistoryTextures[i] = D3D::CreateTexture2D(Device, SwapChainSize, format, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
+												  D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		uint32_t index = CreateTextureUAV(HistoryTextures[i], format);
+		if (i == 0)
+			GlobalResources.RTConstantsData.HistoryOffset = index;
+	}
+}
+
+void Graphics::CreateOutputStageResources()
+{
+	ResolvedTexture = D3D::CreateTexture2D(Device, SwapChainSize, DXGI_FORMAT_R16G16B16A16_FLOAT,
+										   D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
+										   D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+	ResolvedIndex = CreateTextureUAV(ResolvedTexture, DXGI_FORMAT_R16G16B16A16_FLOAT);
+
+	// Committed resources start zeroed, an exposure of 0 makes the first frame adapt instantly
+	LuminanceHistogram = D3D::CreateBuffer(Device, HistogramBins * sizeof(uint32_t),
+										   D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
+										   D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D::DefaultHeapProps);
+	ExposureBuffer = D3D::CreateBuffer(Device, sizeof(glm::vec4), D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
+									   D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D::DefaultHeapProps);
+
+	D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc{};
+	uavDesc.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
+	uavDesc.Format = DXGI_FORMAT_R32_UINT;
+	uavDesc.Buffer.FirstElement = 0;
+	uavDesc.Buffer.NumElements = HistogramBins;
+	HistogramIndex = CreateUAV(LuminanceHistogram, uavDesc);
+
+	uavDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+	uavDesc.Buffer.NumElements = 1;
+	ExposureIndex = CreateUAV(ExposureBuffer, uavDesc);
+}
+
+void Graphics::CreatePostProcessPrograms()
+{
+	auto rootSignature = GlobalResources.RootSignatureData->RootSignature;
+	TemporalProgram = ComputeProgram(Device, "TemporalAccumulate.hlsl", L"temporalAccumulate", rootSignature);
+	DenoiseProgram = ComputeProgram(Device, "Denoise.hlsl", L"denoise", rootSignature);
+	ResolveProgram = ComputeProgram(Device, "Resolve.hlsl", L"resolve", rootSignature);
+	HistogramProgram = ComputeProgram(Device, "Histogram.hlsl", L"luminanceHistogram", rootSignature);
+	ExposureProgram = ComputeProgram(Device, "Exposure.hlsl", L"adaptExposure", rootSignature);
+	TonemapProgram = ComputeProgram(Device, "Tonemap.hlsl", L"tonemap", rootSignature);
+}
+
+uint32_t Graphics::CreateUAV(ID3D12ResourcePtr resource, const D3D12_UNORDERED_ACCESS_VIEW_DESC& desc)
+{
+	assert(UAVHeapEntries < NumUAVDescriptors && "UAV heap is full");
+
+	auto uavHandle = GlobalResources.UAVHeap->GetCPUDescriptorHandleForHeapStart();
+	uavHandle.ptr += UAVHeapEntries * Device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+	Device->CreateUnorderedAccessView(resource, nullptr, &desc, uavHandle);
+	return UAVHeapEntries++;
+}
+
+uint32_t Graphics::CreateTextureUAV(ID3D12ResourcePtr resource, DXGI_FORMAT format)
+{
+	D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc{};
+	uavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
+	uavDesc.Format = format;
+	return CreateUAV(resource, uavDesc);
+}
+
+// Runs after DispatchRays with the global bindings still set. Temporal accumulation blends the
+// raw radiance into the history of the current frame parity, the denoiser then ping-pongs between
+// its two targets starting from whatever the previous stage produced
+void Graphics::PostProcess()
+{
+	D3D12_RESOURCE_BARRIER uavBarrier{};
+	uavBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+	uavBarrier.UAV.pResource = nullptr;
+	CmdList->ResourceBarrier(1, &uavBarrier);
+
+	const auto& rtConstants = GlobalResources.RTConstantsData;
+	PostProcessConstants constants{};
+	constants.SourceIndex = rtConstants.RadianceIndex;
+
+	// The progressive ladder accumulates by itself and shows its coarse levels as plain blocks
+	const bool coarse = ProgressiveEnabled && rtConstants.ProgressiveStride > 1;
+
+	if (TemporalEnabled && !ProgressiveEnabled)
+	{
+		constants.Flags = HistoryValid ? PostProcessFlags::PostProcessHistoryValid : 0;
+		TemporalProgram.Dispatch(CmdList, constants, RenderSize.x, RenderSize.y);
+		CmdList->ResourceBarrier(1, &uavBarrier);
+
+		constants.SourceIndex = rtConstants.HistoryOffset + 2 * HistoryTexture::HistoryColor + (rtConstants.FrameIndex & 1);
+		constants.Flags = 0;
+		HistoryValid = true;
+	}
+
+	if (DenoiserEnabled && !coarse)
+	{
+		for (uint32_t i = 0; i < DenoiseIterations; i++)
+		{
+			constants.DestinationIndex = DenoiseTargetIndices[i % 2];
+			constants.StepWidth = 1u << i;
+			constants.Iteration = i;
+			DenoiseProgram.Dispatch(CmdList, constants, RenderSize.x, RenderSize.y);
+			CmdList->ResourceBarrier(1, &uavBarrier);
+
+			constants.SourceIndex = constants.DestinationIndex;
+		}
+		constants.Flags |= PostProcessFlags::PostProcessRemodulate;
+	}
+
+	constants.View = View;
+	constants.DestinationIndex = ResolvedIndex;
+	ResolveProgram.Dispatch(CmdList, constants, SwapChainSize.x, SwapChainSize.y);
+	CmdList->ResourceBarrier(1, &uavBarrier);
+
+	constants.SourceIndex = ResolvedIndex;
+	constants.Flags = 0;
+	constants.ExposureBias = ExposureBias;
+	constants.DeltaTime = FrameDelta;
+	constants.HistogramIndex = HistogramIndex;
+	constants.ExposureIndex = ExposureIndex;
+	if (AutoExposure && View == AOVView::AOVViewNone)
+	{
+		HistogramProgram.Dispatch(CmdList, constants, SwapChainSize.x, SwapChainSize.y);
+		CmdList->ResourceBarrier(1, &uavBarrier);
+		// A single group of HistogramBins threads
+		ExposureProgram.Dispatch(CmdList, constants, 1, 1);
+		CmdList->ResourceBarrier(1, &uavBarrier);
+		constants.Flags = PostProcessFlags::PostProcessAutoExposure;
+	}
+
+	TonemapProgram.Dispatch(CmdList, constants, SwapChainSize.x, SwapChainSize.y);
+}
+
 void Graphics::CreateShaderTable()
 {
 	ShaderTableEntrySize = D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES;
 	ShaderTableEntrySize += 8;
 	ShaderTableEntrySize = align_to(ShaderTableEntrySize, D3D12_RAYTRACING_SHADER_RECORD_BYTE_ALIGNMENT);
 
-	uint32_t ShaderTableSize = 3 * ShaderTableEntrySize;
+	uint32_t ShaderTableSize = ShaderTableEntries * ShaderTableEntrySize;
 
 	ShaderTable = D3D::CreateBuffer(Device, ShaderTableSize, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_GENERIC_READ, D3D::UploadHeapProps);
 
@@ -365,23 +1713,39 @@ void Graphics::CreateShaderTable()
 	ID3D12StateObjectPropertiesPtr properties;
 	PipelineState->QueryInterface(IID_PPV_ARGS(&properties));
 
-	std::memcpy(data, properties->GetShaderIdentifier(L"rayGen"), D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES);
-
-	std::memcpy(data + ShaderTableEntrySize, properties->GetShaderIdentifier(L"miss"), D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES);
-	std::memcpy(data + 2 * ShaderTableEntrySize, properties->GetShaderIdentifier(L"HitGroup"), D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES);
+	// Ray generation, miss and hit group records in this order, see ShaderTableLayout
+	const std::array<const WCHAR*, ShaderTableEntries> exports =
+	{
+		L"rayGen", L"guideRayGen", L"miss", L"shadowMiss", L"guideMiss", L"HitGroup", L"GuideHitGroup"
+	};
+	for (uint32_t i = 0; i < exports.size(); i++)
+		std::memcpy(data + i * ShaderTableEntrySize, properties->GetShaderIdentifier(exports[i]), D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES);
 
 	ShaderTable->Unmap(0, nullptr);
 }
 
+void Graphics::CreateTimestampQueries()
+{
+	D3D12_QUERY_HEAP_DESC desc{};
+	desc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+	desc.Count = 2 * kDefaultSwapChainBuffers;
+	GRAPHICS_ASSERT(Device->CreateQueryHeap(&desc, IID_PPV_ARGS(&TimestampHeap)));
+
+	TimestampReadback = D3D::CreateBuffer(Device, desc.Count * sizeof(uint64_t), D3D12_RESOURCE_FLAG_NONE,
+										  D3D12_RESOURCE_STATE_COPY_DEST, D3D::ReadbackHeapProps);
+	GRAPHICS_ASSERT(CmdQueue->GetTimestampFrequency(&TimestampFrequency));
+}
+
+// Seeded with the frame that uses it, a resumed render draws the same numbers as the original
 void Graphics::UpdateTexture()
 {
-	auto data = GenerateTextureData(SwapChainSize);
+	auto data = GenerateTextureData(SwapChainSize, GlobalResources.RTConstantsData.FrameIndex + 1);
 	D3D::UploadTexture(Device, FrameObjects[SwapChain->GetCurrentBackBufferIndex()].CmdAllocator, Texture, data);
 }
 
-void Graphics::InitializeMaterials()
+void Graphics::InitializeMaterials(const std::vector<SceneMaterial>& materials)
 {
-	MatArray[MaterialType::Diffuse] = Material{ .Roughness = 0.0f, .Eta = 0.0f };
-	MatArray[MaterialType::Metal] = Material{ .Roughness = 0.2f, .Eta = 0.0f };
-	MatArray[MaterialType::Dielectric] = Material{ .Roughness = 0.0f, .Eta = 1.52f };
+	MatArray.clear();
+	for (const SceneMaterial& material : materials)
+		MatArray.push_back(material.Parameters);
 }
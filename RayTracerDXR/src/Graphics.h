@@ -2,20 +2,99 @@
 
 #include "Core.h"
 
+#include "AccumulationStore.h"
 #include "Camera.h"
+#include "Checkpoint.h"
+#include "FrameGovernor.h"
+#include "FrameSequence.h"
+#include "ImageWriter.h"
 #include "Window.h"
+#include "Lights.h"
+#include "SharedFrame.h"
+#include "PixelFilter.h"
+#include "Scene.h"
+#include "SceneSnapshot.h"
 #include "Shader.h"
 #include "Sphere.h"
+#include "TileScheduler.h"
 
 #include "Shaders/HLSLCompat.h"
 
+#include <future>
+
 struct Graphics
 {
-    Graphics(Window& window);
+    Graphics(Window& window, const Scene& scene);
     ~Graphics();
 
     void Tick(float delta);
 
+    void ToggleLightSampling();
+    void ToggleRestir();
+    void ToggleDenoiser();
+    void CycleAOVView();
+    void ToggleTemporalAccumulation();
+
+    void SetRaysPerPixel(uint32_t raysPerPixel);
+    inline uint32_t GetRaysPerPixel() const { return GlobalResources.RTConstantsData.RaysPerPixel; }
+
+    void ToggleFrameGovernor();
+    inline glm::uvec2 GetRenderSize() const { return RenderSize; }
+    // Full, half and quarter resolution tracing, the resolve pass upsamples to the swap chain
+    void CycleRenderScale();
+    // Preview ladder of 1/16 and 1/4 resolution blocks followed by full resolution accumulation,
+    // overrides the governor and the render scale while enabled
+    void ToggleProgressive();
+    // Order in which the tiles of full resolution progressive passes converge
+    void CycleTilePriority();
+    void SetFocus(const glm::vec2& focus);
+    void SetRegionOfInterest(const TileRect& region);
+    // Reuses the primary hits of a static view instead of traversing the scene for them
+    void TogglePrimaryHitCache();
+    // Histogram driven exposure of the output stage, the bias in stops applies on top of it
+    void ToggleAutoExposure();
+    void AdjustExposure(float stops);
+    // Writes the next frame to disk without waiting for it, the extension picks the format:
+    // .pfm and .exr store the linear frame before the output stage, .png the displayed one
+    void CaptureFrame(const std::string& path);
+    // Captures every frame into the sequence until it is stopped, single captures wait meanwhile
+    void StartFrameSequence(const std::string& target, FrameSequenceFormat format);
+    void StopFrameSequence();
+    inline bool IsRecordingSequence() const { return Sequence != nullptr; }
+    // Publishes the displayed frames in a named shared memory mapping for an external viewer
+    void ToggleFrameServer();
+    // Saves the progressive accumulation to path every CheckpointInterval seconds, on its own
+    // thread. Enabling first resumes from the file if it was saved with the current scene, view
+    // and settings, and turns progressive rendering on
+    void ToggleCheckpoints(const std::string& path);
+    // Renders an image of any size, up to far beyond memory, in blocks of store tiles that fit the
+    // swap chain. Every block is traced for framesPerBlock frames with the view narrowed to it and
+    // accumulated in a file backed store, which is written to outputPath as a tiled EXR at the end
+    bool StartLargeRender(const std::string& outputPath, const glm::uvec2& size, uint32_t framesPerBlock);
+    inline bool IsLargeRenderActive() const { return LargeRender != nullptr; }
+    // Per image encode times of the I/O thread, to confirm that it keeps up with the frames
+    inline ImageWriterStats GetCaptureStats() { return CaptureWriter.GetStats(); }
+    // Reconstruction filter the sub-pixel sample positions are drawn from
+    void SetPixelFilter(PixelFilterType type);
+    void CyclePixelFilter();
+
+    // Publishes an edit from any thread, the next frame applies it. Progressive passes only restart
+    // the tiles under the old and new screen footprint, everything follows EditRefreshFrames later.
+    // False if SceneSnapshots::Publish rejects the edit
+    bool EditSphere(uint32_t index, const Sphere& sphere);
+    // Latest published version, including edits that were not applied yet
+    Sphere GetSphere(uint32_t index) const;
+    // Tools that edit many spheres at once publish their edits here, each frame applies the
+    // snapshot it pins at its start
+    inline SceneSnapshots& GetSceneSnapshots() { return *Snapshots; }
+    // 0 never refreshes the indirect light outside the footprints
+    void SetEditRefreshFrames(uint32_t frames);
+
+    // AOV textures are created on first use and kept, disabling only stops the writes
+    void EnableAOVs(uint32_t mask);
+    void DisableAOVs(uint32_t mask);
+    LightSelectionBenchmark BenchmarkLightSampling() const;
+
 private:
     void Init();
     void Shutdown();
@@ -27,14 +106,55 @@ private:
 
     void CreateAccelerationStructures();
     void CreateShaderResources();
+    void CreateReservoirBuffers();
+    void CreatePostProcessResources();
+    void CreateHistoryTextures();
+    void CreateUpscaleGuides();
+    void CreateTileErrorBuffers();
+    void CreateOutputStageResources();
+    void CreatePostProcessPrograms();
+    uint32_t CreateUAV(ID3D12ResourcePtr resource, const D3D12_UNORDERED_ACCESS_VIEW_DESC& desc);
+    uint32_t CreateTextureUAV(ID3D12ResourcePtr resource, DXGI_FORMAT format);
     void CreateShaderTable();
+    void CreateTimestampQueries();
 
     void UpdateTexture();
+    void PostProcess();
+
+    D3D12_DISPATCH_RAYS_DESC GetDispatchRaysDesc(uint32_t rayGenEntry, const glm::uvec3& size) const;
+    float ReadFrameTime(uint32_t frameIndex);
+    void ReadTileErrors(uint32_t frameIndex);
+    void CopyTileErrors(uint32_t frameIndex);
+    void CopyCapture(uint32_t frameIndex);
+    void ReadCapture(uint32_t frameIndex);
+    void CopySharedFrame(uint32_t frameIndex);
+    void PublishSharedFrame(uint32_t frameIndex, float gpuMilliseconds);
+    void CopyCheckpoint(uint32_t frameIndex);
+    void WriteCheckpoint(uint32_t frameIndex);
+    bool ResumeFromCheckpoint();
+    uint64_t GetCheckpointHash() const;
+    void ApplyWorkload(const FrameWorkload& workload);
+    void SetRenderSize(const glm::uvec2& renderSize);
+    bool UpdateLargeRender();
+    void CopyLargeRender(uint32_t frameIndex);
+    void ReadLargeRender(uint32_t frameIndex);
+    void InvalidateHistory();
+    glm::uvec3 UpdateProgressive(uint32_t frameIndex);
+    void UpdateTilePriority();
+    TileRect GetScreenFootprint(const Sphere& sphere) const;
+    void ApplySnapshot(const SceneSnapshot& snapshot);
+    void QueueEdit(uint32_t index, const Sphere& sphere);
+    void ApplySceneEdits(uint32_t frameIndex);
+    void InvalidatePrimaryHitCache();
+    void UpdatePrimaryHitCache();
 
-    void InitializeMaterials();
+    void InitializeMaterials(const std::vector<SceneMaterial>& materials);
 private:
     HWND WinHandle{ nullptr };
+    // Mapped scene file the spheres may point into, declared first so that it goes last
+    std::shared_ptr<SceneArchive> SceneData;
     SphereComposite Spheres;
+    LightSampler Lights;
 
     IDXGIFactory4Ptr Factory;
     ID3D12DebugPtr Debug;
@@ -43,6 +163,8 @@ private:
     ID3D12Device5Ptr Device;
     IDXGISwapChain3Ptr SwapChain;
     glm::uvec2 SwapChainSize;
+    // Traced sub-rectangle of the per-pixel resources, upscaled to SwapChainSize by the resolve pass
+    glm::uvec2 RenderSize;
 
     FrameData FrameObjects[kDefaultSwapChainBuffers];
 
@@ -59,15 +181,196 @@ private:
     ID3D12ResourcePtr ShaderTable;
     uint32_t ShaderTableEntrySize = 0;
 
+    enum ShaderTableLayout : uint32_t
+    {
+        RayGenEntry = 0,
+        GuideRayGenEntry,
+        MissEntries,
+        NumMissEntries = 3,
+        HitGroupEntries = MissEntries + NumMissEntries,
+        NumHitGroupEntries = 2
+    };
+    static const uint32_t ShaderTableEntries = HitGroupEntries + NumHitGroupEntries;
+
     ID3D12ResourcePtr OutputTexture;
     GlobalBindings GlobalResources;
     static const uint32_t HeapSize = 2;
+    uint32_t UAVHeapEntries = 0;
 
     ID3D12ResourcePtr SpheresBuffer;
+    ID3D12ResourcePtr BottomLevelAS;
+    DXR::AccelerationStructureBuffers TopLevelBuffers;
 
     ID3D12ResourcePtr Texture;
-    std::array<Material, MaterialType::Count> MatArray = {};
+    std::vector<Material> MatArray;
     ID3D12ResourcePtr Materials;
+    ID3D12ResourcePtr LightsBuffer;
+    ID3D12ResourcePtr LightNodesBuffer;
+    // Scene edits reach the sphere, instance and light buffers through it
+    D3D::UploadRing Uploads;
+
+    static const uint32_t NumReservoirBuffers = 8;
+    std::array<ID3D12ResourcePtr, NumReservoirBuffers> ReservoirBuffers;
+
+    // Linear radiance of the frame, the AOVs indexed by flag bit and the denoiser ping-pong targets
+    ID3D12ResourcePtr RadianceTexture;
+    std::array<ID3D12ResourcePtr, AOVFlags::AOVCount> AOVTextures;
+    std::array<ID3D12ResourcePtr, 2> DenoiseTargets;
+    std::array<uint32_t, 2> DenoiseTargetIndices = {};
+
+    // Double buffered temporal history, laid out as HistoryTexture kind * 2 + frame parity
+    std::array<ID3D12ResourcePtr, 2 * HistoryTexture::HistoryTextureCount> HistoryTextures;
+    bool TemporalEnabled = true;
+    bool HistoryValid = false;
+    static const uint32_t TemporalAOVs = AOVFlags::AOVNormal | AOVFlags::AOVDepth | AOVFlags::AOVInstanceID;
+
+    // Albedo, normal and depth, instance ID of the full resolution guide pass
+    std::array<ID3D12ResourcePtr, 3> UpscaleGuides;
+    static const uint32_t UpscaleAOVs = AOVFlags::AOVAlbedo | AOVFlags::AOVNormal | AOVFlags::AOVDepth |
+        AOVFlags::AOVInstanceID;
+    uint32_t RenderScaleIndex = 0;
+
+    PixelFilter Filter;
+
+    // Block sizes of the progressive ladder, the last level accumulates until the camera moves
+    static constexpr std::array<uint32_t, 3> ProgressiveStrides = { 4, 2, 1 };
+    bool ProgressiveEnabled = false;
+    uint32_t ProgressiveLevel = 0;
+    uint64_t ProgressiveEpoch = 0;
+
+    enum TilePriorityMode : uint32_t
+    {
+        TilePriorityUniform = 0,
+        TilePriorityFocus,
+        TilePriorityRegion,
+        TilePriorityError,
+        TilePriorityModeCount
+    };
+    static const uint32_t ProgressiveTileSize = 64;
+    TileScheduler Tiles;
+    uint32_t TilePriority = TilePriorityUniform;
+    glm::vec2 Focus = glm::vec2(0.0f);
+    TileRect RegionOfInterest;
+
+    // Tiles traced by the frame of each swap chain buffer, until their errors are read back
+    std::array<std::vector<uint32_t>, kDefaultSwapChainBuffers> PendingTiles;
+    std::array<uint64_t, kDefaultSwapChainBuffers> PendingTileEpochs = {};
+    ID3D12ResourcePtr TileErrors;
+    ID3D12ResourcePtr TileErrorReadback;
+    ID3D12ResourcePtr TileErrorZeros;
+
+    std::unique_ptr<SceneSnapshots> Snapshots;
+    // Chunks of the snapshot the spheres were last brought up to, unchanged chunks are skipped
+    std::vector<std::shared_ptr<const SphereChunk>> AppliedChunks;
+    std::map<uint32_t, Sphere> PendingEdits;
+    static const uint32_t EditMargin = 16;
+    uint32_t EditRefreshFrames = 120;
+    uint32_t StaleFrames = 0;
+
+    // Sub-pixel samples per pixel with a cached primary hit, later samples always traverse
+    static const uint32_t PrimaryHitCacheSamples = 4;
+    // Frames a cached sub-pixel position is reused before the samples are jittered again
+    static const uint32_t PrimaryHitCacheFrames = 8;
+    ID3D12ResourcePtr PrimaryHitCache;
+    uint64_t PrimaryHitCacheEpoch = 0;
+    uint32_t PrimaryHitCacheAge = 0;
+
+    ComputeProgram TemporalProgram;
+    ComputeProgram DenoiseProgram;
+    ComputeProgram ResolveProgram;
+    ComputeProgram HistogramProgram;
+    ComputeProgram ExposureProgram;
+    ComputeProgram TonemapProgram;
+    bool DenoiserEnabled = true;
+    static const uint32_t DenoiseIterations = 4;
+    static const uint32_t DenoiserAOVs = AOVFlags::AOVAlbedo | AOVFlags::AOVNormal | AOVFlags::AOVDepth;
+    uint32_t View = AOVView::AOVViewNone;
+
+    // Linear frame at swap chain resolution written by the resolve pass, the output stage
+    // exposes, tonemaps and dithers it into OutputTexture
+    ID3D12ResourcePtr ResolvedTexture;
+    uint32_t ResolvedIndex = 0;
+    ID3D12ResourcePtr LuminanceHistogram;
+    ID3D12ResourcePtr ExposureBuffer;
+    uint32_t HistogramIndex = 0;
+    uint32_t ExposureIndex = 0;
+    bool AutoExposure = true;
+    float ExposureBias = 0.0f;
+    static constexpr float MaxExposureBias = 8.0f;
+    float FrameDelta = 0.0f;
+
+    // Requested captures start with the next frame, each swap chain buffer carries at most one
+    // until it is read back and handed to the I/O thread in blocks of rows
+    struct PendingCapture
+    {
+        std::shared_ptr<ImageWriter> Writer;
+        D3D12_PLACED_SUBRESOURCE_FOOTPRINT Footprint{};
+    };
+    static constexpr uint32_t CaptureRowsPerBlock = 64;
+    std::vector<std::string> CaptureRequests;
+    std::array<PendingCapture, kDefaultSwapChainBuffers> PendingCaptures;
+    std::array<ID3D12ResourcePtr, kDefaultSwapChainBuffers> CaptureReadbacks;
+    std::unique_ptr<FrameSequence> Sequence;
+    ImageWriterQueue CaptureWriter;
+
+    // Slot and stats of the frame each swap chain buffer copies into the frame server
+    struct PendingSharedFrame
+    {
+        uint32_t Slot = ~0u;
+        SharedFrameStats Stats;
+    };
+    std::unique_ptr<SharedFrameServer> FrameServer;
+    std::array<PendingSharedFrame, kDefaultSwapChainBuffers> PendingSharedFrames;
+    // Frames since the last restart of the accumulation
+    uint32_t AccumulatedFrames = 0;
+
+    // One checkpoint at a time: a frame copies the radiance into the readback buffer, and once
+    // it completed a thread of its own writes the file straight from the mapped buffer
+    std::string CheckpointPath;
+    static constexpr float CheckpointInterval = 60.0f;
+    float CheckpointAge = 0.0f;
+    uint32_t CheckpointFrame = ~0u;
+    Checkpoint PendingCheckpoint;
+    D3D12_PLACED_SUBRESOURCE_FOOTPRINT CheckpointFootprint{};
+    ID3D12ResourcePtr CheckpointReadback;
+    std::future<bool> CheckpointWrite;
+
+    // Blocks are visited in Hilbert order, which keeps the tiles of the blocks before and after
+    // the current one resident. Each swap chain buffer reads back the block it traced
+    struct LargeRenderState
+    {
+        std::string OutputPath;
+        AccumulationStore Store;
+        // View at the start, the camera may move meanwhile. Its projection has the aspect ratio of
+        // the image, every block narrows it to the part of clip space the block covers
+        glm::mat4x4 ViewProjection;
+        glm::vec3 CameraPosition;
+        std::vector<glm::uvec2> Blocks;
+        glm::uvec2 BlockSize = glm::uvec2(0);
+        glm::uvec2 Origin = glm::uvec2(0);
+        uint32_t NextBlock = 0;
+        uint32_t FramesPerBlock = 0;
+        uint32_t FramesLeft = 0;
+    };
+    struct PendingLargeFrame
+    {
+        glm::uvec2 Origin = glm::uvec2(0);
+        glm::uvec2 Size = glm::uvec2(0);
+        D3D12_PLACED_SUBRESOURCE_FOOTPRINT Footprint{};
+    };
+    std::unique_ptr<LargeRenderState> LargeRender;
+    std::array<PendingLargeFrame, kDefaultSwapChainBuffers> PendingLargeFrames;
+    std::array<ID3D12ResourcePtr, kDefaultSwapChainBuffers> LargeRenderReadbacks;
+    std::future<bool> LargeRenderWrite;
+
+    // GPU time of ray tracing and post-processing, one pair of timestamps per swap chain buffer
+    ID3D12QueryHeapPtr TimestampHeap;
+    ID3D12ResourcePtr TimestampReadback;
+    uint64_t TimestampFrequency = 0;
+    std::array<bool, kDefaultSwapChainBuffers> TimestampsPending = {};
+
+    FrameGovernor Governor;
+    bool GovernorEnabled = false;
 
     Camera SceneCamera;
 };
\ No newline at end of file
@@ -0,0 +1,629 @@
+#include "ImageWriter.h"
+
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <sstream>
+
+namespace
+{
+	// PFM and EXR are little endian, like every platform this runs on
+	template<typename T>
+	void WriteLittleEndian(std::vector<uint8_t>& out, T value)
+	{
+		const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+		out.insert(out.end(), bytes, bytes + sizeof(T));
+	}
+
+	void WriteBigEndian(std::vector<uint8_t>& out, uint32_t value)
+	{
+		for (int shift = 24; shift >= 0; shift -= 8)
+			out.push_back(static_cast<uint8_t>(value >> shift));
+	}
+
+	std::string GetExtension(const std::string& path)
+	{
+		std::string extension = std::filesystem::path(path).extension().string();
+		std::transform(extension.begin(), extension.end(), extension.begin(),
+					   [](char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); });
+		return extension;
+	}
+
+	void WriteString(std::vector<uint8_t>& out, const char* text)
+	{
+		out.insert(out.end(), text, text + std::strlen(text) + 1);
+	}
+
+	// Four half float channels without compression, tiled with tileSize x tileSize tiles of a
+	// single level if tileSize is not 0
+	void WriteExrHeader(std::vector<uint8_t>& header, const glm::uvec2& size, uint32_t tileSize)
+	{
+		WriteLittleEndian<uint32_t>(header, 20000630);
+		// Version 2, bit 9 marks a tiled file
+		WriteLittleEndian<uint32_t>(header, tileSize != 0 ? 0x202 : 2);
+
+		auto attribute = [&header](const char* name, const char* type, uint32_t size)
+		{
+			WriteString(header, name);
+			WriteString(header, type);
+			WriteLittleEndian<uint32_t>(header, size);
+		};
+
+		// Channels are stored in alphabetical order
+		const char* channels[] = { "A", "B", "G", "R" };
+		attribute("channels", "chlist", 4 * (2 + 16) + 1);
+		for (const char* channel : channels)
+		{
+			WriteString(header, channel);
+			WriteLittleEndian<int32_t>(header, 1); // HALF
+			WriteLittleEndian<uint32_t>(header, 0); // pLinear and reserved
+			WriteLittleEndian<int32_t>(header, 1);
+			WriteLittleEndian<int32_t>(header, 1);
+		}
+		header.push_back(0);
+
+		attribute("compression", "compression", 1);
+		header.push_back(0); // NO_COMPRESSION
+
+		for (const char* window : { "dataWindow", "displayWindow" })
+		{
+			attribute(window, "box2i", 16);
+			WriteLittleEndian<int32_t>(header, 0);
+			WriteLittleEndian<int32_t>(header, 0);
+			WriteLittleEndian<int32_t>(header, size.x - 1);
+			WriteLittleEndian<int32_t>(header, size.y - 1);
+		}
+
+		attribute("lineOrder", "lineOrder", 1);
+		header.push_back(0); // INCREASING_Y
+		attribute("pixelAspectRatio", "float", 4);
+		WriteLittleEndian<float>(header, 1.0f);
+		attribute("screenWindowCenter", "v2f", 8);
+		WriteLittleEndian<float>(header, 0.0f);
+		WriteLittleEndian<float>(header, 0.0f);
+		attribute("screenWindowWidth", "float", 4);
+		WriteLittleEndian<float>(header, 1.0f);
+		if (tileSize != 0)
+		{
+			attribute("tiles", "tiledesc", 9);
+			WriteLittleEndian<uint32_t>(header, tileSize);
+			WriteLittleEndian<uint32_t>(header, tileSize);
+			header.push_back(0); // ONE_LEVEL, ROUND_DOWN
+		}
+		header.push_back(0);
+	}
+
+	// Float RGB, bottom row first
+	struct PfmWriter : ImageWriter
+	{
+		PfmWriter(const std::string& path, uint32_t width, uint32_t height)
+			:ImageWriter(path, width, height, ImagePixelRGBA16F)
+		{
+			std::ostringstream header;
+			header << "PF\n" << Width << " " << Height << "\n-1.0\n";
+			const std::string text = header.str();
+			File.write(text.data(), text.size());
+			HeaderSize = text.size();
+		}
+
+		void WriteRows(const ImageRows& rows) override
+		{
+			std::vector<float> line(3 * Width);
+			const glm::u16vec4* pixels = reinterpret_cast<const glm::u16vec4*>(rows.Data.data());
+			for (uint32_t r = 0; r < rows.Count; r++)
+			{
+				for (uint32_t x = 0; x < Width; x++)
+				{
+					const glm::u16vec4& p = pixels[r * Width + x];
+					line[3 * x + 0] = glm::unpackHalf1x16(p.x);
+					line[3 * x + 1] = glm::unpackHalf1x16(p.y);
+					line[3 * x + 2] = glm::unpackHalf1x16(p.z);
+				}
+
+				const uint64_t row = Height - 1 - (rows.FirstRow + r);
+				File.seekp(HeaderSize + row * line.size() * sizeof(float));
+				File.write(reinterpret_cast<const char*>(line.data()), line.size() * sizeof(float));
+			}
+		}
+
+		bool Close() override
+		{
+			File.close();
+			return !File.fail();
+		}
+
+		uint64_t HeaderSize = 0;
+	};
+
+	// Single part scanline OpenEXR with half RGBA and no compression. Every line is its own chunk
+	// of fixed size, so the offset table is known up front and lines can land in any order
+	struct ExrWriter : ImageWriter
+	{
+		ExrWriter(const std::string& path, uint32_t width, uint32_t height)
+			:ImageWriter(path, width, height, ImagePixelRGBA16F)
+		{
+			std::vector<uint8_t> header;
+			WriteExrHeader(header, glm::uvec2(Width, Height), 0);
+
+			ChunksOffset = header.size() + Height * sizeof(uint64_t);
+			for (uint32_t y = 0; y < Height; y++)
+				WriteLittleEndian<uint64_t>(header, GetChunkOffset(y));
+			File.write(reinterpret_cast<const char*>(header.data()), header.size());
+		}
+
+		void WriteRows(const ImageRows& rows) override
+		{
+			std::vector<uint8_t> chunk;
+			chunk.reserve(GetChunkSize());
+			const glm::u16vec4* pixels = reinterpret_cast<const glm::u16vec4*>(rows.Data.data());
+			for (uint32_t r = 0; r < rows.Count; r++)
+			{
+				const uint32_t y = rows.FirstRow + r;
+				const glm::u16vec4* line = pixels + r * Width;
+
+				chunk.clear();
+				WriteLittleEndian<int32_t>(chunk, y);
+				WriteLittleEndian<uint32_t>(chunk, 4 * Width * sizeof(uint16_t));
+				// A, B, G, R planes
+				for (int channel : { 3, 2, 1, 0 })
+				{
+					for (uint32_t x = 0; x < Width; x++)
+						WriteLittleEndian<uint16_t>(chunk, line[x][channel]);
+				}
+
+				File.seekp(GetChunkOffset(y));
+				File.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+			}
+		}
+
+		bool Close() override
+		{
+			File.close();
+			return !File.fail();
+		}
+
+		inline uint64_t GetChunkSize() const { return 2 * sizeof(uint32_t) + 4 * Width * sizeof(uint16_t); }
+		inline uint64_t GetChunkOffset(uint32_t y) const { return ChunksOffset + y * GetChunkSize(); }
+
+		uint64_t ChunksOffset = 0;
+	};
+
+	// RGBA8 PNG whose zlib stream only uses stored deflate blocks, there is no compressor in the
+	// tree. Rows are emitted top to bottom as one IDAT chunk per contiguous run
+	struct PngWriter : ImageWriter
+	{
+		PngWriter(const std::string& path, uint32_t width, uint32_t height)
+			:ImageWriter(path, width, height, ImagePixelRGBA8)
+		{
+			const uint8_t signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+			File.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+
+			std::vector<uint8_t> header;
+			WriteBigEndian(header, Width);
+			WriteBigEndian(header, Height);
+			// 8 bits per channel, RGBA, deflate, adaptive filtering, no interlace
+			header.insert(header.end(), { 8, 6, 0, 0, 0 });
+			WriteChunk("IHDR", header);
+		}
+
+		void WriteRows(const ImageRows& rows) override
+		{
+			Pending.emplace(rows.FirstRow, rows);
+
+			std::vector<uint8_t> stream;
+			if (NextRow == 0 && Pending.begin()->first == 0)
+				stream.insert(stream.end(), { 0x78, 0x01 });
+
+			std::vector<uint8_t> line(1 + GetRowSize());
+			while (!Pending.empty() && Pending.begin()->first == NextRow)
+			{
+				const ImageRows& block = Pending.begin()->second;
+				for (uint32_t r = 0; r < block.Count; r++, NextRow++)
+				{
+					// Filter type None
+					line[0] = 0;
+					std::memcpy(line.data() + 1, block.Data.data() + r * GetRowSize(), GetRowSize());
+					UpdateAdler(line);
+					AppendStored(stream, line, NextRow + 1 == Height);
+				}
+				Pending.erase(Pending.begin());
+			}
+
+			if (stream.empty())
+				return;
+			if (NextRow == Height)
+				WriteBigEndian(stream, (AdlerB << 16) | AdlerA);
+			WriteChunk("IDAT", stream);
+		}
+
+		bool Close() override
+		{
+			WriteChunk("IEND", {});
+			File.close();
+			return !File.fail() && NextRow == Height;
+		}
+
+		void UpdateAdler(const std::vector<uint8_t>& data)
+		{
+			// Largest run before the sums can overflow 32 bits
+			constexpr size_t maxRun = 5552;
+			for (size_t start = 0; start < data.size(); start += maxRun)
+			{
+				const size_t end = std::min(data.size(), start + maxRun);
+				for (size_t i = start; i < end; i++)
+				{
+					AdlerA += data[i];
+					AdlerB += AdlerA;
+				}
+				AdlerA %= 65521;
+				AdlerB %= 65521;
+			}
+		}
+
+		static void AppendStored(std::vector<uint8_t>& stream, const std::vector<uint8_t>& data, bool last)
+		{
+			constexpr size_t maxBlock = 65535;
+			for (size_t start = 0; start < data.size(); start += maxBlock)
+			{
+				const uint16_t size = static_cast<uint16_t>(std::min(maxBlock, data.size() - start));
+				const bool final = last && start + size == data.size();
+				stream.push_back(final ? 1 : 0);
+				WriteLittleEndian<uint16_t>(stream, size);
+				WriteLittleEndian<uint16_t>(stream, static_cast<uint16_t>(~size));
+				stream.insert(stream.end(), data.begin() + start, data.begin() + start + size);
+			}
+		}
+
+		static uint32_t Crc32(const char* type, const std::vector<uint8_t>& data)
+		{
+			static const std::array<uint32_t, 256> table = []
+			{
+				std::array<uint32_t, 256> values{};
+				for (uint32_t n = 0; n < 256; n++)
+				{
+					uint32_t c = n;
+					for (int k = 0; k < 8; k++)
+						c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+					values[n] = c;
+				}
+				return values;
+			}();
+
+			uint32_t crc = 0xFFFFFFFFu;
+			auto update = [&crc](uint8_t byte) { crc = table[(crc ^ byte) & 0xFF] ^ (crc >> 8); };
+			for (int i = 0; i < 4; i++)
+				update(static_cast<uint8_t>(type[i]));
+			for (uint8_t byte : data)
+				update(byte);
+			return crc ^ 0xFFFFFFFFu;
+		}
+
+		void WriteChunk(const char* type, const std::vector<uint8_t>& data)
+		{
+			std::vector<uint8_t> framing;
+			WriteBigEndian(framing, static_cast<uint32_t>(data.size()));
+			framing.insert(framing.end(), type, type + 4);
+			File.write(reinterpret_cast<const char*>(framing.data()), framing.size());
+			File.write(reinterpret_cast<const char*>(data.data()), data.size());
+
+			framing.clear();
+			WriteBigEndian(framing, Crc32(type, data));
+			File.write(reinterpret_cast<const char*>(framing.data()), framing.size());
+		}
+
+		std::map<uint32_t, ImageRows> Pending;
+		uint32_t NextRow = 0;
+		uint32_t AdlerA = 1;
+		uint32_t AdlerB = 0;
+	};
+
+	// QOI, the "Quite OK Image" format: one pass over the pixels with a run, a 64 entry hash of
+	// recent colors and small deltas to the previous pixel. Much cheaper than deflate at
+	// comparable sizes for rendered frames. The encoder state runs across rows, which are therefore
+	// encoded top to bottom like the PNG ones
+	struct QoiWriter : ImageWriter
+	{
+		QoiWriter(const std::string& path, uint32_t width, uint32_t height)
+			:ImageWriter(path, width, height, ImagePixelRGBA8)
+		{
+			std::vector<uint8_t> header = { 'q', 'o', 'i', 'f' };
+			WriteBigEndian(header, Width);
+			WriteBigEndian(header, Height);
+			// RGBA, sRGB with linear alpha
+			header.insert(header.end(), { 4, 0 });
+			File.write(reinterpret_cast<const char*>(header.data()), header.size());
+		}
+
+		void WriteRows(const ImageRows& rows) override
+		{
+			Pending.emplace(rows.FirstRow, rows);
+
+			std::vector<uint8_t> out;
+			while (!Pending.empty() && Pending.begin()->first == NextRow)
+			{
+				const ImageRows& block = Pending.begin()->second;
+				out.reserve(out.size() + block.Data.size() + block.Data.size() / 4);
+				Encode(out, block.Data.data(), static_cast<size_t>(block.Count) * Width, NextRow + block.Count == Height);
+				NextRow += block.Count;
+				Pending.erase(Pending.begin());
+			}
+			File.write(reinterpret_cast<const char*>(out.data()), out.size());
+		}
+
+		bool Close() override
+		{
+			File.close();
+			return !File.fail() && NextRow == Height;
+		}
+
+		void Encode(std::vector<uint8_t>& out, const uint8_t* pixels, size_t count, bool last)
+		{
+			enum : uint8_t { OpIndex = 0x00, OpDiff = 0x40, OpLuma = 0x80, OpRun = 0xC0, OpRGB = 0xFE, OpRGBA = 0xFF };
+
+			auto flushRun = [&]()
+			{
+				if (Run == 0)
+					return;
+				out.push_back(static_cast<uint8_t>(OpRun | (Run - 1)));
+				Run = 0;
+			};
+
+			for (size_t i = 0; i < count; i++)
+			{
+				const glm::u8vec4 pixel(pixels[4 * i], pixels[4 * i + 1], pixels[4 * i + 2], pixels[4 * i + 3]);
+				if (pixel == Previous)
+				{
+					if (++Run == 62)
+						flushRun();
+					continue;
+				}
+				flushRun();
+
+				const uint32_t hash = (pixel.r * 3 + pixel.g * 5 + pixel.b * 7 + pixel.a * 11) % 64;
+				if (Index[hash] == pixel)
+				{
+					out.push_back(static_cast<uint8_t>(OpIndex | hash));
+				}
+				else if (pixel.a != Previous.a)
+				{
+					out.insert(out.end(), { OpRGBA, pixel.r, pixel.g, pixel.b, pixel.a });
+				}
+				else
+				{
+					const int8_t dr = static_cast<int8_t>(pixel.r - Previous.r);
+					const int8_t dg = static_cast<int8_t>(pixel.g - Previous.g);
+					const int8_t db = static_cast<int8_t>(pixel.b - Previous.b);
+					const int8_t drg = static_cast<int8_t>(dr - dg);
+					const int8_t dbg = static_cast<int8_t>(db - dg);
+
+					if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1)
+						out.push_back(static_cast<uint8_t>(OpDiff | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2)));
+					else if (dg >= -32 && dg <= 31 && drg >= -8 && drg <= 7 && dbg >= -8 && dbg <= 7)
+						out.insert(out.end(), { static_cast<uint8_t>(OpLuma | (dg + 32)),
+												static_cast<uint8_t>((drg + 8) << 4 | (dbg + 8)) });
+					else
+						out.insert(out.end(), { OpRGB, pixel.r, pixel.g, pixel.b });
+				}
+
+				Index[hash] = pixel;
+				Previous = pixel;
+			}
+
+			if (last)
+			{
+				flushRun();
+				out.insert(out.end(), { 0, 0, 0, 0, 0, 0, 0, 1 });
+			}
+		}
+
+		std::map<uint32_t, ImageRows> Pending;
+		uint32_t NextRow = 0;
+		std::array<glm::u8vec4, 64> Index{};
+		glm::u8vec4 Previous = glm::u8vec4(0, 0, 0, 255);
+		uint32_t Run = 0;
+	};
+}
+
+ImageWriter::ImageWriter(const std::string& path, uint32_t width, uint32_t height, ImagePixelFormat format,
+						 bool openFile)
+	:Path(path), Width(width), Height(height), Format(format)
+{
+	if (openFile)
+		File.open(path, std::ios::binary | std::ios::trunc);
+}
+
+// Chunks are laid out in the order of the offset table, which is written up front
+TiledExrWriter::TiledExrWriter(const std::string& path, const glm::uvec2& size, uint32_t tileSize)
+	:File(path, std::ios::binary), Size(size), TileSize(std::max(tileSize, 1u))
+{
+	std::vector<uint8_t> header;
+	WriteExrHeader(header, Size, TileSize);
+
+	const glm::uvec2 count = GetTileCount();
+	uint64_t offset = header.size() + uint64_t(count.x) * count.y * sizeof(uint64_t);
+	ChunkOffsets.reserve(count.x * count.y);
+	for (uint32_t y = 0; y < count.y; y++)
+	{
+		for (uint32_t x = 0; x < count.x; x++)
+		{
+			const glm::uvec2 extent = GetTileExtent(glm::uvec2(x, y));
+			ChunkOffsets.push_back(offset);
+			WriteLittleEndian<uint64_t>(header, offset);
+			offset += 5 * sizeof(int32_t) + uint64_t(extent.x) * extent.y * 4 * sizeof(uint16_t);
+		}
+	}
+	File.write(reinterpret_cast<const char*>(header.data()), header.size());
+}
+
+glm::uvec2 TiledExrWriter::GetTileExtent(const glm::uvec2& tile) const
+{
+	return glm::min(Size - tile * TileSize, glm::uvec2(TileSize));
+}
+
+void TiledExrWriter::WriteTile(const glm::uvec2& tile, const glm::u16vec4* pixels, uint32_t rowStride)
+{
+	const glm::uvec2 extent = GetTileExtent(tile);
+	std::vector<uint8_t> chunk;
+	chunk.reserve(5 * sizeof(int32_t) + extent.x * extent.y * 4 * sizeof(uint16_t));
+	WriteLittleEndian<int32_t>(chunk, tile.x);
+	WriteLittleEndian<int32_t>(chunk, tile.y);
+	WriteLittleEndian<int32_t>(chunk, 0);
+	WriteLittleEndian<int32_t>(chunk, 0);
+	WriteLittleEndian<uint32_t>(chunk, extent.x * extent.y * 4 * sizeof(uint16_t));
+	// Every line of the tile holds the A, B, G, R planes of that line
+	for (uint32_t y = 0; y < extent.y; y++)
+	{
+		const glm::u16vec4* line = pixels + y * rowStride;
+		for (int channel : { 3, 2, 1, 0 })
+		{
+			for (uint32_t x = 0; x < extent.x; x++)
+				WriteLittleEndian<uint16_t>(chunk, line[x][channel]);
+		}
+	}
+
+	File.seekp(ChunkOffsets[tile.y * GetTileCount().x + tile.x]);
+	File.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+}
+
+bool TiledExrWriter::Close()
+{
+	File.close();
+	return !File.fail();
+}
+
+std::string ImageWriterStats::ToString() const
+{
+	std::ostringstream oss;
+	oss << "Images written: " << Images << ", failed: " << Failures << std::endl
+		<< "  Encode time: last " << LastMilliseconds << " ms, average "
+		<< (Images != 0 ? TotalMilliseconds / Images : 0.0) << " ms, max " << MaxMilliseconds << " ms" << std::endl;
+	return oss.str();
+}
+
+bool ImageWriter::GetPixelFormat(const std::string& path, ImagePixelFormat& format)
+{
+	const std::string extension = GetExtension(path);
+	if (extension == ".png" || extension == ".qoi")
+		format = ImagePixelRGBA8;
+	else if (extension == ".pfm" || extension == ".exr")
+		format = ImagePixelRGBA16F;
+	else
+		return false;
+	return true;
+}
+
+std::unique_ptr<ImageWriter> ImageWriter::Create(const std::string& path, uint32_t width, uint32_t height)
+{
+	ImagePixelFormat format;
+	if (!GetPixelFormat(path, format) || width == 0 || height == 0)
+		return nullptr;
+
+	std::unique_ptr<ImageWriter> writer;
+	const std::string extension = GetExtension(path);
+	if (extension == ".png")
+		writer = std::make_unique<PngWriter>(path, width, height);
+	else if (extension == ".qoi")
+		writer = std::make_unique<QoiWriter>(path, width, height);
+	else if (extension == ".pfm")
+		writer = std::make_unique<PfmWriter>(path, width, height);
+	else
+		writer = std::make_unique<ExrWriter>(path, width, height);
+
+	if (!writer->File.is_open())
+		return nullptr;
+	return writer;
+}
+
+ImageWriterQueue::ImageWriterQueue(size_t capacity)
+	:Capacity(std::max<size_t>(capacity, 1))
+{
+	Worker = std::thread(&ImageWriterQueue::Run, this);
+}
+
+ImageWriterQueue::~ImageWriterQueue()
+{
+	{
+		std::lock_guard lock(Mutex);
+		Stopping = true;
+	}
+	NotEmpty.notify_all();
+	Worker.join();
+}
+
+void ImageWriterQueue::Submit(std::shared_ptr<ImageWriter> writer, ImageRows rows)
+{
+	Push(Job{ .Writer = std::move(writer), .Rows = std::move(rows), .Close = false });
+}
+
+void ImageWriterQueue::Close(std::shared_ptr<ImageWriter> writer)
+{
+	Push(Job{ .Writer = std::move(writer), .Rows = {}, .Close = true });
+}
+
+ImageWriterStats ImageWriterQueue::GetStats()
+{
+	std::lock_guard lock(Mutex);
+	return Stats;
+}
+
+void ImageWriterQueue::ResetStats()
+{
+	std::lock_guard lock(Mutex);
+	Stats = ImageWriterStats{};
+}
+
+void ImageWriterQueue::Push(Job job)
+{
+	{
+		std::unique_lock lock(Mutex);
+		NotFull.wait(lock, [this] { return Jobs.size() < Capacity; });
+		Jobs.push_back(std::move(job));
+	}
+	NotEmpty.notify_one();
+}
+
+// Drains the queue before stopping, so files submitted before shutdown are complete
+void ImageWriterQueue::Run()
+{
+	while (true)
+	{
+		Job job;
+		{
+			std::unique_lock lock(Mutex);
+			NotEmpty.wait(lock, [this] { return Stopping || !Jobs.empty(); });
+			if (Jobs.empty())
+				return;
+			job = std::move(Jobs.front());
+			Jobs.pop_front();
+		}
+		NotFull.notify_one();
+
+		const auto start = std::chrono::steady_clock::now();
+		bool success = true;
+		if (job.Close)
+			success = job.Writer->Close();
+		else
+			job.Writer->WriteRows(job.Rows);
+		job.Writer->EncodeMilliseconds +=
+			std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		if (!job.Close)
+			continue;
+
+		const double milliseconds = job.Writer->EncodeMilliseconds;
+		{
+			std::lock_guard lock(Mutex);
+			Stats.Images++;
+			Stats.Failures += success ? 0 : 1;
+			Stats.LastMilliseconds = milliseconds;
+			Stats.TotalMilliseconds += milliseconds;
+			Stats.MaxMilliseconds = std::max(Stats.MaxMilliseconds, milliseconds);
+		}
+
+		std::ostringstream oss;
+		oss << (success ? "Wrote " : "Failed to write ") << job.Writer->GetPath() << " in " << milliseconds << " ms"
+			<< std::endl;
+		OutputDebugStringA(oss.str().c_str());
+	}
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include "Core.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// Layout of the rows handed to a writer: the displayed 8-bit sRGB frame or the linear half
+// float one, both RGBA and tightly packed
+enum ImagePixelFormat : uint32_t
+{
+	ImagePixelRGBA8 = 0,
+	ImagePixelRGBA16F
+};
+
+struct ImageRows
+{
+	uint32_t FirstRow = 0;
+	uint32_t Count = 0;
+	std::vector<uint8_t> Data;
+};
+
+// Streams an image to disk in blocks of rows. The formats are laid out so that a block can be
+// written as soon as it is known: PFM and uncompressed scanline EXR seek to the fixed offset of
+// the rows, PNG emits stored deflate blocks and only holds rows back until the ones above arrived
+struct ImageWriter
+{
+	virtual ~ImageWriter() = default;
+
+	// Every row exactly once, in any order
+	virtual void WriteRows(const ImageRows& rows) = 0;
+	// Finishes the file, false if any write failed
+	virtual bool Close() = 0;
+
+	// Picks the format from the extension of the path (.pfm, .exr, .png or .qoi), nullptr if the
+	// extension is unknown or the file cannot be created
+	static std::unique_ptr<ImageWriter> Create(const std::string& path, uint32_t width, uint32_t height);
+	static bool GetPixelFormat(const std::string& path, ImagePixelFormat& format);
+
+	inline ImagePixelFormat GetPixelFormat() const { return Format; }
+	inline const std::string& GetPath() const { return Path; }
+	inline uint32_t GetRowSize() const { return Width * (Format == ImagePixelRGBA8 ? 4 : 8); }
+	// Time the I/O thread spent on this image so far
+	inline double GetEncodeMilliseconds() const { return EncodeMilliseconds; }
+
+protected:
+	// Writers that share a stream with other images skip opening a file of their own
+	ImageWriter(const std::string& path, uint32_t width, uint32_t height, ImagePixelFormat format,
+				bool openFile = true);
+
+protected:
+	std::string Path;
+	std::ofstream File;
+	uint32_t Width = 0;
+	uint32_t Height = 0;
+	ImagePixelFormat Format = ImagePixelRGBA8;
+
+private:
+	friend struct ImageWriterQueue;
+	double EncodeMilliseconds = 0.0;
+};
+
+// Half float RGBA EXR in tiles of a single level. Every tile is written once as soon as it is
+// known, in any order, so the image never has to be in memory as a whole
+struct TiledExrWriter
+{
+	TiledExrWriter(const std::string& path, const glm::uvec2& size, uint32_t tileSize);
+
+	// Pixels of the tile at the given tile coordinates, rows rowStride pixels apart. Tiles at the
+	// right and bottom edge are cut to the image
+	void WriteTile(const glm::uvec2& tile, const glm::u16vec4* pixels, uint32_t rowStride);
+	bool Close();
+
+	inline bool IsOpen() const { return File.is_open() && !File.fail(); }
+	inline glm::uvec2 GetTileCount() const { return (Size + TileSize - 1u) / TileSize; }
+	glm::uvec2 GetTileExtent(const glm::uvec2& tile) const;
+
+private:
+	std::ofstream File;
+	glm::uvec2 Size;
+	uint32_t TileSize;
+	std::vector<uint64_t> ChunkOffsets;
+};
+
+struct ImageWriterStats
+{
+	uint64_t Images = 0;
+	uint64_t Failures = 0;
+	double LastMilliseconds = 0.0;
+	double TotalMilliseconds = 0.0;
+	double MaxMilliseconds = 0.0;
+
+	std::string ToString() const;
+};
+
+// Encodes on a dedicated I/O thread. The render thread only copies rows into the bounded queue
+// and waits only while the queue is full
+struct ImageWriterQueue
+{
+	explicit ImageWriterQueue(size_t capacity = 64);
+	~ImageWriterQueue();
+	ImageWriterQueue(const ImageWriterQueue&) = delete;
+	ImageWriterQueue& operator=(const ImageWriterQueue&) = delete;
+
+	void Submit(std::shared_ptr<ImageWriter> writer, ImageRows rows);
+	// Closes the writer once all rows submitted before have been written
+	void Close(std::shared_ptr<ImageWriter> writer);
+
+	// Encode times of the finished images, each one is also logged as it completes
+	ImageWriterStats GetStats();
+	void ResetStats();
+
+private:
+	struct Job
+	{
+		std::shared_ptr<ImageWriter> Writer;
+		ImageRows Rows;
+		bool Close = false;
+	};
+
+	void Push(Job job);
+	void Run();
+
+private:
+	std::deque<Job> Jobs;
+	size_t Capacity;
+	bool Stopping = false;
+	ImageWriterStats Stats;
+	std::mutex Mutex;
+	std::condition_variable NotEmpty;
+	std::condition_variable NotFull;
+	std::thread Worker;
+};
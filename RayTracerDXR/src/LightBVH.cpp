@@ -0,0 +1,329 @@
+#include "LightBVH.h"
+#include "Lights.h"
+#include "Sphere.h"
+
+#include <algorithm>
+#include <cassert>
+#include <execution>
+#include <future>
+#include <numbers>
+#include <numeric>
+#include <thread>
+
+static constexpr uint32_t ParallelBuildThreshold = 4096;
+static constexpr uint32_t NumBuckets = 12;
+
+static uint32_t MaxParallelDepth()
+{
+	static const uint32_t depth = static_cast<uint32_t>(std::log2(std::max(1u, std::thread::hardware_concurrency()))) + 2;
+	return depth;
+}
+
+static bool IsEmpty(const LightBounds& b)
+{
+	return b.Min.x > b.Max.x;
+}
+
+LightBounds LightBounds::Union(const LightBounds& a, const LightBounds& b)
+{
+	if (IsEmpty(a))
+		return b;
+	if (IsEmpty(b))
+		return a;
+
+	LightBounds result;
+	result.Min = glm::min(a.Min, b.Min);
+	result.Max = glm::max(a.Max, b.Max);
+	result.Power = a.Power + b.Power;
+	result.CosThetaE = std::min(a.CosThetaE, b.CosThetaE);
+
+	// Smallest cone containing both emission cones
+	constexpr float pi = std::numbers::pi_v<float>;
+	float thetaA = std::acos(std::clamp(a.CosThetaO, -1.0f, 1.0f));
+	float thetaB = std::acos(std::clamp(b.CosThetaO, -1.0f, 1.0f));
+	float thetaD = std::acos(std::clamp(glm::dot(a.Axis, b.Axis), -1.0f, 1.0f));
+
+	if (std::min(thetaD + thetaB, pi) <= thetaA)
+	{
+		result.Axis = a.Axis;
+		result.CosThetaO = a.CosThetaO;
+		return result;
+	}
+	if (std::min(thetaD + thetaA, pi) <= thetaB)
+	{
+		result.Axis = b.Axis;
+		result.CosThetaO = b.CosThetaO;
+		return result;
+	}
+
+	float thetaO = 0.5f * (thetaA + thetaD + thetaB);
+	glm::vec3 rotationAxis = glm::cross(a.Axis, b.Axis);
+	if (thetaO >= pi || glm::dot(rotationAxis, rotationAxis) == 0.0f)
+	{
+		result.Axis = a.Axis;
+		result.CosThetaO = -1.0f;
+		return result;
+	}
+
+	result.Axis = glm::vec3(glm::rotate(thetaO - thetaA, rotationAxis) * glm::vec4(a.Axis, 0.0f));
+	result.CosThetaO = std::cos(thetaO);
+	return result;
+}
+
+float LightBounds::SurfaceArea() const
+{
+	glm::vec3 d = Max - Min;
+	return 2.0f * (d.x * d.y + d.x * d.z + d.y * d.z);
+}
+
+// Surface area orientation heuristic of Conty Estevez and Kulla
+static float EvaluateCost(const LightBounds& b, const LightBounds& nodeBounds, int dim)
+{
+	constexpr float pi = std::numbers::pi_v<float>;
+	float thetaO = std::acos(std::clamp(b.CosThetaO, -1.0f, 1.0f));
+	float thetaE = std::acos(std::clamp(b.CosThetaE, -1.0f, 1.0f));
+	float thetaW = std::min(thetaO + thetaE, pi);
+	float sinThetaO = std::sqrt(std::max(0.0f, 1.0f - b.CosThetaO * b.CosThetaO));
+	float orientationMeasure = 2.0f * pi * (1.0f - b.CosThetaO) +
+		pi / 2.0f * (2.0f * thetaW * sinThetaO - std::cos(thetaO - 2.0f * thetaW) -
+					 2.0f * thetaO * sinThetaO + b.CosThetaO);
+
+	// Discourage long thin nodes
+	glm::vec3 extent = nodeBounds.Max - nodeBounds.Min;
+	float maxExtent = std::max({ extent.x, extent.y, extent.z });
+	float regularization = extent[dim] > 0.0f ? maxExtent / extent[dim] : 1.0f;
+
+	return regularization * b.Power * orientationMeasure * b.SurfaceArea();
+}
+
+LightBounds LightBVH::GetLightBounds(const SphereComposite& spheres, const LightInfo& light)
+{
+	const Sphere& sphere = spheres[light.SphereIndex];
+
+	// Spheres emit in every direction: theta_o = pi, theta_e = pi / 2
+	LightBounds bounds;
+	bounds.Min = sphere.Center - sphere.Radius;
+	bounds.Max = sphere.Center + sphere.Radius;
+	bounds.Power = LightSampler::GetPower(sphere);
+	bounds.Axis = glm::vec3(0.0f, 0.0f, 1.0f);
+	bounds.CosThetaO = -1.0f;
+	bounds.CosThetaE = 0.0f;
+	return bounds;
+}
+
+void LightBVH::Build(const SphereComposite& spheres, const std::vector<LightInfo>& lights, uint32_t lightCount)
+{
+	Nodes.clear();
+	if (lightCount == 0)
+	{
+		Nodes.push_back(LightBVHNode{});
+		Nodes.back().IsLeaf = 1;
+		LinkNodes(0);
+		return;
+	}
+
+	// One light per leaf, so the tree has exactly 2N - 1 nodes and every subtree knows where
+	// its nodes go before it is built
+	Nodes.resize(2 * static_cast<size_t>(lightCount) - 1);
+
+	std::vector<LightBounds> bounds(lightCount);
+	std::transform(std::execution::par_unseq, lights.begin(), lights.begin() + lightCount, bounds.begin(),
+				   [&spheres](const LightInfo& light) { return GetLightBounds(spheres, light); });
+
+	std::vector<uint32_t> indices(lightCount);
+	std::iota(indices.begin(), indices.end(), 0u);
+
+	BuildRecursive(0, indices.data(), indices.data() + lightCount, bounds, 0);
+	LinkNodes(lightCount);
+}
+
+bool LightBVH::Load(std::span<const LightBVHNode> nodes, uint32_t lightCount)
+{
+	if (lightCount == 0 || nodes.size() != 2 * static_cast<size_t>(lightCount) - 1)
+		return false;
+
+	const LightBVHNode* first = nodes.data();
+	const bool valid = std::all_of(std::execution::par_unseq, nodes.begin(), nodes.end(), [&](const LightBVHNode& node)
+	{
+		const size_t index = &node - first;
+		return node.IsLeaf ? node.Offset < lightCount : node.Offset > index + 1 && node.Offset < nodes.size();
+	});
+	if (!valid)
+		return false;
+
+	// Every light is in exactly one leaf, so none is sampled twice as often or never
+	std::vector<uint8_t> inLeaf(lightCount, 0);
+	for (const LightBVHNode& node : nodes)
+	{
+		if (node.IsLeaf && inLeaf[node.Offset]++ != 0)
+			return false;
+	}
+	if (std::find(inLeaf.begin(), inLeaf.end(), 0) != inLeaf.end())
+		return false;
+
+	Nodes.assign(nodes.begin(), nodes.end());
+	LinkNodes(lightCount);
+	return true;
+}
+
+void LightBVH::Refit(const SphereComposite& spheres, const std::vector<LightInfo>& lights,
+					 std::span<const uint32_t> changedLights)
+{
+	std::vector<uint32_t> ancestors;
+	for (uint32_t light : changedLights)
+	{
+		const uint32_t leaf = Leaves[light];
+		WriteNode(leaf, GetLightBounds(spheres, lights[light]), light, true);
+		for (uint32_t node = Parents[leaf]; node != ~0u; node = Parents[node])
+			ancestors.push_back(node);
+	}
+
+	// Children come after their parent, going backwards updates a node after both of its children
+	std::sort(ancestors.begin(), ancestors.end(), std::greater<uint32_t>());
+	ancestors.erase(std::unique(ancestors.begin(), ancestors.end()), ancestors.end());
+	for (uint32_t node : ancestors)
+	{
+		const uint32_t right = Nodes[node].Offset;
+		WriteNode(node, LightBounds::Union(GetNodeBounds(Nodes[node + 1]), GetNodeBounds(Nodes[right])), right, false);
+	}
+}
+
+LightBounds LightBVH::GetNodeBounds(const LightBVHNode& node)
+{
+	LightBounds bounds;
+	bounds.Min = node.BoundsMin;
+	bounds.Max = node.BoundsMax;
+	bounds.Power = node.Power;
+	bounds.Axis = node.Axis;
+	bounds.CosThetaO = node.CosThetaO;
+	bounds.CosThetaE = node.CosThetaE;
+	return bounds;
+}
+
+void LightBVH::LinkNodes(uint32_t lightCount)
+{
+	Parents.assign(Nodes.size(), ~0u);
+	Leaves.assign(lightCount, 0);
+	for (uint32_t i = 0; i < Nodes.size(); i++)
+	{
+		if (!Nodes[i].IsLeaf)
+		{
+			Parents[i + 1] = i;
+			Parents[Nodes[i].Offset] = i;
+		}
+		else if (lightCount > 0)
+			Leaves[Nodes[i].Offset] = i;
+	}
+}
+
+void LightBVH::BuildRecursive(uint32_t nodeIndex, uint32_t* begin, uint32_t* end,
+							  const std::vector<LightBounds>& bounds, uint32_t depth)
+{
+	const uint32_t count = static_cast<uint32_t>(end - begin);
+	if (count == 1)
+	{
+		WriteNode(nodeIndex, bounds[*begin], *begin, true);
+		return;
+	}
+
+	LightBounds nodeBounds;
+	glm::vec3 centroidMin(std::numeric_limits<float>::max());
+	glm::vec3 centroidMax(std::numeric_limits<float>::lowest());
+	for (uint32_t* it = begin; it != end; it++)
+	{
+		const LightBounds& b = bounds[*it];
+		nodeBounds = LightBounds::Union(nodeBounds, b);
+		glm::vec3 centroid = 0.5f * (b.Min + b.Max);
+		centroidMin = glm::min(centroidMin, centroid);
+		centroidMax = glm::max(centroidMax, centroid);
+	}
+
+	auto bucketOf = [&](uint32_t light, int dim)
+	{
+		float centroid = 0.5f * (bounds[light].Min[dim] + bounds[light].Max[dim]);
+		float t = (centroid - centroidMin[dim]) / (centroidMax[dim] - centroidMin[dim]);
+		return std::min(static_cast<uint32_t>(t * NumBuckets), NumBuckets - 1);
+	};
+
+	float bestCost = std::numeric_limits<float>::max();
+	int bestDim = -1;
+	uint32_t bestBucket = 0;
+	for (int dim = 0; dim < 3; dim++)
+	{
+		if (centroidMax[dim] == centroidMin[dim])
+			continue;
+
+		std::array<LightBounds, NumBuckets> buckets{};
+		for (uint32_t* it = begin; it != end; it++)
+		{
+			auto& bucket = buckets[bucketOf(*it, dim)];
+			bucket = LightBounds::Union(bucket, bounds[*it]);
+		}
+
+		for (uint32_t split = 0; split < NumBuckets - 1; split++)
+		{
+			LightBounds below, above;
+			for (uint32_t i = 0; i <= split; i++)
+				below = LightBounds::Union(below, buckets[i]);
+			for (uint32_t i = split + 1; i < NumBuckets; i++)
+				above = LightBounds::Union(above, buckets[i]);
+
+			if (IsEmpty(below) || IsEmpty(above))
+				continue;
+
+			float cost = EvaluateCost(below, nodeBounds, dim) + EvaluateCost(above, nodeBounds, dim);
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestDim = dim;
+				bestBucket = split;
+			}
+		}
+	}
+
+	uint32_t* mid = end;
+	if (bestDim >= 0)
+		mid = std::partition(begin, end, [&](uint32_t light) { return bucketOf(light, bestDim) <= bestBucket; });
+
+	if (mid == begin || mid == end)
+	{
+		// Coincident centroids or a degenerate split, fall back to halving along the widest axis
+		glm::vec3 extent = centroidMax - centroidMin;
+		int dim = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+		mid = begin + count / 2;
+		std::nth_element(begin, mid, end, [&](uint32_t a, uint32_t b)
+						 {
+							 return bounds[a].Min[dim] + bounds[a].Max[dim] < bounds[b].Min[dim] + bounds[b].Max[dim];
+						 });
+	}
+
+	const uint32_t leftCount = static_cast<uint32_t>(mid - begin);
+	const uint32_t left = nodeIndex + 1;
+	const uint32_t right = nodeIndex + 2 * leftCount;
+	WriteNode(nodeIndex, nodeBounds, right, false);
+
+	if (count > ParallelBuildThreshold && depth < MaxParallelDepth())
+	{
+		auto task = std::async(std::launch::async, [&]() { BuildRecursive(left, begin, mid, bounds, depth + 1); });
+		BuildRecursive(right, mid, end, bounds, depth + 1);
+		task.get();
+	}
+	else
+	{
+		BuildRecursive(left, begin, mid, bounds, depth + 1);
+		BuildRecursive(right, mid, end, bounds, depth + 1);
+	}
+}
+
+void LightBVH::WriteNode(uint32_t nodeIndex, const LightBounds& bounds, uint32_t offset, bool isLeaf)
+{
+	LightBVHNode& node = Nodes[nodeIndex];
+	node.BoundsMin = bounds.Min;
+	node.Power = bounds.Power;
+	node.BoundsMax = bounds.Max;
+	node.CosThetaO = bounds.CosThetaO;
+	node.Axis = bounds.Axis;
+	node.CosThetaE = bounds.CosThetaE;
+	node.Offset = offset;
+	node.IsLeaf = isLeaf ? 1 : 0;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "Core.h"
+#include "Shaders/HLSLCompat.h"
+
+#include <limits>
+#include <span>
+
+struct SphereComposite;
+
+struct LightBounds
+{
+	glm::vec3 Min = glm::vec3(std::numeric_limits<float>::max());
+	glm::vec3 Max = glm::vec3(std::numeric_limits<float>::lowest());
+	float Power = 0.0f;
+	glm::vec3 Axis = glm::vec3(0.0f, 0.0f, 1.0f);
+	float CosThetaO = 1.0f;
+	float CosThetaE = 1.0f;
+
+	static LightBounds Union(const LightBounds& a, const LightBounds& b);
+	float SurfaceArea() const;
+};
+
+// Bounding volume hierarchy over emissive spheres with power and orientation cones per node,
+// traversed stochastically in the shaders to find lights that matter for a shading point.
+// Subtrees are built in parallel, writing to disjoint ranges of the node array
+struct LightBVH
+{
+	using ValueType = LightBVHNode;
+
+	LightBVH() = default;
+
+	void Build(const SphereComposite& spheres, const std::vector<LightInfo>& lights, uint32_t lightCount);
+	// Keeps the topology and recomputes the leaves of the given lights and their ancestors, each
+	// node once, for lights that moved or changed emission. The set of lights must be the same as
+	// in the last Build
+	void Refit(const SphereComposite& spheres, const std::vector<LightInfo>& lights, std::span<const uint32_t> changedLights);
+	// Takes nodes built earlier for lightCount lights. False if they do not form such a tree,
+	// children have to come after their parent so that the traversal always terminates and
+	// every light has to be in exactly one leaf
+	bool Load(std::span<const LightBVHNode> nodes, uint32_t lightCount);
+
+	inline uint32_t Size() const { return static_cast<uint32_t>(Nodes.size()); }
+	inline const std::vector<ValueType>& Data() const { return Nodes; }
+
+private:
+	static LightBounds GetLightBounds(const SphereComposite& spheres, const LightInfo& light);
+	static LightBounds GetNodeBounds(const LightBVHNode& node);
+	void LinkNodes(uint32_t lightCount);
+
+	void BuildRecursive(uint32_t nodeIndex, uint32_t* begin, uint32_t* end,
+						const std::vector<LightBounds>& bounds, uint32_t depth);
+
+	void WriteNode(uint32_t nodeIndex, const LightBounds& bounds, uint32_t offset, bool isLeaf);
+
+private:
+	std::vector<ValueType> Nodes;
+	// Parent of every node and leaf of every light, for refits that start at the leaves
+	std::vector<uint32_t> Parents;
+	std::vector<uint32_t> Leaves;
+};
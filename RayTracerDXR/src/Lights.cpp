@@ -0,0 +1,275 @@
+#include "Lights.h"
+#include "Sphere.h"
+
+#include <algorithm>
+#include <chrono>
+#include <execution>
+#include <limits>
+#include <numeric>
+#include <numbers>
+#include <random>
+#include <sstream>
+
+static float Luminance(const glm::vec3& c)
+{
+	return glm::dot(c, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+}
+
+std::string LightSelectionBenchmark::ToString() const
+{
+	std::ostringstream oss;
+	oss << "Light selection, equal time" << std::endl
+		<< "  Uniform: " << UniformSamples << " samples, relative RMSE " << UniformRMSE << std::endl
+		<< "  Power:   " << PowerSamples << " samples, relative RMSE " << PowerRMSE << std::endl;
+	return oss.str();
+}
+
+void LightSampler::Build(const SphereComposite& spheres)
+{
+	Lights.clear();
+	for (uint32_t i = 0; i < spheres.Size(); i++)
+	{
+		if (spheres[i].Type == MaterialType::Emissive)
+			Lights.push_back(LightInfo{ .SphereIndex = i, .Pdf = 0.0f, .Probability = 1.0f, .Alias = 0 });
+	}
+
+	LightCount = static_cast<uint32_t>(Lights.size());
+	if (LightCount == 0)
+	{
+		Lights.push_back(LightInfo{ .SphereIndex = 0, .Pdf = 0.0f, .Probability = 1.0f, .Alias = 0 });
+		Powers.clear();
+		Hierarchy.Build(spheres, Lights, 0);
+		return;
+	}
+
+	std::vector<float> weights(LightCount);
+	std::transform(std::execution::par_unseq, Lights.begin(), Lights.end(), weights.begin(),
+				   [&spheres](const LightInfo& light) { return GetPower(spheres[light.SphereIndex]); });
+
+	Powers = weights;
+	BuildAliasTable(weights);
+	Hierarchy.Build(spheres, Lights, LightCount);
+}
+
+// Lights are in the order of their spheres, the lights of a range are found by binary search
+void LightSampler::Refit(const SphereComposite& spheres, const SphereChanges& changes)
+{
+	if (LightCount == 0)
+		return;
+
+	const auto first = Lights.begin();
+	const auto last = Lights.begin() + LightCount;
+	std::vector<uint32_t> changed;
+	for (const SphereRange& range : changes.Ranges)
+	{
+		auto light = std::lower_bound(first, last, range.Begin,
+									  [](const LightInfo& info, uint32_t sphere) { return info.SphereIndex < sphere; });
+		for (; light != last && light->SphereIndex < range.End; light++)
+			changed.push_back(static_cast<uint32_t>(light - first));
+	}
+	if (changed.empty())
+		return;
+
+	bool powerChanged = false;
+	for (uint32_t light : changed)
+	{
+		const float power = GetPower(spheres[Lights[light].SphereIndex]);
+		powerChanged |= power != Powers[light];
+		Powers[light] = power;
+	}
+	if (powerChanged)
+	{
+		std::vector<float> weights = Powers;
+		BuildAliasTable(weights);
+	}
+	Hierarchy.Refit(spheres, Lights, changed);
+}
+
+bool LightSampler::Load(const SphereComposite& spheres, std::span<const LightInfo> lights,
+						std::span<const LightBVHNode> nodes)
+{
+	const uint32_t lightCount = static_cast<uint32_t>(lights.size());
+	const bool valid = std::all_of(std::execution::par_unseq, lights.begin(), lights.end(), [&](const LightInfo& light)
+	{
+		return light.SphereIndex < spheres.Size() && light.Alias < lightCount;
+	});
+	const bool ordered = std::is_sorted(lights.begin(), lights.end(),
+										[](const LightInfo& a, const LightInfo& b) { return a.SphereIndex < b.SphereIndex; });
+	if (!valid || !ordered || !Hierarchy.Load(nodes, lightCount))
+		return false;
+
+	Lights.assign(lights.begin(), lights.end());
+	LightCount = lightCount;
+	Powers.resize(LightCount);
+	std::transform(std::execution::par_unseq, Lights.begin(), Lights.end(), Powers.begin(),
+				   [&spheres](const LightInfo& light) { return GetPower(spheres[light.SphereIndex]); });
+	return true;
+}
+
+float LightSampler::GetPower(const Sphere& sphere)
+{
+	// Lambertian emitter: Phi = pi * L * area
+	constexpr float pi = std::numbers::pi_v<float>;
+	return pi * Luminance(sphere.Albedo) * 4.0f * pi * sphere.Radius * sphere.Radius;
+}
+
+// Vose's variant of the alias method. Scaling and classification run in parallel, only the
+// pairing of under- and overfull bins is sequential, which is O(N) with a tiny constant
+void LightSampler::BuildAliasTable(std::vector<float>& weights)
+{
+	const size_t count = weights.size();
+	const double total = std::reduce(std::execution::par_unseq, weights.begin(), weights.end(), 0.0);
+
+	if (!(total > 0.0))
+	{
+		std::for_each(std::execution::par_unseq, Lights.begin(), Lights.end(),
+					  [count](LightInfo& light) { light.Pdf = 1.0f / count; light.Probability = 1.0f; });
+		return;
+	}
+
+	std::vector<uint32_t> indices(count);
+	std::iota(indices.begin(), indices.end(), 0u);
+
+	std::for_each(std::execution::par_unseq, indices.begin(), indices.end(),
+				  [&](uint32_t i)
+				  {
+					  Lights[i].Pdf = static_cast<float>(weights[i] / total);
+					  Lights[i].Alias = i;
+					  weights[i] = static_cast<float>(weights[i] * count / total);
+				  });
+
+	auto firstLarge = std::partition(std::execution::par, indices.begin(), indices.end(),
+									 [&weights](uint32_t i) { return weights[i] < 1.0f; });
+
+	std::vector<uint32_t> underfull(indices.begin(), firstLarge);
+	std::vector<uint32_t> overfull(firstLarge, indices.end());
+
+	while (!underfull.empty() && !overfull.empty())
+	{
+		uint32_t s = underfull.back();
+		underfull.pop_back();
+		uint32_t l = overfull.back();
+
+		Lights[s].Probability = weights[s];
+		Lights[s].Alias = l;
+
+		weights[l] = (weights[l] + weights[s]) - 1.0f;
+		if (weights[l] < 1.0f)
+		{
+			overfull.pop_back();
+			underfull.push_back(l);
+		}
+	}
+
+	// Whatever is left is full up to rounding error
+	for (uint32_t i : overfull)
+		Lights[i].Probability = 1.0f;
+	for (uint32_t i : underfull)
+		Lights[i].Probability = 1.0f;
+}
+
+LightSelectionBenchmark LightSampler::Benchmark(const SphereComposite& spheres, float secondsPerMode) const
+{
+	LightSelectionBenchmark result{};
+	if (LightCount == 0)
+		return result;
+
+	struct LightData
+	{
+		glm::vec3 Center;
+		float RadiusSq;
+		float Luminance;
+	};
+
+	std::vector<LightData> lights(LightCount);
+	glm::vec3 lower(std::numeric_limits<float>::max()), upper(std::numeric_limits<float>::lowest());
+	for (uint32_t i = 0; i < LightCount; i++)
+	{
+		const Sphere& sphere = spheres[Lights[i].SphereIndex];
+		lights[i] = { sphere.Center, sphere.Radius * sphere.Radius, Luminance(sphere.Albedo) };
+		lower = glm::min(lower, sphere.Center - sphere.Radius);
+		upper = glm::max(upper, sphere.Center + sphere.Radius);
+	}
+
+	auto irradiance = [&lights](uint32_t i, const glm::vec3& p)
+	{
+		glm::vec3 d = lights[i].Center - p;
+		return std::numbers::pi_v<float> * lights[i].Luminance * lights[i].RadiusSq / glm::dot(d, d);
+	};
+
+	constexpr uint32_t numPoints = 64;
+	std::mt19937 gen(1234);
+	std::uniform_real_distribution<float> distr(0.0f, 1.0f);
+
+	std::vector<glm::vec3> points;
+	std::vector<double> reference;
+	for (uint32_t attempt = 0; points.size() < numPoints && attempt < 64 * numPoints; attempt++)
+	{
+		glm::vec3 p = lower + (upper - lower) * glm::vec3(distr(gen), distr(gen), distr(gen));
+		bool inside = std::any_of(lights.begin(), lights.end(), [&p](const LightData& light)
+								  {
+									  glm::vec3 d = light.Center - p;
+									  return glm::dot(d, d) <= light.RadiusSq;
+								  });
+		if (inside)
+			continue;
+
+		double sum = 0.0;
+		for (uint32_t i = 0; i < LightCount; i++)
+			sum += irradiance(i, p);
+		if (sum <= 0.0)
+			continue;
+
+		points.push_back(p);
+		reference.push_back(sum);
+	}
+
+	if (points.empty())
+		return result;
+
+	using Clock = std::chrono::steady_clock;
+	const auto budget = std::chrono::duration_cast<Clock::duration>(
+		std::chrono::duration<float>(secondsPerMode / points.size()));
+
+	auto run = [&](auto&& selectAndEstimate, uint64_t& samples)
+	{
+		double squaredError = 0.0;
+		for (size_t k = 0; k < points.size(); k++)
+		{
+			double sum = 0.0;
+			uint64_t n = 0;
+			const auto start = Clock::now();
+			do
+			{
+				// Check the clock rarely, it is more expensive than a sample
+				for (uint32_t j = 0; j < 256; j++)
+					sum += selectAndEstimate(points[k]);
+				n += 256;
+			} while (Clock::now() - start < budget);
+
+			double relError = (sum / n - reference[k]) / reference[k];
+			squaredError += relError * relError;
+			samples += n;
+		}
+		return std::sqrt(squaredError / points.size());
+	};
+
+	const float count = static_cast<float>(LightCount);
+
+	result.UniformRMSE = run([&](const glm::vec3& p)
+							 {
+								 uint32_t i = std::min(static_cast<uint32_t>(distr(gen) * count), LightCount - 1);
+								 return irradiance(i, p) * count;
+							 }, result.UniformSamples);
+
+	result.PowerRMSE = run([&](const glm::vec3& p)
+						   {
+							   float u = distr(gen) * count;
+							   uint32_t i = std::min(static_cast<uint32_t>(u), LightCount - 1);
+							   if (u - i >= Lights[i].Probability)
+								   i = Lights[i].Alias;
+							   return Lights[i].Pdf > 0.0f ? irradiance(i, p) / Lights[i].Pdf : 0.0f;
+						   }, result.PowerSamples);
+
+	return result;
+}
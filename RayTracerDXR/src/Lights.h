@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Core.h"
+#include "LightBVH.h"
+#include "Shaders/HLSLCompat.h"
+
+struct Sphere;
+struct SphereComposite;
+struct SphereChanges;
+
+struct LightSelectionBenchmark
+{
+	uint64_t UniformSamples = 0;
+	uint64_t PowerSamples = 0;
+	double UniformRMSE = 0.0;
+	double PowerRMSE = 0.0;
+
+	std::string ToString() const;
+};
+
+// Collects the emissive spheres of a scene and builds a Walker alias table over their emitted
+// power, so that the shaders can pick a light proportionally to its power in O(1), as well as
+// a light BVH for spatially aware selection
+struct LightSampler
+{
+	using ValueType = LightInfo;
+
+	LightSampler() = default;
+
+	void Build(const SphereComposite& spheres);
+	// Refits the lights among the changed spheres that moved or changed emission, the alias table
+	// is rebuilt if their power changed. The set of emissive spheres must be unchanged since the
+	// last Build
+	void Refit(const SphereComposite& spheres, const SphereChanges& changes);
+	// Takes a table and hierarchy built earlier for the same spheres, e.g. by the scene converter.
+	// False if they refer to spheres, lights or nodes that do not exist
+	bool Load(const SphereComposite& spheres, std::span<const LightInfo> lights, std::span<const LightBVHNode> nodes);
+
+	// Equal-time comparison of uniform and power proportional selection on the unoccluded
+	// irradiance from all lights, measured at a fixed set of points inside the scene bounds
+	LightSelectionBenchmark Benchmark(const SphereComposite& spheres, float secondsPerMode) const;
+
+	static float GetPower(const Sphere& sphere);
+
+	// Count of actual lights, Data() always holds at least one entry so the SRV stays valid
+	inline uint32_t Size() const { return LightCount; }
+	inline uint32_t BufferSize() const { return static_cast<uint32_t>(Lights.size()); }
+	inline const std::vector<ValueType>& Data() const { return Lights; }
+	inline const LightBVH& GetHierarchy() const { return Hierarchy; }
+
+private:
+	void BuildAliasTable(std::vector<float>& weights);
+
+private:
+	std::vector<ValueType> Lights;
+	// Emitted power of every light, the weights of the alias table
+	std::vector<float> Powers;
+	uint32_t LightCount = 0;
+	LightBVH Hierarchy;
+};
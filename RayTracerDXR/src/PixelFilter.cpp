@@ -0,0 +1,98 @@
+#include "PixelFilter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+#include <vector>
+
+PixelFilter::PixelFilter(PixelFilterType type)
+	:Type(type)
+{
+	switch (Type)
+	{
+	case PixelFilterGaussian:
+		Radius = 1.5f;
+		break;
+	case PixelFilterMitchell:
+	case PixelFilterBlackmanHarris:
+		Radius = 2.0f;
+		break;
+	default:
+		Radius = 0.5f;
+		break;
+	}
+}
+
+float PixelFilter::Evaluate(float x) const
+{
+	x = std::abs(x);
+	if (x >= Radius)
+		return 0.0f;
+
+	switch (Type)
+	{
+	case PixelFilterGaussian:
+	{
+		// Shifted down so that it reaches 0 at the radius
+		constexpr float sigma = 0.5f;
+		auto gaussian = [](float v) { return std::exp(-v * v / (2.0f * sigma * sigma)); };
+		return gaussian(x) - gaussian(Radius);
+	}
+	case PixelFilterMitchell:
+	{
+		// B = C = 1/3 on [-2, 2], negative beyond about 1.15
+		constexpr float b = 1.0f / 3.0f;
+		constexpr float c = 1.0f / 3.0f;
+		const float t = 2.0f * x / Radius;
+		if (t < 1.0f)
+			return ((12.0f - 9.0f * b - 6.0f * c) * t * t * t + (-18.0f + 12.0f * b + 6.0f * c) * t * t +
+					(6.0f - 2.0f * b)) / 6.0f;
+		return ((-b - 6.0f * c) * t * t * t + (6.0f * b + 30.0f * c) * t * t + (-12.0f * b - 48.0f * c) * t +
+				(8.0f * b + 24.0f * c)) / 6.0f;
+	}
+	case PixelFilterBlackmanHarris:
+	{
+		constexpr float pi = std::numbers::pi_v<float>;
+		const float t = (x + Radius) / (2.0f * Radius);
+		return 0.35875f - 0.48829f * std::cos(2.0f * pi * t) + 0.14128f * std::cos(4.0f * pi * t) -
+			0.01168f * std::cos(6.0f * pi * t);
+	}
+	default:
+		return 1.0f;
+	}
+}
+
+float PixelFilter::BuildSampleTable(glm::vec4 (&table)[PixelFilterTableSize / 2]) const
+{
+	// Piecewise constant |f| on fine bins, inverted linearly within a bin
+	constexpr uint32_t numBins = 1024;
+	const float binWidth = 2.0f * Radius / numBins;
+
+	std::vector<float> cdf(numBins + 1, 0.0f);
+	double integral = 0.0;
+	for (uint32_t i = 0; i < numBins; i++)
+	{
+		const float f = Evaluate(-Radius + (i + 0.5f) * binWidth);
+		integral += f * binWidth;
+		cdf[i + 1] = cdf[i] + std::abs(f) * binWidth;
+	}
+	const float absIntegral = cdf[numBins];
+
+	for (uint32_t k = 0; k < PixelFilterTableSize; k++)
+	{
+		const float target = absIntegral * k / (PixelFilterTableSize - 1);
+		const auto upper = std::upper_bound(cdf.begin(), cdf.end(), target);
+		const uint32_t bin = static_cast<uint32_t>(std::clamp<std::ptrdiff_t>(upper - cdf.begin() - 1, 0, numBins - 1));
+
+		const float width = cdf[bin + 1] - cdf[bin];
+		const float t = width > 0.0f ? std::clamp((target - cdf[bin]) / width, 0.0f, 1.0f) : 0.5f;
+		const float offset = -Radius + (bin + t) * binWidth;
+		const float sign = Evaluate(offset) < 0.0f ? -1.0f : 1.0f;
+
+		table[k / 2][2 * (k % 2)] = offset;
+		table[k / 2][2 * (k % 2) + 1] = sign;
+	}
+
+	const float ratio = integral > 0.0 ? static_cast<float>(absIntegral / integral) : 1.0f;
+	return ratio * ratio;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "Core.h"
+#include "Shaders/HLSLCompat.h"
+
+enum PixelFilterType : uint32_t
+{
+	PixelFilterBox = 0,
+	PixelFilterGaussian,
+	PixelFilterMitchell,
+	PixelFilterBlackmanHarris,
+	PixelFilterTypeCount
+};
+
+// Separable reconstruction filter of the image samples. Instead of weighting splatted samples, the
+// ray generation shader draws the sub-pixel offsets proportionally to |f| (filter importance
+// sampling, Ernst et al. 2006), so every sample stays inside its own pixel and tiles need no guard
+// band. Negative lobes come back as a negative sample weight
+struct PixelFilter
+{
+	PixelFilter() = default;
+	explicit PixelFilter(PixelFilterType type);
+
+	float Evaluate(float x) const;
+
+	// Inverse CDF of |f| along one axis at PixelFilterTableSize evenly spaced points, packed as
+	// (offset, sign of f) pairs two per vector. Returns the weight of a 2D sample, the squared
+	// ratio of the integrals of |f| and f
+	float BuildSampleTable(glm::vec4 (&table)[PixelFilterTableSize / 2]) const;
+
+	inline PixelFilterType GetType() const { return Type; }
+	inline float GetRadius() const { return Radius; }
+
+private:
+	PixelFilterType Type = PixelFilterBox;
+	float Radius = 0.5f;
+};
@@ -0,0 +1,470 @@
+#include "Scene.h"
+#include "SceneArchive.h"
+
+#include <algorithm>
+#include <charconv>
+#include <execution>
+#include <fstream>
+#include <numeric>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+namespace
+{
+	// Recursive descent over the text in memory, without building a tree. Every parse function
+	// leaves the cursor after what it read and returns false with Error set on malformed input
+	struct SceneParser
+	{
+		const char* Begin = nullptr;
+		const char* Cursor = nullptr;
+		const char* End = nullptr;
+		std::string Error;
+		const char* ErrorPosition = nullptr;
+
+		bool Fail(const std::string& message)
+		{
+			if (Error.empty())
+			{
+				Error = message;
+				ErrorPosition = Cursor;
+			}
+			return false;
+		}
+
+		void SkipWhitespace()
+		{
+			while (Cursor < End && (*Cursor == ' ' || *Cursor == '\n' || *Cursor == '\r' || *Cursor == '\t'))
+				Cursor++;
+		}
+
+		// Skips whitespace before looking at the next character
+		bool Peek(char c)
+		{
+			SkipWhitespace();
+			return Cursor < End && *Cursor == c;
+		}
+
+		bool Expect(char c)
+		{
+			if (!Peek(c))
+				return Fail(std::string("expected '") + c + "'");
+			Cursor++;
+			return true;
+		}
+
+		// Escapes stay in the view, names do not need them decoded
+		bool ParseString(std::string_view& value)
+		{
+			if (!Expect('"'))
+				return false;
+			const char* first = Cursor;
+			while (Cursor < End && *Cursor != '"')
+				Cursor += *Cursor == '\\' ? 2 : 1;
+			if (Cursor >= End)
+				return Fail("unterminated string");
+			value = std::string_view(first, Cursor - first);
+			Cursor++;
+			return true;
+		}
+
+		template<typename T>
+		bool ParseNumber(T& value)
+		{
+			SkipWhitespace();
+			auto [next, error] = std::from_chars(Cursor, End, value);
+			if (error != std::errc())
+				return Fail("expected a number");
+			Cursor = next;
+			return true;
+		}
+
+		template<typename Vector>
+		bool ParseVector(Vector& value)
+		{
+			if (!Expect('['))
+				return false;
+			for (int i = 0; i < Vector::length(); i++)
+			{
+				if ((i > 0 && !Expect(',')) || !ParseNumber(value[i]))
+					return false;
+			}
+			return Expect(']');
+		}
+
+		// Calls member(key) for every member, which parses the value
+		template<typename Member>
+		bool ParseObject(Member&& member)
+		{
+			if (!Expect('{'))
+				return false;
+			if (Peek('}'))
+			{
+				Cursor++;
+				return true;
+			}
+			for (;;)
+			{
+				std::string_view key;
+				if (!ParseString(key) || !Expect(':') || !member(key))
+					return false;
+				if (!Peek(','))
+					return Expect('}');
+				Cursor++;
+			}
+		}
+
+		template<typename Element>
+		bool ParseArray(Element&& element)
+		{
+			if (!Expect('['))
+				return false;
+			if (Peek(']'))
+			{
+				Cursor++;
+				return true;
+			}
+			for (;;)
+			{
+				if (!element())
+					return false;
+				if (!Peek(','))
+					return Expect(']');
+				Cursor++;
+			}
+		}
+
+		// Values of unknown members, so that files can carry more than this version reads
+		bool SkipValue()
+		{
+			SkipWhitespace();
+			if (Cursor >= End)
+				return Fail("expected a value");
+
+			std::string_view ignored;
+			switch (*Cursor)
+			{
+			case '{':
+				return ParseObject([this](std::string_view) { return SkipValue(); });
+			case '[':
+				return ParseArray([this]() { return SkipValue(); });
+			case '"':
+				return ParseString(ignored);
+			default:
+				break;
+			}
+
+			for (const char* literal : { "true", "false", "null" })
+			{
+				const size_t length = std::strlen(literal);
+				if (size_t(End - Cursor) >= length && std::string_view(Cursor, length) == literal)
+				{
+					Cursor += length;
+					return true;
+				}
+			}
+			double number;
+			return ParseNumber(number);
+		}
+
+		uint32_t GetLine(const char* position) const
+		{
+			return 1 + static_cast<uint32_t>(std::count(Begin, position, '\n'));
+		}
+	};
+
+	// Material references are resolved once all materials are known, they may come after the spheres
+	struct SphereEntry
+	{
+		std::string_view MaterialName;
+		uint32_t MaterialIndex = ~0u;
+	};
+
+	bool ParseSphere(SceneParser& parser, Sphere& sphere, SphereEntry& entry)
+	{
+		return parser.ParseObject([&](std::string_view key)
+		{
+			if (key == "center")
+				return parser.ParseVector(sphere.Center);
+			if (key == "radius")
+				return parser.ParseNumber(sphere.Radius);
+			if (key == "albedo")
+				return parser.ParseVector(sphere.Albedo);
+			if (key == "material")
+			{
+				return parser.Peek('"') ? parser.ParseString(entry.MaterialName) :
+					parser.ParseNumber(entry.MaterialIndex);
+			}
+			return parser.SkipValue();
+		});
+	}
+
+	// Finds where the elements of the array at the cursor start, only tracking nesting and strings,
+	// and leaves the cursor after the array. Numbers are not looked at, they are parsed later in
+	// parallel from these offsets
+	bool FindElements(SceneParser& parser, std::vector<const char*>& elements)
+	{
+		if (!parser.Expect('['))
+			return false;
+
+		uint32_t depth = 1;
+		bool separated = true;
+		for (; parser.Cursor < parser.End && depth > 0; parser.Cursor++)
+		{
+			const char c = *parser.Cursor;
+			if (depth == 1 && separated && c != ' ' && c != '\n' && c != '\r' && c != '\t' && c != ']')
+			{
+				elements.push_back(parser.Cursor);
+				separated = false;
+			}
+
+			if (c == '"')
+			{
+				for (parser.Cursor++; parser.Cursor < parser.End && *parser.Cursor != '"'; parser.Cursor++)
+					parser.Cursor += *parser.Cursor == '\\';
+			}
+			else if (c == '{' || c == '[')
+				depth++;
+			else if (c == '}' || c == ']')
+				depth--;
+			else if (c == ',' && depth == 1)
+				separated = true;
+		}
+		if (depth > 0)
+			return parser.Fail("unterminated array");
+		return true;
+	}
+
+	// Elements are split into one contiguous range per worker, each with a parser of its own over
+	// the same text. The first error in file order is reported
+	bool ParseSpheres(SceneParser& parser, std::vector<Sphere>& spheres, std::vector<SphereEntry>& entries)
+	{
+		std::vector<const char*> elements;
+		if (!FindElements(parser, elements))
+			return false;
+
+		spheres.assign(elements.size(), Sphere{});
+		entries.assign(elements.size(), SphereEntry{});
+
+		constexpr size_t minSpheresPerRange = 4096;
+		const size_t rangeCount = std::clamp<size_t>(elements.size() / minSpheresPerRange, 1,
+													 std::max(1u, std::thread::hardware_concurrency()));
+		std::vector<SceneParser> parsers(rangeCount, parser);
+		std::vector<size_t> ranges(rangeCount);
+		std::iota(ranges.begin(), ranges.end(), 0);
+
+		std::for_each(std::execution::par, ranges.begin(), ranges.end(), [&](size_t range)
+		{
+			SceneParser& local = parsers[range];
+			const size_t first = elements.size() * range / rangeCount;
+			const size_t last = elements.size() * (range + 1) / rangeCount;
+			for (size_t i = first; i < last; i++)
+			{
+				local.Cursor = elements[i];
+				if (!ParseSphere(local, spheres[i], entries[i]))
+					return;
+			}
+		});
+
+		for (const SceneParser& local : parsers)
+		{
+			if (!local.Error.empty())
+			{
+				parser.Error = local.Error;
+				parser.ErrorPosition = local.ErrorPosition;
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool ParseMaterial(SceneParser& parser, SceneMaterial& material)
+	{
+		return parser.ParseObject([&](std::string_view key)
+		{
+			std::string_view text;
+			if (key == "name")
+			{
+				if (!parser.ParseString(text))
+					return false;
+				material.Name = text;
+				return true;
+			}
+			if (key == "type")
+			{
+				if (!parser.ParseString(text))
+					return false;
+				const std::pair<std::string_view, MaterialType> types[] = {
+					{ "diffuse", MaterialType::Diffuse },
+					{ "metal", MaterialType::Metal },
+					{ "dielectric", MaterialType::Dielectric },
+					{ "emissive", MaterialType::Emissive } };
+				auto type = std::find_if(std::begin(types), std::end(types),
+										 [text](const auto& entry) { return entry.first == text; });
+				if (type == std::end(types))
+					return parser.Fail("unknown material type");
+				material.Type = type->second;
+				return true;
+			}
+			if (key == "roughness")
+				return parser.ParseNumber(material.Parameters.Roughness);
+			if (key == "eta")
+				return parser.ParseNumber(material.Parameters.Eta);
+			return parser.SkipValue();
+		});
+	}
+
+	bool ParseScene(SceneParser& parser, Scene& scene, std::vector<SphereEntry>& entries)
+	{
+		bool materialsGiven = false;
+		const bool parsed = parser.ParseObject([&](std::string_view key)
+		{
+			if (key == "spheres")
+				return ParseSpheres(parser, scene.Spheres, entries);
+			if (key == "materials")
+			{
+				materialsGiven = true;
+				scene.Materials.clear();
+				return parser.ParseArray([&]()
+				{
+					return ParseMaterial(parser, scene.Materials.emplace_back());
+				});
+			}
+			if (key == "camera")
+			{
+				SceneView& view = scene.View;
+				return parser.ParseObject([&](std::string_view member)
+				{
+					if (member == "position")
+						return parser.ParseVector(view.Position);
+					if (member == "rotation")
+						return parser.ParseVector(view.Rotation);
+					if (member == "fovY")
+						return parser.ParseNumber(view.FovY);
+					if (member == "near")
+						return parser.ParseNumber(view.NearZ);
+					if (member == "far")
+						return parser.ParseNumber(view.FarZ);
+					return parser.SkipValue();
+				});
+			}
+			if (key == "sky")
+			{
+				return parser.ParseObject([&](std::string_view member)
+				{
+					if (member == "horizon")
+						return parser.ParseVector(scene.Sky.Horizon);
+					if (member == "zenith")
+						return parser.ParseVector(scene.Sky.Zenith);
+					return parser.SkipValue();
+				});
+			}
+			if (key == "render")
+			{
+				SceneSettings& settings = scene.Settings;
+				return parser.ParseObject([&](std::string_view member)
+				{
+					if (member == "raysPerPixel")
+						return parser.ParseNumber(settings.RaysPerPixel);
+					if (member == "maxDepth")
+						return parser.ParseNumber(settings.MaxDepth);
+					if (member == "resolution")
+						return parser.ParseVector(settings.Resolution);
+					return parser.SkipValue();
+				});
+			}
+			return parser.SkipValue();
+		});
+		if (!parsed)
+			return false;
+
+		parser.SkipWhitespace();
+		if (parser.Cursor != parser.End)
+			return parser.Fail("unexpected text after the scene");
+		if (scene.Spheres.empty())
+			return parser.Fail("the scene has no spheres");
+		if (materialsGiven && scene.Materials.empty())
+			return parser.Fail("the scene has no materials");
+		return true;
+	}
+}
+
+Scene Scene::Default()
+{
+	Scene scene;
+	scene.Materials = {
+		SceneMaterial{ .Name = "diffuse", .Type = MaterialType::Diffuse, .Parameters = { .Roughness = 0.0f, .Eta = 0.0f } },
+		SceneMaterial{ .Name = "metal", .Type = MaterialType::Metal, .Parameters = { .Roughness = 0.2f, .Eta = 0.0f } },
+		SceneMaterial{ .Name = "glass", .Type = MaterialType::Dielectric, .Parameters = { .Roughness = 0.0f, .Eta = 1.52f } },
+		SceneMaterial{ .Name = "light", .Type = MaterialType::Emissive, .Parameters = { .Roughness = 0.0f, .Eta = 0.0f } } };
+	scene.Spheres = {
+		Sphere{ glm::vec3(0), 1, glm::vec3(0.8f, 0.0f, 0.0f) },
+		Sphere{ glm::vec3(0, -101, 0), 100, glm::vec3(0.3f, 0.4f, 0.8f) },
+		Sphere(glm::vec3(-2, 0, 0), 1, glm::vec3(1.0f, 1.0f, 1.0f), MaterialType::Dielectric),
+		Sphere(glm::vec3(2, 0, 0), 1, glm::vec3(0.8f, 0.6f, 0.2f), MaterialType::Metal) };
+	return scene;
+}
+
+bool Scene::Load(const std::string& path, std::string& error)
+{
+	if (SceneArchive::IsArchive(path))
+	{
+		Scene scene = Default();
+		scene.Archive = std::make_shared<SceneArchive>();
+		if (!scene.Archive->Open(path, error) || !scene.Archive->Read(scene, error))
+			return false;
+		*this = std::move(scene);
+		return true;
+	}
+
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file)
+	{
+		error = path + ": cannot open the file";
+		return false;
+	}
+	std::string text(static_cast<size_t>(file.tellg()), '\0');
+	file.seekg(0);
+	if (!file.read(text.data(), text.size()))
+	{
+		error = path + ": cannot read the file";
+		return false;
+	}
+
+	Scene scene = Default();
+	std::vector<SphereEntry> entries;
+	SceneParser parser;
+	parser.Begin = parser.Cursor = text.data();
+	parser.End = text.data() + text.size();
+	bool parsed = ParseScene(parser, scene, entries);
+
+	// Spheres take the shading model of their material
+	std::unordered_map<std::string_view, uint32_t> names;
+	for (uint32_t i = 0; i < scene.Materials.size(); i++)
+		names.emplace(scene.Materials[i].Name, i);
+	for (size_t i = 0; parsed && i < scene.Spheres.size(); i++)
+	{
+		uint32_t index = entries[i].MaterialIndex != ~0u ? entries[i].MaterialIndex : 0;
+		if (!entries[i].MaterialName.empty())
+		{
+			auto name = names.find(entries[i].MaterialName);
+			index = name != names.end() ? name->second : ~0u;
+		}
+		if (index >= scene.Materials.size())
+		{
+			parser.Cursor = entries[i].MaterialName.empty() ? parser.End : entries[i].MaterialName.data();
+			parsed = parser.Fail("sphere " + std::to_string(i) + " refers to a material that does not exist");
+			break;
+		}
+		scene.Spheres[i].Type = scene.Materials[index].Type;
+		scene.Spheres[i].MaterialIndex = index;
+	}
+
+	if (!parsed)
+	{
+		error = path + ":" + std::to_string(parser.GetLine(parser.ErrorPosition)) + ": " + parser.Error;
+		return false;
+	}
+	*this = std::move(scene);
+	return true;
+}
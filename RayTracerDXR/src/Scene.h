@@ -0,0 +1,68 @@
+#pragma once
+
+#include "Core.h"
+
+#include "Sphere.h"
+
+#include "Shaders/HLSLCompat.h"
+
+#include <span>
+
+struct SceneArchive;
+
+struct SceneMaterial
+{
+	std::string Name;
+	MaterialType Type = MaterialType::Diffuse;
+	Material Parameters = {};
+};
+
+// Camera pose, the vertical field of view is in the unit Projection takes it in
+struct SceneView
+{
+	glm::vec3 Position = glm::vec3(0.0f, 0.0f, -4.0f);
+	glm::vec3 Rotation = glm::vec3(0.0f);
+	float FovY = 2.0f;
+	float NearZ = 0.1f;
+	float FarZ = 100.0f;
+};
+
+// Gradient from the horizon up to the zenith
+struct SceneSky
+{
+	glm::vec3 Horizon = glm::vec3(1.0f);
+	glm::vec3 Zenith = glm::vec3(0.5f, 0.7f, 1.0f);
+};
+
+// Resolution 0 keeps the size the window was asked for
+struct SceneSettings
+{
+	uint32_t RaysPerPixel = 32;
+	uint32_t MaxDepth = maxTraceRecursionDepth;
+	glm::uvec2 Resolution = glm::uvec2(0);
+};
+
+// Everything the renderer starts from. Spheres refer to their material by index, the type of
+// the material decides the shading model and its parameters are shared by all spheres using it
+struct Scene
+{
+	std::vector<Sphere> Spheres;
+	// Set for scenes loaded from an archive, the spheres are then the mapped ones and the archive
+	// may hold a prebuilt light hierarchy
+	std::shared_ptr<SceneArchive> Archive;
+	std::span<const Sphere> MappedSpheres;
+	std::vector<SceneMaterial> Materials;
+	SceneView View;
+	SceneSky Sky;
+	SceneSettings Settings;
+
+	// Three spheres on a large ground sphere, one material per type
+	static Scene Default();
+
+	// JSON, see scenes/default.json, or a SceneArchive. Sections that are left out keep their
+	// defaults, materials the ones of the default scene. Leaves the scene untouched and describes
+	// the problem with its line in error if the file cannot be read
+	bool Load(const std::string& path, std::string& error);
+
+	inline std::span<const Sphere> GetSpheres() const { return Archive ? MappedSpheres : Spheres; }
+};
@@ -0,0 +1,309 @@
+#include "SceneArchive.h"
+#include "Checkpoint.h"
+#include "Lights.h"
+#include "Scene.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <execution>
+#include <fstream>
+#include <numeric>
+
+namespace
+{
+	// Followed by the section table, the table checksum keeps Open from trusting a damaged table
+	struct ArchiveHeader
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint32_t SectionCount;
+		uint32_t Reserved;
+		uint64_t FileSize;
+		uint64_t TableChecksum;
+	};
+
+	struct SectionEntry
+	{
+		uint32_t Type;
+		uint32_t Stride;
+		uint64_t Offset;
+		uint64_t Count;
+		uint64_t Checksum;
+	};
+
+	struct ArchivedSettings
+	{
+		glm::vec3 Position;
+		glm::vec3 Rotation;
+		float FovY;
+		float NearZ;
+		float FarZ;
+		glm::vec3 SkyHorizon;
+		glm::vec3 SkyZenith;
+		uint32_t RaysPerPixel;
+		uint32_t MaxDepth;
+		glm::uvec2 Resolution;
+	};
+
+	struct ArchivedMaterial
+	{
+		Material Parameters;
+		uint32_t Type;
+	};
+
+	struct SectionSource
+	{
+		SceneSection Type;
+		uint32_t Stride;
+		const void* Data;
+		uint64_t Count;
+	};
+
+	template<typename T>
+	SectionSource MakeSection(SceneSection type, std::span<const T> records)
+	{
+		return SectionSource{ .Type = type, .Stride = sizeof(T), .Data = records.data(), .Count = records.size() };
+	}
+
+	uint64_t AlignSection(uint64_t offset)
+	{
+		return (offset + SceneArchive::SectionAlignment - 1) / SceneArchive::SectionAlignment * SceneArchive::SectionAlignment;
+	}
+}
+
+SceneArchive::~SceneArchive()
+{
+	if (Base)
+		UnmapViewOfFile(Base);
+	if (Mapping)
+		CloseHandle(Mapping);
+	if (File != INVALID_HANDLE_VALUE)
+		CloseHandle(File);
+}
+
+bool SceneArchive::Open(const std::string& path, std::string& error)
+{
+	Path = path;
+	File = CreateFileW(string_2_wstring(path).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+					   FILE_ATTRIBUTE_NORMAL, nullptr);
+	LARGE_INTEGER size{};
+	if (File == INVALID_HANDLE_VALUE || !GetFileSizeEx(File, &size))
+	{
+		error = path + ": cannot open the file";
+		return false;
+	}
+	FileSize = static_cast<uint64_t>(size.QuadPart);
+
+	if (FileSize >= sizeof(ArchiveHeader))
+	{
+		Mapping = CreateFileMappingW(File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (Mapping)
+			Base = static_cast<const uint8_t*>(MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0));
+	}
+	if (!Base)
+	{
+		error = path + ": cannot map the file";
+		return false;
+	}
+
+	const ArchiveHeader& header = *reinterpret_cast<const ArchiveHeader*>(Base);
+	if (header.Magic != Magic || header.Version != Version)
+	{
+		error = path + ": not a scene archive of version " + std::to_string(Version);
+		return false;
+	}
+
+	const uint64_t tableSize = uint64_t(header.SectionCount) * sizeof(SectionEntry);
+	if (header.FileSize != FileSize || tableSize > FileSize - sizeof(ArchiveHeader))
+	{
+		error = path + ": the file is truncated";
+		return false;
+	}
+	const SectionEntry* table = reinterpret_cast<const SectionEntry*>(Base + sizeof(ArchiveHeader));
+	if (Checksum(table, tableSize) != header.TableChecksum)
+	{
+		error = path + ": the section table is damaged";
+		return false;
+	}
+
+	Sections.clear();
+	for (uint32_t i = 0; i < header.SectionCount; i++)
+	{
+		const SectionEntry& entry = table[i];
+		if (entry.Stride == 0 || entry.Offset % SectionAlignment != 0 || entry.Offset > FileSize ||
+			entry.Count > (FileSize - entry.Offset) / entry.Stride)
+		{
+			error = path + ": section " + std::to_string(i) + " lies outside the file";
+			return false;
+		}
+		Sections.push_back(MappedSection{ .Type = static_cast<SceneSection>(entry.Type), .Stride = entry.Stride,
+										  .Offset = entry.Offset, .Count = entry.Count, .Checksum = entry.Checksum });
+	}
+	return true;
+}
+
+bool SceneArchive::Read(Scene& scene, std::string& error)
+{
+	std::span<const ArchivedSettings> settings = GetSection<ArchivedSettings>(SceneSection::Settings);
+	std::span<const ArchivedMaterial> materials = GetSection<ArchivedMaterial>(SceneSection::Materials);
+	std::span<const Sphere> spheres = GetSection<Sphere>(SceneSection::Spheres);
+	if (settings.size() != 1 || materials.empty() || spheres.empty())
+	{
+		error = Path + ": settings, materials or spheres are missing or damaged";
+		return false;
+	}
+
+	const ArchivedSettings& stored = settings.front();
+	scene.View = SceneView{ .Position = stored.Position, .Rotation = stored.Rotation, .FovY = stored.FovY,
+							.NearZ = stored.NearZ, .FarZ = stored.FarZ };
+	scene.Sky = SceneSky{ .Horizon = stored.SkyHorizon, .Zenith = stored.SkyZenith };
+	scene.Settings = SceneSettings{ .RaysPerPixel = stored.RaysPerPixel, .MaxDepth = stored.MaxDepth,
+									.Resolution = stored.Resolution };
+
+	scene.Materials.clear();
+	for (const ArchivedMaterial& material : materials)
+	{
+		if (material.Type >= MaterialType::Count)
+		{
+			error = Path + ": unknown material type " + std::to_string(material.Type);
+			return false;
+		}
+		scene.Materials.push_back(SceneMaterial{ .Type = static_cast<MaterialType>(material.Type),
+												 .Parameters = material.Parameters });
+	}
+
+	// The records go to the shaders as they are, so they are held to what the text loader accepts
+	const uint32_t materialCount = static_cast<uint32_t>(scene.Materials.size());
+	auto invalid = std::find_if(std::execution::par, spheres.begin(), spheres.end(), [materialCount](const Sphere& sphere)
+	{
+		return sphere.MaterialIndex >= materialCount || static_cast<uint32_t>(sphere.Type) >= MaterialType::Count;
+	});
+	if (invalid != spheres.end())
+	{
+		error = Path + ": sphere " + std::to_string(invalid - spheres.begin()) +
+			(invalid->MaterialIndex >= materialCount ? " refers to a material that does not exist" : " has an unknown type");
+		return false;
+	}
+
+	scene.Spheres.clear();
+	scene.MappedSpheres = spheres;
+	return true;
+}
+
+bool SceneArchive::Write(const std::string& path, const Scene& scene, std::string& error)
+{
+	const ArchivedSettings settings{
+		.Position = scene.View.Position,
+		.Rotation = scene.View.Rotation,
+		.FovY = scene.View.FovY,
+		.NearZ = scene.View.NearZ,
+		.FarZ = scene.View.FarZ,
+		.SkyHorizon = scene.Sky.Horizon,
+		.SkyZenith = scene.Sky.Zenith,
+		.RaysPerPixel = scene.Settings.RaysPerPixel,
+		.MaxDepth = scene.Settings.MaxDepth,
+		.Resolution = scene.Settings.Resolution };
+
+	std::vector<ArchivedMaterial> materials;
+	for (const SceneMaterial& material : scene.Materials)
+		materials.push_back(ArchivedMaterial{ .Parameters = material.Parameters, .Type = material.Type });
+
+	SphereComposite spheres;
+	spheres.Reference(scene.GetSpheres());
+	LightSampler lights;
+	lights.Build(spheres);
+
+	std::vector<SectionSource> sections = {
+		MakeSection(SceneSection::Settings, std::span<const ArchivedSettings>(&settings, 1)),
+		MakeSection(SceneSection::Materials, std::span<const ArchivedMaterial>(materials)),
+		MakeSection(SceneSection::Spheres, scene.GetSpheres()) };
+	if (lights.Size() > 0)
+	{
+		sections.push_back(MakeSection(SceneSection::Lights, std::span<const LightInfo>(lights.Data().data(), lights.Size())));
+		sections.push_back(MakeSection(SceneSection::LightNodes, std::span<const LightBVHNode>(lights.GetHierarchy().Data())));
+	}
+
+	std::vector<SectionEntry> table;
+	uint64_t offset = AlignSection(sizeof(ArchiveHeader) + sections.size() * sizeof(SectionEntry));
+	for (const SectionSource& section : sections)
+	{
+		const uint64_t size = section.Count * section.Stride;
+		table.push_back(SectionEntry{ .Type = static_cast<uint32_t>(section.Type), .Stride = section.Stride,
+									  .Offset = offset, .Count = section.Count,
+									  .Checksum = Checksum(section.Data, static_cast<size_t>(size)) });
+		offset = AlignSection(offset + size);
+	}
+
+	const ArchiveHeader header{
+		.Magic = Magic,
+		.Version = Version,
+		.SectionCount = static_cast<uint32_t>(table.size()),
+		.Reserved = 0,
+		.FileSize = offset,
+		.TableChecksum = Checksum(table.data(), table.size() * sizeof(SectionEntry)) };
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(SectionEntry));
+	for (size_t i = 0; i < sections.size(); i++)
+	{
+		file.seekp(static_cast<std::streamoff>(table[i].Offset));
+		file.write(static_cast<const char*>(sections[i].Data), static_cast<std::streamsize>(table[i].Count * table[i].Stride));
+	}
+
+	// The last section ends on the alignment like every other one
+	file.seekp(static_cast<std::streamoff>(offset - 1));
+	file.put('\0');
+	if (!file.flush())
+	{
+		error = path + ": cannot write the file";
+		return false;
+	}
+	return true;
+}
+
+bool SceneArchive::IsArchive(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	uint32_t magic = 0;
+	file.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+	return file && magic == Magic;
+}
+
+uint64_t SceneArchive::Checksum(const void* data, size_t size)
+{
+	constexpr size_t blockSize = 1 << 20;
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	std::vector<uint64_t> blocks((size + blockSize - 1) / blockSize);
+	std::iota(blocks.begin(), blocks.end(), 0);
+
+	std::for_each(std::execution::par, blocks.begin(), blocks.end(), [&](uint64_t& block)
+	{
+		const size_t offset = static_cast<size_t>(block) * blockSize;
+		block = Checkpoint::Hash(bytes + offset, std::min(blockSize, size - offset));
+	});
+	return Checkpoint::Hash(blocks.data(), blocks.size() * sizeof(uint64_t), Checkpoint::Hash(size, Checkpoint::HashBasis));
+}
+
+const void* SceneArchive::GetSectionData(SceneSection type, uint32_t stride, uint64_t& count)
+{
+	count = 0;
+	auto section = std::find_if(Sections.begin(), Sections.end(),
+								[type](const MappedSection& entry) { return entry.Type == type; });
+	if (section == Sections.end() || section->Stride != stride)
+		return nullptr;
+
+	const uint8_t* data = Base + section->Offset;
+	if (section->Check == SectionCheck::Pending)
+	{
+		const bool valid = Checksum(data, static_cast<size_t>(section->Count * stride)) == section->Checksum;
+		section->Check = valid ? SectionCheck::Valid : SectionCheck::Invalid;
+		if (!valid)
+			OutputDebugStringA((Path + ": checksum mismatch in section " + std::to_string(uint32_t(type)) + "\n").c_str());
+	}
+	if (section->Check == SectionCheck::Invalid)
+		return nullptr;
+
+	count = section->Count;
+	return data;
+}
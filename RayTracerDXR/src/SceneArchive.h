@@ -0,0 +1,90 @@
+#pragma once
+
+#include "Core.h"
+
+#include <span>
+
+struct Scene;
+
+// Sections of a scene archive, readers skip types they do not know
+enum class SceneSection : uint32_t
+{
+	// One record with the camera, sky and render settings
+	Settings = 1,
+	// Shading parameters and type per material, names are not stored
+	Materials,
+	// SphereInfo records in the layout of the sphere buffer
+	Spheres,
+	// Prebuilt light alias table and light BVH, missing if the scene has no lights
+	Lights,
+	LightNodes
+};
+
+// Binary scene file that is mapped and used in place. A header and a table of sections are
+// followed by the sections, each one an array of fixed size records starting on a page boundary
+// so that it can be handed to the renderer as it is. Every section has a checksum which is only
+// computed the first time the section is asked for, sections that are never used are never read
+struct SceneArchive
+{
+	SceneArchive() = default;
+	~SceneArchive();
+	SceneArchive(const SceneArchive&) = delete;
+	SceneArchive& operator=(const SceneArchive&) = delete;
+
+	// Checks the header and the section table only, in time independent of the size of the scene
+	bool Open(const std::string& path, std::string& error);
+	// Copies settings and materials into the scene and points its spheres at the mapped ones.
+	// Every sphere is validated, which reads the whole section anyway, so the checksum of the
+	// spheres is not deferred like the others but computed here
+	bool Read(Scene& scene, std::string& error);
+
+	// Records of a section in place. Empty if the section is missing, has records of another size
+	// or does not match its checksum
+	template<typename T>
+	std::span<const T> GetSection(SceneSection type)
+	{
+		uint64_t count = 0;
+		const T* records = static_cast<const T*>(GetSectionData(type, sizeof(T), count));
+		return std::span<const T>(records, static_cast<size_t>(count));
+	}
+
+	// Converts a scene loaded from text, the light sections are built here so that loading the
+	// archive does not have to
+	static bool Write(const std::string& path, const Scene& scene, std::string& error);
+	static bool IsArchive(const std::string& path);
+
+	// FNV-1a of 1MB blocks hashed in parallel, chained over the block hashes
+	static uint64_t Checksum(const void* data, size_t size);
+
+	static constexpr uint32_t Magic = 0x43535452; // "RTSC"
+	static constexpr uint32_t Version = 1;
+	static constexpr uint64_t SectionAlignment = 4096;
+
+private:
+	const void* GetSectionData(SceneSection type, uint32_t stride, uint64_t& count);
+
+private:
+	enum class SectionCheck
+	{
+		Pending,
+		Valid,
+		Invalid
+	};
+
+	struct MappedSection
+	{
+		SceneSection Type;
+		uint32_t Stride = 0;
+		uint64_t Offset = 0;
+		uint64_t Count = 0;
+		uint64_t Checksum = 0;
+		SectionCheck Check = SectionCheck::Pending;
+	};
+
+	std::string Path;
+	HANDLE File = INVALID_HANDLE_VALUE;
+	HANDLE Mapping = nullptr;
+	const uint8_t* Base = nullptr;
+	uint64_t FileSize = 0;
+	std::vector<MappedSection> Sections;
+};
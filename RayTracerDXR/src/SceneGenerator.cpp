@@ -0,0 +1,203 @@
+#include "SceneGenerator.h"
+
+#include <algorithm>
+#include <execution>
+#include <numbers>
+#include <numeric>
+#include <thread>
+
+namespace
+{
+	// Values a sphere draws, each one has a fixed slot so that adding a draw does not change others
+	enum SphereDraw : uint32_t
+	{
+		DrawJitterX,
+		DrawJitterZ,
+		DrawMaterial,
+		DrawAlbedoR,
+		DrawAlbedoG,
+		DrawAlbedoB,
+		DrawAlbedoR2,
+		DrawAlbedoG2,
+		DrawAlbedoB2,
+		DrawVariant,
+		DrawCluster,
+		DrawCount
+	};
+
+	// Cluster centers draw from their own sequence
+	constexpr uint64_t ClusterStream = 0x636c7573746572ull;
+
+	// Materials of every generated scene, metal variants follow
+	enum GeneratedMaterial : uint32_t
+	{
+		GeneratedDiffuse,
+		GeneratedGlass,
+		GeneratedLight,
+		GeneratedMetal
+	};
+
+	constexpr float SmallRadius = 0.2f;
+	constexpr uint64_t SpheresPerRange = 1 << 16;
+
+	// splitmix64 finalizer
+	uint64_t Mix(uint64_t x)
+	{
+		x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+		x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+		return x ^ (x >> 31);
+	}
+
+	// Counter based, the value only depends on the seed, the index and the draw
+	float Random(uint64_t seed, uint64_t index, uint32_t draw)
+	{
+		return static_cast<float>(Mix(Mix(seed) ^ (index * DrawCount + draw)) >> 40) * 0x1p-24f;
+	}
+
+	// Box-Muller over two draws
+	glm::vec2 RandomGaussian(uint64_t seed, uint64_t index, uint32_t draw)
+	{
+		const float radius = std::sqrt(-2.0f * std::log(1.0f - Random(seed, index, draw)));
+		const float angle = 2.0f * std::numbers::pi_v<float> * Random(seed, index, draw + 1);
+		return radius * glm::vec2(std::cos(angle), std::sin(angle));
+	}
+
+	struct GeneratorLayout
+	{
+		uint64_t SmallCount = 0;
+		// Grid cells per side of one layer, one sphere per cell
+		uint64_t GridSide = 1;
+		uint64_t ClusterCount = 1;
+		float ClusterSigma = 1.0f;
+		float GroundRadius = 1000.0f;
+	};
+
+	float Weight(float weight)
+	{
+		return std::max(weight, 0.0f);
+	}
+
+	// Height of the ground sphere at x, z. Its top is at the origin
+	float GroundHeight(const GeneratorLayout& layout, float x, float z)
+	{
+		const float r = layout.GroundRadius;
+		return std::sqrt(std::max(r * r - x * x - z * z, 0.0f)) - r;
+	}
+
+	Sphere GenerateSphere(const SceneGeneratorSettings& settings, const GeneratorLayout& layout, uint64_t index)
+	{
+		const uint64_t seed = settings.Seed;
+		const float side = static_cast<float>(layout.GridSide);
+		float x = 0.0f, z = 0.0f, y = 0.0f;
+		switch (settings.Distribution)
+		{
+		case SceneDistribution::Uniform:
+		case SceneDistribution::Layered:
+		{
+			// Layered spheres alternate between the layers, so every layer gets the same share
+			const uint64_t layers = settings.Distribution == SceneDistribution::Layered ? std::max(settings.LayerCount, 1u) : 1;
+			const uint64_t cell = index / layers;
+			x = static_cast<float>(cell % layout.GridSide) - 0.5f * side + 0.9f * Random(seed, index, DrawJitterX);
+			z = static_cast<float>(cell / layout.GridSide) - 0.5f * side + 0.9f * Random(seed, index, DrawJitterZ);
+			y = static_cast<float>(index % layers) * settings.LayerSpacing;
+			break;
+		}
+		case SceneDistribution::Clustered:
+		{
+			const uint64_t cluster = std::min<uint64_t>(static_cast<uint64_t>(Random(seed, index, DrawCluster) * layout.ClusterCount),
+														layout.ClusterCount - 1);
+			const glm::vec2 offset = RandomGaussian(seed, index, DrawJitterX) * layout.ClusterSigma;
+			x = (Random(seed ^ ClusterStream, cluster, DrawJitterX) - 0.5f) * side + offset.x;
+			z = (Random(seed ^ ClusterStream, cluster, DrawJitterZ) - 0.5f) * side + offset.y;
+			break;
+		}
+		}
+		const glm::vec3 center(x, GroundHeight(layout, x, z) + y + SmallRadius, z);
+
+		const glm::vec3 random(Random(seed, index, DrawAlbedoR), Random(seed, index, DrawAlbedoG), Random(seed, index, DrawAlbedoB));
+		const glm::vec3 random2(Random(seed, index, DrawAlbedoR2), Random(seed, index, DrawAlbedoG2), Random(seed, index, DrawAlbedoB2));
+		const float total = Weight(settings.DiffuseWeight) + Weight(settings.MetalWeight) + Weight(settings.DielectricWeight) +
+							Weight(settings.EmissiveWeight);
+		float choice = Random(seed, index, DrawMaterial) * total;
+
+		if ((choice -= Weight(settings.DiffuseWeight)) < 0.0f || total <= 0.0f)
+			return Sphere(center, SmallRadius, random * random2, MaterialType::Diffuse, GeneratedDiffuse);
+		if ((choice -= Weight(settings.MetalWeight)) < 0.0f)
+		{
+			const uint32_t variants = std::max(settings.MetalVariants, 1u);
+			const uint32_t variant = std::min(static_cast<uint32_t>(Random(seed, index, DrawVariant) * variants), variants - 1);
+			return Sphere(center, SmallRadius, 0.5f + 0.5f * random, MaterialType::Metal, GeneratedMetal + variant);
+		}
+		if ((choice -= Weight(settings.DielectricWeight)) < 0.0f)
+			return Sphere(center, SmallRadius, glm::vec3(1.0f), MaterialType::Dielectric, GeneratedGlass);
+		return Sphere(center, SmallRadius, 1.0f + 3.0f * random, MaterialType::Emissive, GeneratedLight);
+	}
+}
+
+Scene GenerateScene(const SceneGeneratorSettings& settings)
+{
+	Scene scene;
+	scene.Materials = {
+		SceneMaterial{ .Name = "diffuse", .Type = MaterialType::Diffuse, .Parameters = { .Roughness = 0.0f, .Eta = 0.0f } },
+		SceneMaterial{ .Name = "glass", .Type = MaterialType::Dielectric, .Parameters = { .Roughness = 0.0f, .Eta = 1.5f } },
+		SceneMaterial{ .Name = "light", .Type = MaterialType::Emissive, .Parameters = { .Roughness = 0.0f, .Eta = 0.0f } } };
+	const uint32_t variants = std::max(settings.MetalVariants, 1u);
+	for (uint32_t i = 0; i < variants; i++)
+	{
+		const float roughness = variants > 1 ? 0.5f * i / (variants - 1) : 0.0f;
+		scene.Materials.push_back(SceneMaterial{ .Name = "metal" + std::to_string(i), .Type = MaterialType::Metal,
+												 .Parameters = { .Roughness = roughness, .Eta = 0.0f } });
+	}
+
+	// The spheres keep the density of the book, one per unit cell, and the ground grows with them
+	GeneratorLayout layout;
+	layout.SmallCount = settings.SphereCount > 4 ? settings.SphereCount - 4 : 0;
+	const uint64_t layers = settings.Distribution == SceneDistribution::Layered ? std::max(settings.LayerCount, 1u) : 1;
+	const uint64_t perLayer = std::max<uint64_t>((layout.SmallCount + layers - 1) / layers, 1);
+	layout.GridSide = static_cast<uint64_t>(std::ceil(std::sqrt(static_cast<double>(perLayer))));
+	layout.ClusterCount = std::max<uint64_t>(layout.SmallCount / std::max(settings.ClusterSize, 1u), 1);
+	layout.ClusterSigma = 0.5f * std::sqrt(static_cast<float>(std::max(settings.ClusterSize, 1u)));
+	layout.GroundRadius = std::max(1000.0f, 4.0f * static_cast<float>(layout.GridSide));
+
+	scene.Spheres.resize(4 + layout.SmallCount);
+	scene.Spheres[0] = Sphere(glm::vec3(0.0f, -layout.GroundRadius, 0.0f), layout.GroundRadius, glm::vec3(0.5f),
+							  MaterialType::Diffuse, GeneratedDiffuse);
+	scene.Spheres[1] = Sphere(glm::vec3(0.0f, 1.0f, 0.0f), 1.0f, glm::vec3(1.0f), MaterialType::Dielectric, GeneratedGlass);
+	scene.Spheres[2] = Sphere(glm::vec3(-4.0f, 1.0f, 0.0f), 1.0f, glm::vec3(0.4f, 0.2f, 0.1f), MaterialType::Diffuse, GeneratedDiffuse);
+	scene.Spheres[3] = Sphere(glm::vec3(4.0f, 1.0f, 0.0f), 1.0f, glm::vec3(0.7f, 0.6f, 0.5f), MaterialType::Metal, GeneratedMetal);
+
+	std::vector<uint64_t> ranges((layout.SmallCount + SpheresPerRange - 1) / SpheresPerRange);
+	std::iota(ranges.begin(), ranges.end(), 0);
+	auto generateRange = [&](uint64_t range)
+	{
+		const uint64_t last = std::min((range + 1) * SpheresPerRange, layout.SmallCount);
+		for (uint64_t i = range * SpheresPerRange; i < last; i++)
+			scene.Spheres[4 + i] = GenerateSphere(settings, layout, i);
+	};
+	if (settings.ThreadCount == 0)
+		std::for_each(std::execution::par, ranges.begin(), ranges.end(), generateRange);
+	else
+	{
+		std::vector<std::thread> threads;
+		for (uint32_t thread = 0; thread < settings.ThreadCount; thread++)
+		{
+			threads.emplace_back([&, thread]()
+			{
+				for (uint64_t range = thread; range < ranges.size(); range += settings.ThreadCount)
+					generateRange(range);
+			});
+		}
+		for (std::thread& thread : threads)
+			thread.join();
+	}
+
+	// Camera of the book, looking from (13, 2, 3) at the origin with a vertical field of view of
+	// 20 degrees, converted to the unit Projection takes
+	const glm::vec3 position(13.0f, 2.0f, 3.0f);
+	const glm::vec3 direction = glm::normalize(-position);
+	scene.View.Position = position;
+	scene.View.Rotation = glm::vec3(-std::asin(direction.y), std::atan2(direction.x, direction.z), 0.0f);
+	scene.View.FovY = glm::radians(glm::radians(20.0f));
+	scene.View.FarZ = 2.0f * layout.GroundRadius;
+	return scene;
+}
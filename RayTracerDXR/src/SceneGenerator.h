@@ -0,0 +1,43 @@
+#pragma once
+
+#include "Core.h"
+
+#include "Scene.h"
+
+// Where the small spheres go. Uniform is the jittered grid of the book, Clustered gathers them
+// around random centers and Layered stacks several grids on top of each other, so that rays
+// cross more of them
+enum class SceneDistribution
+{
+	Uniform,
+	Clustered,
+	Layered
+};
+
+// The material mix is given by relative weights. Metal roughness is drawn from MetalVariants
+// materials, all other parameters are per sphere
+struct SceneGeneratorSettings
+{
+	uint64_t Seed = 0;
+	// Including the ground and the three large spheres
+	uint64_t SphereCount = 488;
+	SceneDistribution Distribution = SceneDistribution::Uniform;
+
+	float DiffuseWeight = 0.8f;
+	float MetalWeight = 0.15f;
+	float DielectricWeight = 0.05f;
+	float EmissiveWeight = 0.0f;
+	uint32_t MetalVariants = 16;
+
+	uint32_t ClusterSize = 1024;
+	uint32_t LayerCount = 4;
+	float LayerSpacing = 2.0f;
+
+	// 0 leaves the threads to the parallel algorithms, otherwise that many threads take turns
+	uint32_t ThreadCount = 0;
+};
+
+// Final scene of Ray Tracing in One Weekend with any number of small spheres, which keep the
+// density of the book and spread out over a larger ground. Every sphere only depends on the seed
+// and its index, so the scene is the same no matter how many threads generate it
+Scene GenerateScene(const SceneGeneratorSettings& settings);
@@ -0,0 +1,170 @@
+#include "SceneSnapshot.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace
+{
+	std::shared_ptr<SphereChunk> CopyChunk(std::span<const Sphere> spheres)
+	{
+		auto chunk = std::make_shared<SphereChunk>();
+		chunk->Storage.assign(spheres.begin(), spheres.end());
+		chunk->Spheres = chunk->Storage;
+		return chunk;
+	}
+}
+
+SnapshotPin::SnapshotPin(SceneSnapshots* owner, uint32_t slot, const SceneSnapshot* snapshot)
+	:Owner(owner), Slot(slot), Snapshot(snapshot)
+{}
+
+SnapshotPin::SnapshotPin(SnapshotPin&& other) noexcept
+	:Owner(other.Owner), Slot(other.Slot), Snapshot(other.Snapshot)
+{
+	other.Owner = nullptr;
+}
+
+SnapshotPin::~SnapshotPin()
+{
+	if (Owner)
+		Owner->Readers[Slot].Epoch.store(SceneSnapshots::IdleEpoch);
+}
+
+SceneSnapshots::SceneSnapshots(std::span<const Sphere> spheres, bool reference, uint32_t materialCount)
+	:SphereCount(static_cast<uint32_t>(spheres.size())), MaterialCount(materialCount)
+{
+	SceneSnapshot* snapshot = new SceneSnapshot();
+	snapshot->Size = SphereCount;
+	for (size_t first = 0; first < spheres.size(); first += SceneSnapshot::ChunkSize)
+	{
+		const std::span<const Sphere> chunk = spheres.subspan(first, std::min<size_t>(SceneSnapshot::ChunkSize, spheres.size() - first));
+		snapshot->Chunks.push_back(reference ? std::make_shared<const SphereChunk>(SphereChunk{ .Spheres = chunk }) : CopyChunk(chunk));
+	}
+	Head.store(snapshot);
+}
+
+// Nothing may be pinned anymore
+SceneSnapshots::~SceneSnapshots()
+{
+	delete Head.load();
+	for (RetiredSnapshot* retired = Retired.load(); retired;)
+	{
+		RetiredSnapshot* next = retired->Next;
+		delete retired->Snapshot;
+		delete retired;
+		retired = next;
+	}
+}
+
+// Announcing an epoch that is already outdated only delays reclamation, so the slot is taken
+// with the epoch read before it
+SnapshotPin SceneSnapshots::Pin()
+{
+	for (;;)
+	{
+		for (uint32_t slot = 0; slot < MaxReaders; slot++)
+		{
+			uint64_t idle = IdleEpoch;
+			if (Readers[slot].Epoch.compare_exchange_strong(idle, GlobalEpoch.load()))
+				return SnapshotPin(this, slot, Head.load());
+		}
+		std::this_thread::yield();
+	}
+}
+
+uint64_t SceneSnapshots::Publish(std::span<const SphereEdit> edits)
+{
+	// No valid edit changes whether a sphere emits, so any version tells the lights apart
+	{
+		const SnapshotPin current = Pin();
+		for (const SphereEdit& edit : edits)
+		{
+			const std::string error = Validate(*current, edit);
+			if (!error.empty())
+			{
+				OutputDebugStringA(("Sphere edit rejected, " + error + "\n").c_str());
+				return 0;
+			}
+		}
+	}
+
+	for (;;)
+	{
+		// The base version must not be reclaimed while its chunks are copied
+		const SnapshotPin base = Pin();
+		auto next = std::make_unique<SceneSnapshot>(*base);
+		next->Version = base->Version + 1;
+
+		std::vector<std::vector<Sphere>*> copies(next->Chunks.size(), nullptr);
+		for (const SphereEdit& edit : edits)
+		{
+			const uint32_t chunk = edit.Index / SceneSnapshot::ChunkSize;
+			if (!copies[chunk])
+			{
+				auto copy = CopyChunk(next->Chunks[chunk]->Spheres);
+				copies[chunk] = &copy->Storage;
+				next->Chunks[chunk] = std::move(copy);
+			}
+			(*copies[chunk])[edit.Index % SceneSnapshot::ChunkSize] = edit.Value;
+		}
+
+		const SceneSnapshot* expected = &*base;
+		if (Head.compare_exchange_strong(expected, next.get()))
+		{
+			const uint64_t version = next->Version;
+			next.release();
+			// Readers that may still see the old version announced an epoch up to this one
+			Retire(new RetiredSnapshot{ .Snapshot = &*base, .Epoch = GlobalEpoch.fetch_add(1) });
+			return version;
+		}
+	}
+}
+
+std::string SceneSnapshots::Validate(const SceneSnapshot& current, const SphereEdit& edit) const
+{
+	const std::string sphere = "sphere " + std::to_string(edit.Index);
+	if (edit.Index >= SphereCount)
+		return "index " + std::to_string(edit.Index) + " is out of range";
+	if (edit.Value.MaterialIndex >= MaterialCount)
+		return sphere + " refers to material " + std::to_string(edit.Value.MaterialIndex) + ", which does not exist";
+	if (static_cast<uint32_t>(edit.Value.Type) >= MaterialType::Count)
+		return sphere + " has an unknown type";
+	// The alias table and the light BVH are only refitted, never rebuilt
+	if ((edit.Value.Type == MaterialType::Emissive) != (current[edit.Index].Type == MaterialType::Emissive))
+		return sphere + " would change the set of lights";
+	return {};
+}
+
+// The list is taken before the readers are scanned, so every version on it was retired before the
+// scan. A reader that can still see one of them announced an epoch up to its retirement and still
+// holds it, a reader that pins after the scan can only see a later version
+void SceneSnapshots::Reclaim()
+{
+	RetiredSnapshot* retired = Retired.exchange(nullptr);
+	if (!retired)
+		return;
+
+	uint64_t oldestReader = IdleEpoch;
+	for (const ReaderSlot& reader : Readers)
+		oldestReader = std::min(oldestReader, reader.Epoch.load());
+
+	while (retired)
+	{
+		RetiredSnapshot* next = retired->Next;
+		if (retired->Epoch < oldestReader)
+		{
+			delete retired->Snapshot;
+			delete retired;
+		}
+		else
+			Retire(retired);
+		retired = next;
+	}
+}
+
+void SceneSnapshots::Retire(RetiredSnapshot* retired)
+{
+	retired->Next = Retired.load();
+	while (!Retired.compare_exchange_weak(retired->Next, retired))
+		;
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "Core.h"
+
+#include "Sphere.h"
+
+#include <atomic>
+#include <span>
+
+// Spheres of one chunk, either copied by the writer that changed them or still referring to the
+// spheres the first version was made of
+struct SphereChunk
+{
+	std::span<const Sphere> Spheres;
+	std::vector<Sphere> Storage;
+};
+
+// One immutable version of the spheres. The spheres are split into chunks that consecutive
+// versions share, a writer only copies the chunks it changes
+struct SceneSnapshot
+{
+	uint64_t Version = 0;
+	uint32_t Size = 0;
+	std::vector<std::shared_ptr<const SphereChunk>> Chunks;
+
+	inline const Sphere& operator[](uint32_t i) const { return Chunks[i / ChunkSize]->Spheres[i % ChunkSize]; }
+
+	static constexpr uint32_t ChunkSize = 4096;
+};
+
+struct SphereEdit
+{
+	uint32_t Index = 0;
+	Sphere Value;
+};
+
+struct SceneSnapshots;
+
+// Keeps one snapshot alive for as long as it exists, e.g. for a whole frame
+struct SnapshotPin
+{
+	SnapshotPin(SnapshotPin&& other) noexcept;
+	SnapshotPin& operator=(SnapshotPin&&) = delete;
+	SnapshotPin(const SnapshotPin&) = delete;
+	SnapshotPin& operator=(const SnapshotPin&) = delete;
+	~SnapshotPin();
+
+	inline const SceneSnapshot& operator*() const { return *Snapshot; }
+	inline const SceneSnapshot* operator->() const { return Snapshot; }
+
+private:
+	friend struct SceneSnapshots;
+	SnapshotPin(SceneSnapshots* owner, uint32_t slot, const SceneSnapshot* snapshot);
+
+	SceneSnapshots* Owner = nullptr;
+	uint32_t Slot = 0;
+	const SceneSnapshot* Snapshot = nullptr;
+};
+
+// Latest version of the spheres, edited from any thread without blocking the readers. Readers
+// announce the epoch they start in and then read the published version; writers publish with a
+// compare and swap and retire the version they replaced at the current epoch. A retired version
+// is freed once every reader that announced an epoch up to its retirement has let go of it.
+// The number of spheres and the set of lights are fixed, edits only change spheres in place
+struct SceneSnapshots
+{
+	// The first version copies the spheres, or with reference only points to them, e.g. in a
+	// mapped scene file that stays valid until the snapshots are destroyed. Edits may refer to
+	// materials below materialCount
+	SceneSnapshots(std::span<const Sphere> spheres, bool reference, uint32_t materialCount);
+	~SceneSnapshots();
+	SceneSnapshots(const SceneSnapshots&) = delete;
+	SceneSnapshots& operator=(const SceneSnapshots&) = delete;
+
+	// Lock-free as long as fewer than MaxReaders pins are held at the same time
+	SnapshotPin Pin();
+	// Builds a version from the latest one with the edits applied and publishes it. Concurrent
+	// writers do not wait for each other, whoever loses the race applies its edits again on top
+	// of the winner. Returns the published version, or 0 without publishing anything if an edit
+	// is out of range, refers to a material or type that does not exist or turns a sphere into a
+	// light or a light into a sphere that does not emit
+	uint64_t Publish(std::span<const SphereEdit> edits);
+	// Frees the retired versions no reader can still see, the render thread calls it every frame
+	void Reclaim();
+
+	inline uint32_t Size() const { return SphereCount; }
+
+	static constexpr uint32_t MaxReaders = 64;
+
+private:
+	friend struct SnapshotPin;
+
+	struct RetiredSnapshot
+	{
+		const SceneSnapshot* Snapshot = nullptr;
+		uint64_t Epoch = 0;
+		RetiredSnapshot* Next = nullptr;
+	};
+
+	struct alignas(64) ReaderSlot
+	{
+		std::atomic<uint64_t> Epoch{ IdleEpoch };
+	};
+
+	void Retire(RetiredSnapshot* retired);
+	// Empty if the edit is valid, otherwise why it is not
+	std::string Validate(const SceneSnapshot& current, const SphereEdit& edit) const;
+
+	static constexpr uint64_t IdleEpoch = ~0ull;
+
+private:
+	const uint32_t SphereCount;
+	const uint32_t MaterialCount;
+	std::atomic<const SceneSnapshot*> Head{ nullptr };
+	std::atomic<uint64_t> GlobalEpoch{ 0 };
+	std::array<ReaderSlot, MaxReaders> Readers;
+	std::atomic<RetiredSnapshot*> Retired{ nullptr };
+};
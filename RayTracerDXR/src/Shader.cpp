@@ -4,9 +4,8 @@
 #include <sstream>
 
 
-ID3DBlobPtr compileShader(const WCHAR* filename, const WCHAR* entryPoint)
+ID3DBlobPtr compileShader(const WCHAR* filename, const WCHAR* entryPoint, const WCHAR* targetProfile)
 {
-	const WCHAR* targetProfile = L"lib_6_3";
 	IDxcCompilerPtr compiler;
 	IDxcLibraryPtr library;
 	GRAPHICS_ASSERT(gDxcDllHelper.Initialize());
@@ -54,13 +53,17 @@ ID3DBlobPtr compileShader(const WCHAR* filename, const WCHAR* entryPoint)
 	return blob;
 }
 
-ShaderProgram::ShaderProgram(const std::string& file, const WCHAR* entryPoint)
-	:ExportName(entryPoint)
+static std::wstring getShaderPath(const std::string& file)
 {
 	std::string currentDir = std::string(std::source_location::current().file_name());
 	currentDir = currentDir.substr(0, currentDir.find_last_of("\\/")) + "\\Shaders\\" + file;
+	return string_2_wstring(currentDir);
+}
 
-	auto filename = string_2_wstring(currentDir);
+ShaderProgram::ShaderProgram(const std::string& file, const WCHAR* entryPoint)
+	:ExportName(entryPoint)
+{
+	auto filename = getShaderPath(file);
 	Blob = compileShader(filename.c_str(), entryPoint);
 
 	if (Blob)
@@ -79,6 +82,28 @@ ShaderProgram::ShaderProgram(const std::string& file, const WCHAR* entryPoint)
 	Subobject.pDesc = &LibDesc;
 }
 
+ComputeProgram::ComputeProgram(ID3D12Device5Ptr device, const std::string& file, const WCHAR* entryPoint,
+							   ID3D12RootSignaturePtr rootSignature)
+{
+	auto filename = getShaderPath(file);
+	Blob = compileShader(filename.c_str(), entryPoint, L"cs_6_0");
+
+	D3D12_COMPUTE_PIPELINE_STATE_DESC desc{};
+	desc.pRootSignature = rootSignature;
+	desc.CS.pShaderBytecode = Blob->GetBufferPointer();
+	desc.CS.BytecodeLength = Blob->GetBufferSize();
+	GRAPHICS_ASSERT(device->CreateComputePipelineState(&desc, IID_PPV_ARGS(&PipelineState)));
+}
+
+void ComputeProgram::Dispatch(ID3D12GraphicsCommandList4Ptr cmdList, const PostProcessConstants& constants,
+							  uint32_t width, uint32_t height) const
+{
+	cmdList->SetPipelineState(PipelineState);
+	cmdList->SetComputeRoot32BitConstants(PassConstants, sizeof(constants) / sizeof(UINT), &constants, 0);
+	cmdList->Dispatch(align_to(width, PostProcessGroupSize) / PostProcessGroupSize,
+					  align_to(height, PostProcessGroupSize) / PostProcessGroupSize, 1);
+}
+
 HitGroup::HitGroup(LPCWSTR intersectionEntryPoint, LPCWSTR ahsEntryPoint, LPCWSTR chsEntryPoint, const std::wstring& name)
 	:Name(name)
 {
@@ -192,7 +217,7 @@ void GlobalBindings::Setup(ID3D12Device5Ptr device)
 {
 	SRVHeap = D3D::CreateDescriptorHeap(device, NumGlobalSRVDescriptorRanges + 1,
 										D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, true);
-	UAVHeap = D3D::CreateDescriptorHeap(device, 2, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, true);
+	UAVHeap = D3D::CreateDescriptorHeap(device, NumUAVDescriptors, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, true);
 	CBVHeap = D3D::CreateDescriptorHeap(device, 1, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, true);
 
 	//Create constant buffer for temp data
@@ -218,7 +243,7 @@ void GlobalBindings::Setup(ID3D12Device5Ptr device)
 
 ID3D12RootSignaturePtr GlobalBindings::InitializeImpl(ID3D12Device5Ptr device)
 {
-	std::array<D3D12_DESCRIPTOR_RANGE, 1> uavRanges = {};
+	std::array<D3D12_DESCRIPTOR_RANGE, NumGlobalUAVDescriptorRanges> uavRanges = {};
 	std::array<D3D12_DESCRIPTOR_RANGE, NumGlobalSRVDescriptorRanges> srvRanges = {};
 	std::array<D3D12_DESCRIPTOR_RANGE, 1> cbvRanges = {};
 
@@ -227,6 +252,17 @@ ID3D12RootSignaturePtr GlobalBindings::InitializeImpl(ID3D12Device5Ptr device)
 	uavRanges[0].RegisterSpace = 0;
 	uavRanges[0].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_UAV;
 
+	// Bindless UAV arrays, one register space per resource type
+	for (uint32_t i = 1; i < NumGlobalUAVDescriptorRanges; ++i)
+	{
+		auto& descElement = uavRanges[i];
+		descElement.RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_UAV;
+		descElement.NumDescriptors = UINT_MAX;
+		descElement.BaseShaderRegister = 0;
+		descElement.RegisterSpace = (i - 1) + 100;
+		descElement.OffsetInDescriptorsFromTableStart = 0;
+	}
+
 	uint32_t userStart = NumGlobalSRVDescriptorRanges - NumUserDescriptorRanges;
 	for (uint32_t i = 0; i < NumGlobalSRVDescriptorRanges; ++i)
 	{
@@ -240,7 +276,7 @@ ID3D12RootSignaturePtr GlobalBindings::InitializeImpl(ID3D12Device5Ptr device)
 			descElement.RegisterSpace = (i - userStart) + 100;
 	}
 
-	std::array<D3D12_ROOT_PARAMETER, 4> rootParams;
+	std::array<D3D12_ROOT_PARAMETER, 5> rootParams;
 
 	rootParams[StandardDescriptors].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
 	rootParams[StandardDescriptors].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
@@ -263,6 +299,13 @@ ID3D12RootSignaturePtr GlobalBindings::InitializeImpl(ID3D12Device5Ptr device)
 	rootParams[CBuffer].Descriptor.ShaderRegister = 0;
 	rootParams[CBuffer].Descriptor.RegisterSpace = 0;
 
+	// Per-pass constants of the compute passes, unused by the ray tracing shaders
+	rootParams[PassConstants].ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
+	rootParams[PassConstants].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+	rootParams[PassConstants].Constants.ShaderRegister = 1;
+	rootParams[PassConstants].Constants.RegisterSpace = 0;
+	rootParams[PassConstants].Constants.Num32BitValues = sizeof(PostProcessConstants) / sizeof(UINT);
+
 	D3D12_ROOT_SIGNATURE_DESC desc{};
 	desc.NumParameters = static_cast<UINT>(rootParams.size());
 	desc.pParameters = rootParams.data();
@@ -12,7 +12,7 @@ MAKE_SMART_COM_PTR(IDxcLibrary);
 MAKE_SMART_COM_PTR(IDxcBlobEncoding);
 MAKE_SMART_COM_PTR(IDxcOperationResult);
 
-ID3DBlobPtr compileShader(const WCHAR* filename, const WCHAR* entryPoint);
+ID3DBlobPtr compileShader(const WCHAR* filename, const WCHAR* entryPoint, const WCHAR* targetProfile = L"lib_6_3");
 
 struct ShaderProgram
 {
@@ -25,6 +25,22 @@ struct ShaderProgram
 	ID3DBlobPtr Blob;
 };
 
+// Compute shader with its own pipeline state, sharing the global root signature with the ray
+// tracing pipeline so that all bindless resources stay visible
+struct ComputeProgram
+{
+	ComputeProgram() = default;
+	ComputeProgram(ID3D12Device5Ptr device, const std::string& file, const WCHAR* entryPoint,
+				   ID3D12RootSignaturePtr rootSignature);
+
+	// Expects the global bindings to be bound, covers width x height threads
+	void Dispatch(ID3D12GraphicsCommandList4Ptr cmdList, const PostProcessConstants& constants,
+				  uint32_t width, uint32_t height) const;
+
+	ID3DBlobPtr Blob;
+	ID3D12PipelineStatePtr PipelineState;
+};
+
 struct HitGroup
 {
 	HitGroup(LPCWSTR intersectionEntryPoint, LPCWSTR ahsEntryPoint,
@@ -94,6 +110,7 @@ enum GlobalRootParams : uint32_t
 	SceneDescriptor,
 	UAVDescriptor,
 	CBuffer,
+	PassConstants,
 	LightCBuffer,
 	AppSettings,
 
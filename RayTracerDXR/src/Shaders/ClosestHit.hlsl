@@ -12,7 +12,17 @@ static const float4x4 matr =
 [shader("closesthit")]
 void chs(inout Payload payload, in IntersectionAttributes attribs)
 {
-    if (payload.recursions >= maxTraceRecursionDepth)
+    writePrimaryAOVs(payload, gSpheres[attribs.instanceID].Albedo, getHitInfo(attribs).Normal, attribs.hitT,
+                     attribs.instanceID);
+    writePrimaryHitCache(payload, attribs.hitT, attribs.instanceID);
+
+    if (gSpheres[attribs.instanceID].Type == MaterialType::Emissive)
+    {
+        emit(attribs, payload);
+        return;
+    }
+
+    if (payload.recursions >= RayTraceCB.MaxDepth)
         return;
     
     RayDesc scatterRay;
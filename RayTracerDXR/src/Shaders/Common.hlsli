@@ -10,23 +10,59 @@
 Texture2D<float3> globalRandomNumbers[] : register(t0, space0);
 StructuredBuffer<SphereInfo> globalSpheres[] : register(t0, space100);
 StructuredBuffer<Material> globalMaterials[] : register(t0, space101);
+StructuredBuffer<LightInfo> globalLights[] : register(t0, space102);
+StructuredBuffer<LightBVHNode> globalLightNodes[] : register(t0, space103);
 RaytracingAccelerationStructure gRtScene : register(t0, space200);
 
 RWTexture2D<float4> gOutput : register(u0);
+RWBuffer<uint> globalUintBuffers[] : register(u0, space100);
+RWBuffer<float4> globalFloat4Buffers[] : register(u0, space101);
+RWTexture2D<float4> globalFloat4Textures[] : register(u0, space102);
+RWTexture2D<float> globalFloatTextures[] : register(u0, space103);
+RWTexture2D<uint> globalUintTextures[] : register(u0, space104);
 
 ConstantBuffer<RayTracingConstants> RayTraceCB : register(b0);
 
-static const uint RaysPerPixel = 32;
-
 static StructuredBuffer<SphereInfo> gSpheres = globalSpheres[RayTraceCB.SpheresOfsset];
 static Texture2D<float3> gRandomNumbers = globalRandomNumbers[RayTraceCB.TexturesOffset + RayTraceCB.RandomNumbersIndex];
 static StructuredBuffer<Material> gMaterials = globalMaterials[RayTraceCB.MaterialsOffset];
+static StructuredBuffer<LightInfo> gLights = globalLights[RayTraceCB.LightsOffset];
+static StructuredBuffer<LightBVHNode> gLightNodes = globalLightNodes[RayTraceCB.LightNodesOffset];
+
+static RWTexture2D<float4> gRadiance = globalFloat4Textures[RayTraceCB.RadianceIndex];
+static RWTexture2D<float4> gAlbedo = globalFloat4Textures[RayTraceCB.AlbedoIndex];
+static RWTexture2D<float4> gNormal = globalFloat4Textures[RayTraceCB.NormalIndex];
+static RWTexture2D<float> gDepth = globalFloatTextures[RayTraceCB.DepthIndex];
+static RWTexture2D<uint> gInstanceIDs = globalUintTextures[RayTraceCB.InstanceIDIndex];
+static RWTexture2D<uint> gBounceCounts = globalUintTextures[RayTraceCB.BounceCountIndex];
+static RWBuffer<uint> gTileErrors = globalUintBuffers[RayTraceCB.TileErrorsIndex];
+static RWBuffer<uint> gPrimaryHitCache = globalUintBuffers[RayTraceCB.PrimaryHitCacheIndex];
+
+// Set when the last bounce already sampled the lights directly, so emission found by the
+// scattered ray must not be counted a second time
+static const uint PAYLOAD_FLAG_DIRECT_LIGHT_SAMPLED = 0x1;
+// Set by the ray generation shader when the primary hit of the sample is missing in the cache
+static const uint PAYLOAD_FLAG_CACHE_PRIMARY_HIT = 0x2;
 
 struct Payload
 {
     float3 color;
     uint recursions;
     uint AAIndex;
+    float3 radiance;
+    uint flags;
+};
+
+struct ShadowPayload
+{
+    uint occluded;
+};
+
+// Primary visibility only, for the full resolution guides of the upsampler
+struct GuidePayload
+{
+    float hitT;
+    uint instanceID;
 };
 
 struct IntersectionAttributes
@@ -49,26 +85,85 @@ void rayDesc_Initialize(inout RayDesc rayDesc)
     rayDesc.TMax = TMAX;
 }
 
-float3 linearToSrgb(float3 c)
+float3 skyColorCalc(float3 rayOrigin, float3 rayDirection)
+{
+    float weight = 0.5f * (rayDirection.y + 1.0f);
+    return (1.0f - weight) * RayTraceCB.SkyHorizon + weight * RayTraceCB.SkyZenith;
+}
+
+// Pixel of the current launch, tiled dispatches run one tile per depth slice
+uint2 launchPixel()
+{
+    uint3 launchIdx = DispatchRaysIndex();
+    if (RayTraceCB.TileCount == 0)
+        return launchIdx.xy;
+
+    uint origin = RayTraceCB.TileOrigins[launchIdx.z / 4][launchIdx.z % 4];
+    return launchIdx.xy + uint2(origin & 0xFFFF, origin >> 16);
+}
+
+// Primary hit AOVs, also the denoiser guides, are taken from the first sample of a pixel. The
+// coarse progressive levels skip them, their launch index is not a pixel
+void writePrimaryAOVs(in Payload payload, in float3 albedo, in float3 normal, in float depth, in uint instanceID)
 {
-    float3 sq1 = sqrt(c);
-    float3 sq2 = sqrt(sq1);
-    float3 sq3 = sqrt(sq2);
-    float3 srgb = 0.662002687 * sq1 + 0.684122060 * sq2 - 0.323583601 * sq3 - 0.0225411470 * c;
-    return srgb;
+    if (payload.recursions != 1 || payload.AAIndex != 0 || RayTraceCB.ProgressiveStride > 1)
+        return;
+
+    uint2 launchIdx = launchPixel();
+    uint mask = RayTraceCB.AOVMask;
+    if (mask & AOVFlags::AOVAlbedo)
+        gAlbedo[launchIdx] = float4(albedo, 1.0f);
+    if (mask & AOVFlags::AOVNormal)
+        gNormal[launchIdx] = float4(normal, 0.0f);
+    if (mask & AOVFlags::AOVDepth)
+        gDepth[launchIdx] = depth;
+    if (mask & AOVFlags::AOVInstanceID)
+        gInstanceIDs[launchIdx] = instanceID;
 }
 
-float2 rand(float2 uv)
+// Three words per entry: hit distance, instance ID or ~0 for the sky, and the cache stamp
+uint primaryHitCacheEntry(in uint2 pixel, in uint sample)
 {
-    float noiseX = (frac(sin(dot(uv, float2(12.9898, 78.233) * 2.0)) * 43758.5453));
-    float noiseY = sqrt(1 - noiseX * noiseX);
-    return float2(noiseX, noiseY);
+    uint2 dims = RayTraceCB.RenderSize;
+    return 3 * ((sample * dims.y + pixel.y) * dims.x + pixel.x);
+}
+
+void writePrimaryHitCache(in Payload payload, in float hitT, in uint instanceID)
+{
+    if (payload.recursions != 1 || !(payload.flags & PAYLOAD_FLAG_CACHE_PRIMARY_HIT))
+        return;
+
+    uint entry = primaryHitCacheEntry(launchPixel(), payload.AAIndex);
+    gPrimaryHitCache[entry] = asuint(hitT);
+    gPrimaryHitCache[entry + 1] = instanceID;
+    gPrimaryHitCache[entry + 2] = RayTraceCB.PrimaryHitCacheStamp;
+}
+
+float luminance(float3 c)
+{
+    return dot(c, float3(0.2126f, 0.7152f, 0.0722f));
+}
+
+// Pixel that saw world position p in the previous frame, following the NDC convention of
+// GenerateRayDirection
+bool reprojectToPreviousFrame(in float3 p, out int2 previousPixel)
+{
+    previousPixel = int2(-1, -1);
+    float4 clip = mul(float4(p, 1.0f), RayTraceCB.PreviousViewProjection);
+    if (clip.w <= 0.0f)
+        return false;
+
+    float2 ndc = clip.xy / clip.w;
+    float2 uv = float2(0.5f * ndc.x + 0.5f, 0.5f - 0.5f * ndc.y);
+    int2 dims = int2(RayTraceCB.RenderSize);
+    previousPixel = int2(floor(uv * dims));
+    return all(previousPixel >= 0) && all(previousPixel < dims);
 }
 
 float3 getRandInUnitSphere(in Payload payload)
 {
-    uint2 launchIdx = DispatchRaysIndex().xy;
-    uint2 launchDim = DispatchRaysDimensions().xy;
+    uint2 launchIdx = launchPixel();
+    uint2 launchDim = RayTraceCB.RenderSize;
     uint index = payload.AAIndex;
     
     uint2 coords = launchIdx;
@@ -81,6 +176,30 @@ float3 getRandInUnitSphere(in Payload payload)
     return normalize(randomPoint);
 }
 
+uint pcgHash(uint v)
+{
+    uint state = v * 747796405u + 2891336453u;
+    uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+// Stateless per-vertex seed: pixel, sample, bounce and frame all feed the hash
+uint initRandomSeed(in Payload payload)
+{
+    uint2 launchIdx = launchPixel();
+    uint seed = pcgHash(RayTraceCB.FrameIndex);
+    seed = pcgHash(seed + payload.recursions);
+    seed = pcgHash(seed + payload.AAIndex);
+    seed = pcgHash(seed + launchIdx.y);
+    return pcgHash(seed + launchIdx.x);
+}
+
+float randomFloat(inout uint seed)
+{
+    seed = pcgHash(seed);
+    return float(seed >> 8) * (1.0f / 16777216.0f);
+}
+
 float3 offsetRay(const float3 p, const float3 n)
 {
     return p + n * _intersection_bias;
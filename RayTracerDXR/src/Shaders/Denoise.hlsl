@@ -0,0 +1,71 @@
+#include "PostProcess.hlsli"
+
+// 5x5 B3-spline taps, the kernel is dilated by StepWidth on every iteration
+static const float kernelWeights[3] = { 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f };
+
+static const float colorPhi = 0.8f;
+static const float albedoPhi = 0.1f;
+static const float normalPower = 64.0f;
+static const float depthPhi = 0.05f;
+
+// One iteration of the edge-avoiding a-trous wavelet filter (Dammertz et al. 2010). The color
+// tolerance halves with every iteration, so later, wider passes only smooth what is left of
+// the noise and keep the features that survived the previous ones
+[numthreads(PostProcessGroupSize, PostProcessGroupSize, 1)]
+void denoise(uint3 dispatchThreadID : SV_DispatchThreadID)
+{
+    RWTexture2D<float4> source = globalFloat4Textures[PassCB.SourceIndex];
+    RWTexture2D<float4> destination = globalFloat4Textures[PassCB.DestinationIndex];
+
+    uint2 dims = RayTraceCB.RenderSize;
+    int2 p = int2(dispatchThreadID.xy);
+    if (isOutside(p, dims))
+        return;
+
+    bool demodulateInput = PassCB.Iteration == 0;
+    float3 albedoP = gAlbedo[p].rgb;
+    float3 normalP = gNormal[p].xyz;
+    float depthP = gDepth[p];
+    float3 colorP = source[p].rgb;
+    if (demodulateInput)
+        colorP = demodulate(colorP, albedoP);
+
+    float colorScale = exp2(-float(PassCB.Iteration));
+    float invColorPhi2 = 1.0f / (colorPhi * colorPhi * colorScale * colorScale);
+    float invAlbedoPhi2 = 1.0f / (albedoPhi * albedoPhi);
+    int step = int(PassCB.StepWidth);
+
+    float3 sum = float3(0, 0, 0);
+    float weightSum = 0.0f;
+    for (int dy = -2; dy <= 2; dy++)
+    {
+        for (int dx = -2; dx <= 2; dx++)
+        {
+            int2 q = p + int2(dx, dy) * step;
+            if (isOutside(q, dims))
+                continue;
+
+            float3 albedoQ = gAlbedo[q].rgb;
+            float3 colorQ = source[q].rgb;
+            if (demodulateInput)
+                colorQ = demodulate(colorQ, albedoQ);
+
+            float3 colorDiff = colorP - colorQ;
+            float3 albedoDiff = albedoP - albedoQ;
+            float pixelDistance = length(float2(dx, dy)) * step;
+
+            float weight = kernelWeights[abs(dx)] * kernelWeights[abs(dy)];
+            weight *= exp(-dot(colorDiff, colorDiff) * invColorPhi2);
+            weight *= exp(-dot(albedoDiff, albedoDiff) * invAlbedoPhi2);
+            weight *= pow(saturate(dot(normalP, gNormal[q].xyz)), normalPower);
+            // Depth tolerance grows with distance to the camera and to the center tap
+            weight *= exp(-abs(depthP - gDepth[q]) / (depthPhi * depthP * pixelDistance + 1e-4f));
+
+            sum += colorQ * weight;
+            weightSum += weight;
+        }
+    }
+
+    // The center tap always contributes, weightSum can not be zero
+    destination[p] = float4(sum / weightSum, 1.0f);
+}
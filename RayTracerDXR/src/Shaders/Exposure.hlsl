@@ -0,0 +1,61 @@
+#include "PostProcess.hlsli"
+
+// Middle grey the average scene luminance is mapped to
+static const float exposureKey = 0.18f;
+// Rate of the exponential adaptation towards the target exposure, per second
+static const float exposureAdaptationSpeed = 1.5f;
+// Fraction of the darkest and brightest pixels ignored by the average
+static const float exposureLowPercentile = 0.5f;
+static const float exposureHighPercentile = 0.95f;
+
+groupshared uint binCounts[HistogramBins];
+
+// Single group: averages the log luminance of the histogram between the percentiles, moves the
+// exposure in gExposure[0].x towards the one that maps it to middle grey, and clears the histogram
+// for the next frame
+[numthreads(HistogramBins, 1, 1)]
+void adaptExposure(uint groupIndex : SV_GroupIndex)
+{
+    RWBuffer<uint> histogram = globalUintBuffers[PassCB.HistogramIndex];
+    RWBuffer<float4> exposure = globalFloat4Buffers[PassCB.ExposureIndex];
+
+    binCounts[groupIndex] = histogram[groupIndex];
+    histogram[groupIndex] = 0;
+    GroupMemoryBarrierWithGroupSync();
+
+    if (groupIndex != 0)
+        return;
+
+    uint total = 0;
+    for (uint i = 1; i < HistogramBins; i++)
+        total += binCounts[i];
+
+    float previous = exposure[0].x;
+    if (total == 0)
+    {
+        exposure[0] = float4(previous > 0.0f ? previous : 1.0f, 0, 0, 0);
+        return;
+    }
+
+    float low = exposureLowPercentile * total;
+    float high = exposureHighPercentile * total;
+    float seen = 0.0f;
+    float weightedSum = 0.0f;
+    float weight = 0.0f;
+    for (uint bin = 1; bin < HistogramBins; bin++)
+    {
+        float count = float(binCounts[bin]);
+        // Part of the bin inside the percentile window
+        float inside = max(0.0f, min(seen + count, high) - max(seen, low));
+        weightedSum += inside * binToLogLuminance(bin);
+        weight += inside;
+        seen += count;
+    }
+
+    float averageLuminance = exp2(weight > 0.0f ? weightedSum / weight : HistogramMinLogLuminance);
+    float target = exposureKey / averageLuminance;
+    // The first frame, or a frame after a reset, starts at the target right away
+    float adapted = previous > 0.0f ?
+        previous + (target - previous) * (1.0f - exp(-PassCB.DeltaTime * exposureAdaptationSpeed)) : target;
+    exposure[0] = float4(adapted, averageLuminance, 0, 0);
+}
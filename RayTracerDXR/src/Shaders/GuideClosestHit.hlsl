@@ -0,0 +1,8 @@
+#include "Common.hlsli"
+
+[shader("closesthit")]
+void guideChs(inout GuidePayload payload, in IntersectionAttributes attribs)
+{
+    payload.hitT = attribs.hitT;
+    payload.instanceID = attribs.instanceID;
+}
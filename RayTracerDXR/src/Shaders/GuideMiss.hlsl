@@ -0,0 +1,7 @@
+#include "Common.hlsli"
+
+// The payload starts out as a miss, nothing to do
+[shader("miss")]
+void guideMiss(inout GuidePayload payload)
+{
+}
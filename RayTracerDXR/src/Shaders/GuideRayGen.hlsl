@@ -0,0 +1,43 @@
+#include "Common.hlsli"
+
+static RWTexture2D<float4> gUpscaleAlbedo = globalFloat4Textures[RayTraceCB.UpscaleGuidesOffset];
+static RWTexture2D<float4> gUpscaleNormalDepth = globalFloat4Textures[RayTraceCB.UpscaleGuidesOffset + 1];
+static RWTexture2D<uint> gUpscaleInstanceIDs = globalUintTextures[RayTraceCB.UpscaleGuidesOffset + 2];
+
+// Cheap full resolution pass: one unjittered primary ray per pixel without any shading, the hit
+// is turned into albedo, normal and depth here
+[shader("raygeneration")]
+void guideRayGen()
+{
+    uint2 launchIndex = DispatchRaysIndex().xy;
+    float2 launchDim = float2(DispatchRaysDimensions().xy);
+
+    float2 ndc = ((float2(launchIndex) + 0.5f) / launchDim) * 2.0f - 1.0f;
+    ndc.y *= -1.0f;
+    float4 far = mul(float4(ndc, 1.0f, 1.0f), RayTraceCB.ViewProjectionInv);
+    float4 near = mul(float4(ndc, 0.0f, 1.0f), RayTraceCB.ViewProjectionInv);
+
+    RayDesc ray;
+    rayDesc_Initialize(ray);
+    ray.Origin = RayTraceCB.CameraPosition;
+    ray.Direction = normalize(far.xyz / far.w - near.xyz / near.w);
+
+    GuidePayload payload;
+    payload.hitT = TMAX;
+    payload.instanceID = 0xFFFFFFFF;
+    TraceRay(gRtScene, RAY_FLAG_NONE, 0xFF, 1, 0, 2, ray, payload);
+
+    if (payload.instanceID == 0xFFFFFFFF)
+    {
+        gUpscaleAlbedo[launchIndex] = float4(skyColorCalc(ray.Origin, ray.Direction), 1.0f);
+        gUpscaleNormalDepth[launchIndex] = float4(-ray.Direction, TMAX);
+    }
+    else
+    {
+        SphereInfo sphere = gSpheres[payload.instanceID];
+        float3 p = ray.Origin + payload.hitT * ray.Direction;
+        gUpscaleAlbedo[launchIndex] = float4(sphere.Albedo, 1.0f);
+        gUpscaleNormalDepth[launchIndex] = float4(normalize(p - sphere.Center), payload.hitT);
+    }
+    gUpscaleInstanceIDs[launchIndex] = payload.instanceID;
+}
@@ -21,22 +21,88 @@ using namespace glm;
 #endif
 
 static const UINT maxTraceRecursionDepth = 5;
+static const UINT PostProcessGroupSize = 8;
+// Tiles of a progressive pass traced in one dispatch, their origins are packed four per vector
+static const UINT MaxTilesPerFrame = 64;
+// One bin per thread of a post-processing group, bin 0 holds the black pixels
+static const UINT HistogramBins = PostProcessGroupSize * PostProcessGroupSize;
+static const float HistogramMinLogLuminance = -10.0f;
+static const float HistogramLogLuminanceRange = 16.0f;
+// Entries of the inverse CDF of the pixel filter, packed two (offset, sign) pairs per vector
+static const UINT PixelFilterTableSize = 128;
 
 enum MaterialType
 {
     Diffuse = 0,
 	Metal,
 	Dielectric,
+	Emissive,
 	Count
 };
 
+enum LightSamplingMode
+{
+	UniformLightSampling = 0,
+	PowerLightSampling,
+	BVHLightSampling,
+	LightSamplingModeCount
+};
+
+enum RestirFlags
+{
+	RestirEnabled = 0x1,
+	RestirTemporalReuse = 0x2,
+	RestirSpatialReuse = 0x4,
+	RestirHistoryValid = 0x8
+};
+
+enum PostProcessFlags
+{
+	PostProcessRemodulate = 0x1,
+	PostProcessHistoryValid = 0x2,
+	PostProcessAutoExposure = 0x4
+};
+
+// Temporal history textures, each kind is double buffered and indexed by frame parity
+enum HistoryTexture
+{
+	HistoryColor = 0,
+	HistorySurface,
+	HistoryInstanceID,
+	HistoryTextureCount
+};
+
+// Auxiliary outputs of the tracer, each one has its own texture that is only created and
+// written when its bit is set in RayTracingConstants::AOVMask
+enum AOVFlags
+{
+	AOVAlbedo = 0x1,
+	AOVNormal = 0x2,
+	AOVDepth = 0x4,
+	AOVInstanceID = 0x8,
+	AOVBounceCount = 0x10,
+	AOVCount = 5
+};
+
+enum AOVView
+{
+	AOVViewNone = 0,
+	AOVViewAlbedo,
+	AOVViewNormal,
+	AOVViewDepth,
+	AOVViewInstanceID,
+	AOVViewBounceCount,
+	AOVViewCount
+};
+
 struct SphereInfo
 {
 	vec3 Center;
 	float Radius;
 	vec3 Albedo;
-	//float Roughness;
 	MaterialType Type;
+	// Entry of the materials buffer with the parameters of the sphere
+	UINT MaterialIndex;
 };
 
 struct Material
@@ -45,6 +111,31 @@ struct Material
 	float Eta;
 };
 
+// Emissive sphere entry; Probability/Alias form the Walker alias table over emitted power
+struct LightInfo
+{
+	UINT SphereIndex;
+	float Pdf;
+	float Probability;
+	UINT Alias;
+};
+
+// Depth-first light BVH node with one light per leaf. Interior nodes keep their left child
+// right after themselves, Offset is the right child for interior nodes and the light index
+// for leaves
+struct LightBVHNode
+{
+	vec3 BoundsMin;
+	float Power;
+	vec3 BoundsMax;
+	float CosThetaO;
+	vec3 Axis;
+	float CosThetaE;
+	UINT Offset;
+	UINT IsLeaf;
+	UINT Padding[2];
+};
+
 struct RayTracingConstants
 {
 	vec3 CameraPosition;
@@ -55,6 +146,87 @@ struct RayTracingConstants
 	UINT MaterialsOffset;
 
 	UINT RandomNumbersIndex;
+
+	UINT LightsOffset;
+	UINT LightCount;
+	UINT LightSampling;
+	UINT FrameIndex;
+
+	UINT LightNodesOffset;
+	UINT Restir;
+	UINT RestirCandidates;
+	UINT ReservoirsOffset;
+	// Reservoirs carry the stamp they were written with and only ones with the current stamp are
+	// reused, tiles that were not traced since the history was dropped keep older reservoirs
+	UINT RestirStamp;
+
+	ALIGNAS(16) mat4x4 PreviousViewProjection;
+
+	UINT RadianceIndex;
+	UINT AlbedoIndex;
+	UINT NormalIndex;
+	UINT DepthIndex;
+
+	UINT AOVMask;
+	UINT InstanceIDIndex;
+	UINT BounceCountIndex;
+	UINT RaysPerPixel;
+
+	ALIGNAS(16) vec3 PreviousCameraPosition;
+	UINT HistoryOffset;
+
+	// Size of the traced image, a sub-rectangle of all per-pixel resources
+	uvec2 RenderSize;
+	// Full resolution albedo, normal and depth, instance ID of the guide pass, in this order
+	UINT UpscaleGuidesOffset;
+
+	// Block size of the progressive preview, 0 when off
+	UINT ProgressiveStride;
+
+	// Tiled dispatches trace TileCount square tiles, one per depth slice, each starting at the
+	// pixel packed as x | y << 16 into TileOrigins. Tiles with their bit set in TileResets
+	// discard their accumulation, TileErrorsIndex sums the change per tile
+	UINT TileSize;
+	UINT TileCount;
+	uvec2 TileResets;
+	UINT TileErrorsIndex;
+	ALIGNAS(16) uvec4 TileOrigins[MaxTilesPerFrame / 4];
+
+	// Primary hits of the first PrimaryHitCacheSamples samples of each pixel, 0 when off.
+	// Entries are only valid when they carry the current stamp. Jitter seeds the sub-pixel
+	// positions of the cached samples, it advances every few frames
+	UINT PrimaryHitCacheIndex;
+	UINT PrimaryHitCacheSamples;
+	UINT PrimaryHitCacheStamp;
+	UINT PrimaryHitCacheJitter;
+
+	// Sub-pixel offsets are drawn from the reconstruction filter, every sample carries the
+	// weight times the sign of the filter at its offset
+	float PixelFilterWeight;
+	ALIGNAS(16) vec4 PixelFilterTable[PixelFilterTableSize / 2];
+
+	// Sky gradient of the scene and the bounces a path may take, at most maxTraceRecursionDepth
+	ALIGNAS(16) vec3 SkyHorizon;
+	UINT MaxDepth;
+	vec3 SkyZenith;
+	UINT SkyPadding;
+};
+
+// Root constants of a single compute pass, indices address the bindless UAV texture arrays
+struct PostProcessConstants
+{
+	UINT SourceIndex;
+	UINT DestinationIndex;
+	UINT StepWidth;
+	UINT Iteration;
+	UINT Flags;
+	UINT View;
+	// Output stage: exposure compensation in stops, seconds since the last frame for the
+	// adaptation and the luminance histogram and exposure buffers
+	float ExposureBias;
+	float DeltaTime;
+	UINT HistogramIndex;
+	UINT ExposureIndex;
 };
 
 #endif // HLSLCOMPAT_H
@@ -0,0 +1,25 @@
+#include "PostProcess.hlsli"
+
+groupshared uint localBins[HistogramBins];
+
+// Log luminance histogram of the resolved frame for the auto-exposure. Every group bins its pixels
+// in shared memory first, so the global buffer only sees one atomic per bin and group
+[numthreads(PostProcessGroupSize, PostProcessGroupSize, 1)]
+void luminanceHistogram(uint3 dispatchThreadID : SV_DispatchThreadID, uint groupIndex : SV_GroupIndex)
+{
+    RWTexture2D<float4> source = globalFloat4Textures[PassCB.SourceIndex];
+    RWBuffer<uint> histogram = globalUintBuffers[PassCB.HistogramIndex];
+
+    localBins[groupIndex] = 0;
+    GroupMemoryBarrierWithGroupSync();
+
+    uint2 dims;
+    source.GetDimensions(dims.x, dims.y);
+    int2 p = int2(dispatchThreadID.xy);
+    if (!isOutside(p, dims))
+        InterlockedAdd(localBins[luminanceToBin(luminance(source[p].rgb))], 1);
+    GroupMemoryBarrierWithGroupSync();
+
+    if (localBins[groupIndex] != 0)
+        InterlockedAdd(histogram[groupIndex], localBins[groupIndex]);
+}
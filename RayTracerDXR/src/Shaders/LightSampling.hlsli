@@ -0,0 +1,221 @@
+#ifndef LIGHTSAMPLING_HLSLI
+#define LIGHTSAMPLING_HLSLI
+
+#include "Common.hlsli"
+
+#define PI 3.14159265f
+
+struct LightSample
+{
+    uint sphereIndex;
+    float pdf;
+};
+
+#define LIGHT_BVH_MAX_DEPTH 64
+
+float cosSubClamped(float sinA, float cosA, float sinB, float cosB)
+{
+    // cos(max(0, a - b))
+    return cosA > cosB ? 1.0f : cosA * cosB + sinA * sinB;
+}
+
+float sinSubClamped(float sinA, float cosA, float sinB, float cosB)
+{
+    // sin(max(0, a - b))
+    return cosA > cosB ? 0.0f : sinA * cosB - cosA * sinB;
+}
+
+// Conservative estimate of the light a node can deliver to p with normal n: power over squared
+// distance, attenuated by the smallest possible angles to the emission cone and to the normal
+float lightNodeImportance(in LightBVHNode node, in float3 p, in float3 n)
+{
+    float3 center = 0.5f * (node.BoundsMin + node.BoundsMax);
+    float3 toPoint = p - center;
+    float radius = 0.5f * length(node.BoundsMax - node.BoundsMin);
+    float distance2 = dot(toPoint, toPoint);
+    // Only the falloff uses the clamped distance, the angles take the true direction. At the
+    // center any direction does, the bounding sphere then covers all of them
+    float d2 = max(distance2, radius);
+    float3 direction = distance2 > 0.0f ? toPoint * rsqrt(distance2) : node.Axis;
+
+    // Angle subtended by the bounding sphere of the node
+    float cosThetaB = -1.0f;
+    if (distance2 > radius * radius)
+        cosThetaB = sqrt(max(0.0f, 1.0f - radius * radius / distance2));
+    float sinThetaB = sqrt(max(0.0f, 1.0f - cosThetaB * cosThetaB));
+
+    float cosThetaW = dot(direction, node.Axis);
+    float sinThetaW = sqrt(max(0.0f, 1.0f - cosThetaW * cosThetaW));
+    float sinThetaO = sqrt(max(0.0f, 1.0f - node.CosThetaO * node.CosThetaO));
+
+    float cosThetaX = cosSubClamped(sinThetaW, cosThetaW, sinThetaO, node.CosThetaO);
+    float sinThetaX = sinSubClamped(sinThetaW, cosThetaW, sinThetaO, node.CosThetaO);
+    float cosThetaP = cosSubClamped(sinThetaX, cosThetaX, sinThetaB, cosThetaB);
+    if (cosThetaP <= node.CosThetaE)
+        return 0.0f;
+
+    float cosThetaI = dot(-direction, n);
+    float sinThetaI = sqrt(max(0.0f, 1.0f - cosThetaI * cosThetaI));
+    float cosThetaPI = cosSubClamped(sinThetaI, cosThetaI, sinThetaB, cosThetaB);
+
+    return max(0.0f, node.Power * cosThetaP * cosThetaPI / d2);
+}
+
+// Stochastic descent through the light BVH, the selection pdf is the product of the branch
+// probabilities along the path
+LightSample sampleLightBVH(in float3 p, in float3 n, inout uint seed)
+{
+    LightSample output;
+    output.sphereIndex = 0;
+    output.pdf = 0.0f;
+
+    uint nodeIndex = 0;
+    float pmf = 1.0f;
+    for (uint depth = 0; depth < LIGHT_BVH_MAX_DEPTH; depth++)
+    {
+        LightBVHNode node = gLightNodes[nodeIndex];
+        if (node.IsLeaf)
+        {
+            if (node.Power > 0.0f)
+            {
+                output.sphereIndex = gLights[node.Offset].SphereIndex;
+                output.pdf = pmf;
+            }
+            return output;
+        }
+
+        float leftImportance = lightNodeImportance(gLightNodes[nodeIndex + 1], p, n);
+        float rightImportance = lightNodeImportance(gLightNodes[node.Offset], p, n);
+        if (leftImportance <= 0.0f && rightImportance <= 0.0f)
+            return output;
+
+        float leftProbability = leftImportance / (leftImportance + rightImportance);
+        if (randomFloat(seed) < leftProbability)
+        {
+            nodeIndex = nodeIndex + 1;
+            pmf *= leftProbability;
+        }
+        else
+        {
+            nodeIndex = node.Offset;
+            pmf *= 1.0f - leftProbability;
+        }
+    }
+
+    return output;
+}
+
+// Picks one emissive sphere for the shading point p with normal n. PowerLightSampling does a
+// single Walker alias lookup, the fractional part of the scaled random number doubles as the
+// alias coin flip
+LightSample sampleLight(in float3 p, in float3 n, inout uint seed)
+{
+    if (RayTraceCB.LightSampling == LightSamplingMode::BVHLightSampling)
+        return sampleLightBVH(p, n, seed);
+
+    uint count = RayTraceCB.LightCount;
+    float u = randomFloat(seed) * count;
+    uint index = min(uint(u), count - 1);
+
+    LightSample output;
+    if (RayTraceCB.LightSampling == LightSamplingMode::PowerLightSampling)
+    {
+        LightInfo entry = gLights[index];
+        if (u - index >= entry.Probability)
+            index = entry.Alias;
+        output.pdf = gLights[index].Pdf;
+    }
+    else
+    {
+        output.pdf = 1.0f / count;
+    }
+
+    output.sphereIndex = gLights[index].SphereIndex;
+    return output;
+}
+
+void buildOrthonormalBasis(in float3 n, out float3 t, out float3 b)
+{
+    float s = n.z >= 0.0f ? 1.0f : -1.0f;
+    float a = -1.0f / (s + n.z);
+    float c = n.x * n.y * a;
+    t = float3(1.0f + s * n.x * n.x * a, s * c, -s * n.x);
+    b = float3(c, s + n.y * n.y * a, -n.y);
+}
+
+// Uniform sampling of the cone subtended by the sphere as seen from p
+bool sampleSphereLight(in SphereInfo light, in float3 p, inout uint seed,
+                       out float3 direction, out float distance, out float pdf)
+{
+    direction = float3(0, 0, 0);
+    distance = 0.0f;
+    pdf = 0.0f;
+
+    float3 toCenter = light.Center - p;
+    float d2 = dot(toCenter, toCenter);
+    float r2 = light.Radius * light.Radius;
+    if (d2 <= r2)
+        return false;
+
+    float d = sqrt(d2);
+    float3 w = toCenter / d;
+    float sinThetaMax2 = r2 / d2;
+    float cosThetaMax = sqrt(max(0.0f, 1.0f - sinThetaMax2));
+    // Small, distant lights lose all precision in 1 - cosThetaMax
+    float oneMinusCosThetaMax = sinThetaMax2 < 1e-4f ? 0.5f * sinThetaMax2 : 1.0f - cosThetaMax;
+
+    float cosTheta = 1.0f - randomFloat(seed) * oneMinusCosThetaMax;
+    float sinTheta = sqrt(max(0.0f, 1.0f - cosTheta * cosTheta));
+    float phi = 2.0f * PI * randomFloat(seed);
+
+    float3 t, b;
+    buildOrthonormalBasis(w, t, b);
+    direction = normalize(t * (cos(phi) * sinTheta) + b * (sin(phi) * sinTheta) + w * cosTheta);
+
+    float proj = dot(direction, toCenter);
+    distance = proj - sqrt(max(0.0f, proj * proj - (d2 - r2)));
+    pdf = 1.0f / (2.0f * PI * oneMinusCosThetaMax);
+    return true;
+}
+
+bool isVisible(in float3 origin, in float3 direction, in float distance)
+{
+    RayDesc ray;
+    ray.Origin = origin;
+    ray.Direction = direction;
+    ray.TMin = 0;
+    ray.TMax = distance * 0.999f;
+
+    ShadowPayload shadowPayload;
+    shadowPayload.occluded = 1;
+    TraceRay(gRtScene, RAY_FLAG_ACCEPT_FIRST_HIT_AND_END_SEARCH | RAY_FLAG_SKIP_CLOSEST_HIT_SHADER,
+             0xFF, 0, 0, 1, ray, shadowPayload);
+    return shadowPayload.occluded == 0;
+}
+
+// One-sample next event estimation for a Lambertian surface, returns the reflected radiance
+// before multiplication with the path throughput
+float3 estimateDirectLight(in float3 p, in float3 n, in float3 albedo, inout uint seed)
+{
+    if (RayTraceCB.LightCount == 0)
+        return float3(0, 0, 0);
+
+    LightSample lightSample = sampleLight(p, n, seed);
+    if (lightSample.pdf <= 0.0f)
+        return float3(0, 0, 0);
+
+    SphereInfo light = gSpheres[lightSample.sphereIndex];
+
+    float3 direction;
+    float distance, pdf;
+    if (!sampleSphereLight(light, p, seed, direction, distance, pdf))
+        return float3(0, 0, 0);
+
+    float cosine = dot(n, direction);
+    if (cosine <= 0.0f || !isVisible(p, direction, distance))
+        return float3(0, 0, 0);
+
+    return albedo / PI * light.Albedo * cosine / (lightSample.pdf * pdf);
+}
+
+#endif // LIGHTSAMPLING_HLSLI
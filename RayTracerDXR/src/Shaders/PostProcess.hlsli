@@ -0,0 +1,84 @@
+#ifndef POSTPROCESS_HLSLI
+#define POSTPROCESS_HLSLI
+
+// Compute passes run outside of the ray tracing pipeline and must not pull in Common.hlsli
+#define HLSL
+#include "HLSLCompat.h"
+
+RWTexture2D<float4> gOutput : register(u0);
+RWBuffer<uint> globalUintBuffers[] : register(u0, space100);
+RWBuffer<float4> globalFloat4Buffers[] : register(u0, space101);
+RWTexture2D<float4> globalFloat4Textures[] : register(u0, space102);
+RWTexture2D<float> globalFloatTextures[] : register(u0, space103);
+RWTexture2D<uint> globalUintTextures[] : register(u0, space104);
+
+ConstantBuffer<RayTracingConstants> RayTraceCB : register(b0);
+ConstantBuffer<PostProcessConstants> PassCB : register(b1);
+
+static RWTexture2D<float4> gAlbedo = globalFloat4Textures[RayTraceCB.AlbedoIndex];
+static RWTexture2D<float4> gNormal = globalFloat4Textures[RayTraceCB.NormalIndex];
+static RWTexture2D<float> gDepth = globalFloatTextures[RayTraceCB.DepthIndex];
+static RWTexture2D<uint> gInstanceIDs = globalUintTextures[RayTraceCB.InstanceIDIndex];
+static RWTexture2D<uint> gBounceCounts = globalUintTextures[RayTraceCB.BounceCountIndex];
+
+static RWTexture2D<float4> gUpscaleAlbedo = globalFloat4Textures[RayTraceCB.UpscaleGuidesOffset];
+static RWTexture2D<float4> gUpscaleNormalDepth = globalFloat4Textures[RayTraceCB.UpscaleGuidesOffset + 1];
+static RWTexture2D<uint> gUpscaleInstanceIDs = globalUintTextures[RayTraceCB.UpscaleGuidesOffset + 2];
+
+// Exact piecewise sRGB encoding, one pow per channel is cheaper than the square root fit it
+// replaced and does not drift off near black
+float3 linearToSrgb(float3 c)
+{
+    c = saturate(c);
+    return select(c <= 0.0031308f, 12.92f * c, 1.055f * pow(c, 1.0f / 2.4f) - 0.055f);
+}
+
+float luminance(in float3 c)
+{
+    return dot(c, float3(0.2126f, 0.7152f, 0.0722f));
+}
+
+// Bin 0 collects black pixels, the others split log2 luminance in
+// [HistogramMinLogLuminance, HistogramMinLogLuminance + HistogramLogLuminanceRange] evenly
+uint luminanceToBin(in float l)
+{
+    if (l < 1e-5f)
+        return 0;
+    float t = saturate((log2(l) - HistogramMinLogLuminance) / HistogramLogLuminanceRange);
+    return 1 + min(uint(t * (HistogramBins - 1)), HistogramBins - 2);
+}
+
+float binToLogLuminance(in float bin)
+{
+    return (bin - 0.5f) / (HistogramBins - 1) * HistogramLogLuminanceRange + HistogramMinLogLuminance;
+}
+
+// Filtering works on illumination only so that albedo edges are not blurred, black albedo
+// channels keep their radiance untouched
+float3 demodulate(in float3 c, in float3 albedo)
+{
+    return select(albedo > 0.001f, c / max(albedo, 0.001f), c);
+}
+
+float3 remodulate(in float3 c, in float3 albedo)
+{
+    return select(albedo > 0.001f, c * albedo, c);
+}
+
+// Matches GenerateRayDirection of the ray generation shader for the pixel center
+float3 primaryRayDirection(in int2 p, in uint2 dims)
+{
+    float2 ndc = ((float2(p) + 0.5f) / float2(dims)) * 2.0f - 1.0f;
+    ndc.y *= -1.0f;
+
+    float4 far = mul(float4(ndc, 1.0f, 1.0f), RayTraceCB.ViewProjectionInv);
+    float4 near = mul(float4(ndc, 0.0f, 1.0f), RayTraceCB.ViewProjectionInv);
+    return normalize(far.xyz / far.w - near.xyz / near.w);
+}
+
+bool isOutside(in int2 p, in uint2 dims)
+{
+    return any(p < 0) || any(p >= int2(dims));
+}
+
+#endif // POSTPROCESS_HLSLI
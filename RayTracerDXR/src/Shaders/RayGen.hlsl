@@ -16,21 +16,85 @@ float3 GenerateRayDirection(float2 launchIdx, float2 launchDim, float aspectRati
     return normalize(far.xyz - near.xyz);
 }
 
-float3 TraceRayPerPixel(float2 launchIndex, float2 launchDim)
+// The jitter of a cached sample only changes with its seed, which invalidates the cache, so with an unchanged view the
+// primary hit of a sample is known from the cache. The ray is then clamped to a sliver around
+// the cached distance, which leaves almost nothing to traverse, and shading runs as usual
+void usePrimaryHitCache(in uint2 pixel, in uint sample, inout RayDesc ray, inout Payload payload)
+{
+    if (sample >= RayTraceCB.PrimaryHitCacheSamples || RayTraceCB.ProgressiveStride > 1)
+        return;
+
+    uint entry = primaryHitCacheEntry(pixel, sample);
+    if (gPrimaryHitCache[entry + 2] != RayTraceCB.PrimaryHitCacheStamp)
+    {
+        payload.flags |= PAYLOAD_FLAG_CACHE_PRIMARY_HIT;
+        return;
+    }
+
+    float hitT = asfloat(gPrimaryHitCache[entry]);
+    if (gPrimaryHitCache[entry + 1] == 0xFFFFFFFF)
+    {
+        ray.TMin = TMAX;
+        ray.TMax = TMAX;
+    }
+    else
+    {
+        ray.TMin = hitT * 0.999f;
+        ray.TMax = hitT * 1.001f + 1e-4f;
+    }
+}
+
+float2 pixelFilterEntry(uint i)
+{
+    float4 v = RayTraceCB.PixelFilterTable[i / 2];
+    return (i & 1) ? v.zw : v.xy;
+}
+
+// Offset from the pixel center along one axis, distributed like |filter|. The sign of the filter
+// at the offset is multiplied into weight
+float samplePixelFilter(float u, inout float weight)
+{
+    float x = u * (PixelFilterTableSize - 1);
+    uint i = min(uint(x), PixelFilterTableSize - 2);
+    float2 a = pixelFilterEntry(i);
+    float2 b = pixelFilterEntry(i + 1);
+    weight *= x - i < 0.5f ? a.y : b.y;
+    return lerp(a.x, b.x, x - i);
+}
+
+// Samples with a cached primary hit keep their sub-pixel position for as long as their seed, which
+// the application advances every few frames, the others move with the frame index. Either way
+// accumulation keeps seeing new positions
+uint pixelFilterSeed(uint2 pixel, uint sample)
+{
+    uint seed = pcgHash(pcgHash(pixel.y) + pixel.x);
+    seed = pcgHash(seed + sample);
+    if (sample >= RayTraceCB.PrimaryHitCacheSamples)
+        seed = pcgHash(seed + RayTraceCB.FrameIndex);
+    else
+        seed = pcgHash(seed + RayTraceCB.PrimaryHitCacheJitter);
+    return seed;
+}
+
+float3 TraceRayPerPixel(float2 launchIndex, float2 launchDim, uint samples, out uint bounces)
 {
     float aspectRatio = float(launchDim.x) / float(launchDim.y);
 
     float3 color = float3(0.0f, 0.0f, 0.0f);
-    float2 ndc = launchIndex.xy + float2(0.5f, 0.5f);
-    float2 ndcInLoop = ndc;
+    float2 center = launchIndex.xy + float2(0.5f, 0.5f);
+    bounces = 0;
 
-    for (uint i = 0; i < RaysPerPixel; i++)
+    for (uint i = 0; i < samples; i++)
     {
-        ndcInLoop = ndc + (rand(frac(ndcInLoop)) * 2.0f - 1.0f);
+        uint seed = pixelFilterSeed(uint2(launchIndex), i);
+        float weight = RayTraceCB.PixelFilterWeight;
+        float2 offset;
+        offset.x = samplePixelFilter(randomFloat(seed), weight);
+        offset.y = samplePixelFilter(randomFloat(seed), weight);
 
         RayDesc ray;
         ray.Origin = RayTraceCB.CameraPosition;
-        ray.Direction = GenerateRayDirection(ndcInLoop, launchDim, aspectRatio);
+        ray.Direction = GenerateRayDirection(center + offset, launchDim, aspectRatio);
         ray.TMin = 0;
         ray.TMax = TMAX;
         
@@ -38,20 +102,67 @@ float3 TraceRayPerPixel(float2 launchIndex, float2 launchDim)
         payload.color = float3(1, 1, 1);
         payload.recursions = 1;
         payload.AAIndex = i;
+        payload.radiance = float3(0, 0, 0);
+        payload.flags = 0;
+        usePrimaryHitCache(uint2(launchIndex), i, ray, payload);
         TraceRay(gRtScene, 0, 0xFF, 0, 0, 0, ray, payload);
-        color += payload.color;
+        color += weight * (payload.color + payload.radiance);
+        bounces += payload.recursions - 1;
     }
 
-    return color / float(RaysPerPixel);
+    return color / float(samples);
 }
 
 [shader("raygeneration")]
 void rayGen()
 {
-    uint3 launchIndex = DispatchRaysIndex();
-    uint3 launchDim = DispatchRaysDimensions();
+    uint2 launchIndex = DispatchRaysIndex().xy;
+    uint2 dims = RayTraceCB.RenderSize;
+
+    // Coarse progressive levels trace one sample at the center of a stride x stride block
+    uint stride = max(RayTraceCB.ProgressiveStride, 1);
+    uint2 blockOrigin = stride > 1 ? launchIndex * stride : launchPixel();
+    if (any(blockOrigin >= dims))
+        return;
 
-    float3 col = linearToSrgb(TraceRayPerPixel(launchIndex.xy, launchDim.xy));
-    gOutput[launchIndex.xy] = float4(col, 1.0f);
+    uint2 pixel = min(blockOrigin + stride / 2, dims - 1);
+    uint samples = stride > 1 ? 1 : RayTraceCB.RaysPerPixel;
 
-}
\ No newline at end of file
+    // Linear radiance, denoising and conversion to sRGB happen in the compute passes
+    uint bounces;
+    float3 color = TraceRayPerPixel(pixel, dims, samples, bounces);
+
+    if (stride > 1)
+    {
+        uint2 blockEnd = min(blockOrigin + stride, dims);
+        for (uint y = blockOrigin.y; y < blockEnd.y; y++)
+        {
+            for (uint x = blockOrigin.x; x < blockEnd.x; x++)
+                gRadiance[uint2(x, y)] = float4(color, 0.0f);
+        }
+        return;
+    }
+
+    // Running mean over all visits since the ladder reached full resolution, alpha counts the
+    // samples in it. The relative change of the mean feeds the error estimate of the tile
+    float accumulated = 0.0f;
+    if (RayTraceCB.ProgressiveStride != 0)
+    {
+        uint slice = DispatchRaysIndex().z;
+        bool reset = RayTraceCB.TileCount != 0 && (RayTraceCB.TileResets[slice / 32] >> (slice % 32)) & 1;
+        float4 previous = gRadiance[pixel];
+        accumulated = reset ? 0.0f : previous.a;
+        color = lerp(previous.rgb, color, float(samples) / (accumulated + samples));
+
+        if (accumulated > 0.0f && RayTraceCB.TileCount != 0)
+        {
+            float change = abs(luminance(color) - luminance(previous.rgb)) / (luminance(previous.rgb) + 0.01f);
+            InterlockedAdd(gTileErrors[slice], uint(min(change, 16.0f) * 1024.0f));
+        }
+    }
+    gRadiance[pixel] = float4(color, accumulated + samples);
+
+    // Scattered rays summed over all samples of the pixel
+    if (RayTraceCB.AOVMask & AOVFlags::AOVBounceCount)
+        gBounceCounts[pixel] = bounces;
+}
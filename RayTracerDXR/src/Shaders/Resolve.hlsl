@@ -0,0 +1,126 @@
+#include "PostProcess.hlsli"
+
+float3 hueFromIndex(uint index)
+{
+    uint h = index * 2654435761u;
+    return float3((h >> 16) & 0xFF, (h >> 8) & 0xFF, h & 0xFF) / 255.0f;
+}
+
+float3 loadRadiance(in RWTexture2D<float4> source, in int2 p)
+{
+    float3 c = source[p].rgb;
+    if (PassCB.Flags & PostProcessFlags::PostProcessRemodulate)
+        c = remodulate(c, gAlbedo[p].rgb);
+    return c;
+}
+
+// Illumination of a render pixel, demodulated unless the denoiser already did it
+float3 loadIllumination(in RWTexture2D<float4> source, in int2 q)
+{
+    float3 c = source[q].rgb;
+    if (!(PassCB.Flags & PostProcessFlags::PostProcessRemodulate))
+        c = demodulate(c, gAlbedo[q].rgb);
+    return c;
+}
+
+static const float upsampleNormalPower = 32.0f;
+static const float upsampleDepthPhi = 0.02f;
+
+// Joint bilateral upsampling (Kopf et al. 2007) of the illumination from the render rectangle,
+// guided by the full resolution primary hits. Taps on another sphere or a different part of the
+// surface are dropped, so silhouettes and albedo edges keep the sharpness of the guide pass
+float3 upsampleRadiance(in RWTexture2D<float4> source, in int2 p, in uint2 dims)
+{
+    int2 renderSize = int2(RayTraceCB.RenderSize);
+    float2 position = (float2(p) + 0.5f) * float2(renderSize) / float2(dims) - 0.5f;
+    int2 base = int2(floor(position));
+    float2 f = position - float2(base);
+
+    float4 guide = gUpscaleNormalDepth[p];
+    uint guideInstance = gUpscaleInstanceIDs[p];
+
+    float3 sum = float3(0, 0, 0);
+    float weightSum = 0.0f;
+    float3 fallback = float3(0, 0, 0);
+    float fallbackScore = -1.0f;
+    for (int dy = -1; dy <= 2; dy++)
+    {
+        for (int dx = -1; dx <= 2; dx++)
+        {
+            int2 q = clamp(base + int2(dx, dy), int2(0, 0), renderSize - 1);
+            if (gInstanceIDs[q] != guideInstance)
+                continue;
+
+            float3 c = loadIllumination(source, q);
+            float geometric = pow(saturate(dot(gNormal[q].xyz, guide.xyz)), upsampleNormalPower) *
+                exp(-abs(gDepth[q] - guide.w) / (upsampleDepthPhi * guide.w + 1e-4f));
+
+            // Tent over two render pixels, the inner 2x2 taps carry the bilinear footprint
+            float2 distance = abs(float2(dx, dy) - f);
+            float2 tent = saturate(1.0f - 0.5f * distance);
+            float weight = tent.x * tent.y * geometric;
+            sum += c * weight;
+            weightSum += weight;
+
+            if (geometric > fallbackScore)
+            {
+                fallbackScore = geometric;
+                fallback = c;
+            }
+        }
+    }
+
+    // Thin features may have no matching tap at all, render them with the guide albedo only
+    float3 illumination = weightSum > 1e-4f ? sum / weightSum : (fallbackScore >= 0.0f ? fallback : float3(1, 1, 1));
+    return remodulate(illumination, gUpscaleAlbedo[p].rgb);
+}
+
+// Debug visualization of an AOV, the selected AOV must be enabled in RayTraceCB.AOVMask
+float3 viewAOV(in int2 p, in uint view)
+{
+    switch (view)
+    {
+        case AOVView::AOVViewAlbedo:
+            return gAlbedo[p].rgb;
+        case AOVView::AOVViewNormal:
+            return 0.5f * gNormal[p].xyz + 0.5f;
+        case AOVView::AOVViewDepth:
+            return gDepth[p] / (1.0f + gDepth[p]);
+        case AOVView::AOVViewInstanceID:
+            return gInstanceIDs[p] == 0xFFFFFFFF ? float3(0, 0, 0) : hueFromIndex(gInstanceIDs[p]);
+        case AOVView::AOVViewBounceCount:
+            return gBounceCounts[p] / float(RayTraceCB.MaxDepth * RayTraceCB.RaysPerPixel);
+        default:
+            return float3(0, 0, 0);
+    }
+}
+
+// Brings the (filtered) linear radiance to the swap chain resolution, the output stage maps the
+// result to the display
+[numthreads(PostProcessGroupSize, PostProcessGroupSize, 1)]
+void resolve(uint3 dispatchThreadID : SV_DispatchThreadID)
+{
+    RWTexture2D<float4> source = globalFloat4Textures[PassCB.SourceIndex];
+    RWTexture2D<float4> destination = globalFloat4Textures[PassCB.DestinationIndex];
+
+    uint2 dims;
+    destination.GetDimensions(dims.x, dims.y);
+    int2 p = int2(dispatchThreadID.xy);
+    if (isOutside(p, dims))
+        return;
+
+    float3 c;
+    if (all(RayTraceCB.RenderSize == dims))
+        c = loadRadiance(source, p);
+    else
+        c = upsampleRadiance(source, p, dims);
+
+    if (PassCB.View != AOVView::AOVViewNone)
+    {
+        int2 q = min(int2((float2(p) + 0.5f) * float2(RayTraceCB.RenderSize) / float2(dims)),
+                     int2(RayTraceCB.RenderSize) - 1);
+        c = viewAOV(q, PassCB.View);
+    }
+
+    destination[p] = float4(c, 1.0f);
+}
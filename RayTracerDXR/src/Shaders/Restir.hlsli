@@ -0,0 +1,235 @@
+#ifndef RESTIR_HLSLI
+#define RESTIR_HLSLI
+
+#include "Common.hlsli"
+#include "LightSampling.hlsli"
+
+// Reservoirs live in four structure-of-arrays buffers per set (light, sample position, weights,
+// surface) and two sets ping-pong between frames: one is written, the other is reused
+static const uint RESERVOIR_BUFFERS_PER_SET = 4;
+static const uint RESTIR_SPATIAL_NEIGHBORS = 3;
+static const float RESTIR_SPATIAL_RADIUS = 16.0f;
+static const float RESTIR_HISTORY_LIMIT = 20.0f;
+
+// Samples are points on the light surface and all weights are in area measure, so reservoirs
+// can move between pixels without a Jacobian
+struct Reservoir
+{
+    uint light;
+    float3 position;
+    float targetPdf;
+    float weightSum;
+    float M;
+    float W;
+};
+
+void reservoir_Initialize(inout Reservoir r)
+{
+    r.light = 0;
+    r.position = float3(0, 0, 0);
+    r.targetPdf = 0.0f;
+    r.weightSum = 0.0f;
+    r.M = 0.0f;
+    r.W = 0.0f;
+}
+
+uint reservoirSet(bool previous)
+{
+    uint set = (RayTraceCB.FrameIndex + (previous ? 1 : 0)) & 1;
+    return RayTraceCB.ReservoirsOffset + set * RESERVOIR_BUFFERS_PER_SET;
+}
+
+Reservoir loadReservoir(uint set, uint index)
+{
+    float4 position = globalFloat4Buffers[set + 1][index];
+    float4 weights = globalFloat4Buffers[set + 2][index];
+
+    Reservoir r;
+    r.light = globalUintBuffers[set][index];
+    r.position = position.xyz;
+    r.targetPdf = position.w;
+    r.weightSum = weights.y;
+    r.M = weights.z;
+    r.W = weights.x;
+    return r;
+}
+
+void storeReservoir(uint set, uint index, in Reservoir r, in float3 n, in float depth)
+{
+    globalUintBuffers[set][index] = r.light;
+    globalFloat4Buffers[set + 1][index] = float4(r.position, r.targetPdf);
+    globalFloat4Buffers[set + 2][index] = float4(r.W, r.weightSum, r.M, asfloat(RayTraceCB.RestirStamp));
+    globalFloat4Buffers[set + 3][index] = float4(n, depth);
+}
+
+// Written since the history was last dropped, for a surface like the one at the shading point
+bool isReusable(uint set, uint index, in float3 n, in float depth)
+{
+    if (asuint(globalFloat4Buffers[set + 2][index].w) != RayTraceCB.RestirStamp)
+        return false;
+
+    float4 surface = globalFloat4Buffers[set + 3][index];
+    return dot(surface.xyz, n) > 0.9f && abs(surface.w - depth) < 0.1f * depth;
+}
+
+// Unshadowed contribution of a point y on the light, in area measure
+float restirTargetPdf(in SphereInfo light, in float3 y, in float3 p, in float3 n, in float3 albedo)
+{
+    float3 toLight = y - p;
+    float d2 = dot(toLight, toLight);
+    if (d2 <= 0.0f)
+        return 0.0f;
+
+    float3 wi = toLight * rsqrt(d2);
+    float cosP = dot(n, wi);
+    float cosL = dot(normalize(y - light.Center), -wi);
+    if (cosP <= 0.0f || cosL <= 0.0f)
+        return 0.0f;
+
+    return luminance(light.Albedo * albedo / PI) * cosP * cosL / d2;
+}
+
+void updateReservoir(inout Reservoir r, uint light, in float3 y, float targetPdf, float weight, float count,
+                     inout uint seed)
+{
+    r.weightSum += weight;
+    r.M += count;
+    if (weight > 0.0f && randomFloat(seed) * r.weightSum < weight)
+    {
+        r.light = light;
+        r.position = y;
+        r.targetPdf = targetPdf;
+    }
+}
+
+// A reservoir without a usable sample still counts its candidates, otherwise the 1 / M of
+// finalizeReservoir would divide by too few and brighten pixels next to unlit neighbours
+void combineReservoir(inout Reservoir r, in Reservoir other, in float3 p, in float3 n, in float3 albedo,
+                      inout uint seed)
+{
+    if (!(other.M > 0.0f))
+        return;
+
+    if (!(other.W > 0.0f))
+    {
+        updateReservoir(r, other.light, other.position, 0.0f, 0.0f, other.M, seed);
+        return;
+    }
+
+    float targetPdf = restirTargetPdf(gSpheres[other.light], other.position, p, n, albedo);
+    updateReservoir(r, other.light, other.position, targetPdf, targetPdf * other.W * other.M, other.M, seed);
+}
+
+void finalizeReservoir(inout Reservoir r)
+{
+    r.W = (r.targetPdf > 0.0f && r.M > 0.0f) ? r.weightSum / (r.M * r.targetPdf) : 0.0f;
+}
+
+// Resampled importance sampling over RestirCandidates light samples
+Reservoir generateCandidates(in float3 p, in float3 n, in float3 albedo, inout uint seed)
+{
+    Reservoir r;
+    reservoir_Initialize(r);
+
+    for (uint i = 0; i < RayTraceCB.RestirCandidates; i++)
+    {
+        LightSample lightSample = sampleLight(p, n, seed);
+        SphereInfo light = gSpheres[lightSample.sphereIndex];
+
+        float3 direction;
+        float distance, pdf;
+        if (lightSample.pdf <= 0.0f || !sampleSphereLight(light, p, seed, direction, distance, pdf))
+        {
+            r.M += 1.0f;
+            continue;
+        }
+
+        float3 y = p + direction * distance;
+        float cosL = dot(normalize(y - light.Center), -direction);
+        float areaPdf = lightSample.pdf * pdf * max(cosL, 0.0f) / (distance * distance);
+        float targetPdf = restirTargetPdf(light, y, p, n, albedo);
+        float weight = areaPdf > 0.0f ? targetPdf / areaPdf : 0.0f;
+        updateReservoir(r, lightSample.sphereIndex, y, targetPdf, weight, 1.0f, seed);
+    }
+
+    finalizeReservoir(r);
+    return r;
+}
+
+// Spatiotemporal reservoir resampling for the primary hit, followed by a single shadow ray.
+// Only the first sample of a pixel publishes its reservoir, the others just reuse history.
+// Reservoirs are addressed by pixel, so tiles of any frame find the history of their pixels.
+// The coarse progressive levels neither reuse nor publish, their launch index is not a pixel
+float3 restirDirectLight(in Payload payload, in float3 p, in float3 n, in float3 albedo, inout uint seed)
+{
+    if (RayTraceCB.LightCount == 0)
+        return float3(0, 0, 0);
+
+    int2 pixel = int2(launchPixel());
+    int2 dims = int2(RayTraceCB.RenderSize);
+    float depth = length(p - RayTraceCB.CameraPosition);
+    bool coarse = RayTraceCB.ProgressiveStride > 1;
+
+    Reservoir r = generateCandidates(p, n, albedo, seed);
+    float historyLimit = RESTIR_HISTORY_LIMIT * max(1.0f, float(RayTraceCB.RestirCandidates));
+
+    if ((RayTraceCB.Restir & RestirFlags::RestirHistoryValid) && !coarse)
+    {
+        uint previousSet = reservoirSet(true);
+
+        int2 previousPixel;
+        bool reprojected = reprojectToPreviousFrame(p, previousPixel);
+        if ((RayTraceCB.Restir & RestirFlags::RestirTemporalReuse) && reprojected)
+        {
+            uint previousIndex = previousPixel.y * dims.x + previousPixel.x;
+            if (isReusable(previousSet, previousIndex, n, depth))
+            {
+                Reservoir previous = loadReservoir(previousSet, previousIndex);
+                previous.M = min(previous.M, historyLimit);
+                combineReservoir(r, previous, p, n, albedo, seed);
+            }
+        }
+
+        if (RayTraceCB.Restir & RestirFlags::RestirSpatialReuse)
+        {
+            int2 center = reprojected ? previousPixel : pixel;
+            for (uint i = 0; i < RESTIR_SPATIAL_NEIGHBORS; i++)
+            {
+                float2 offset = (float2(randomFloat(seed), randomFloat(seed)) * 2.0f - 1.0f) * RESTIR_SPATIAL_RADIUS;
+                int2 neighbor = center + int2(offset);
+                if (any(neighbor < 0) || any(neighbor >= dims))
+                    continue;
+
+                uint neighborIndex = neighbor.y * dims.x + neighbor.x;
+                if (!isReusable(previousSet, neighborIndex, n, depth))
+                    continue;
+
+                Reservoir candidate = loadReservoir(previousSet, neighborIndex);
+                candidate.M = min(candidate.M, historyLimit);
+                combineReservoir(r, candidate, p, n, albedo, seed);
+            }
+        }
+
+        finalizeReservoir(r);
+    }
+
+    if (payload.AAIndex == 0 && !coarse)
+        storeReservoir(reservoirSet(false), pixel.y * dims.x + pixel.x, r, n, depth);
+
+    if (!(r.W > 0.0f))
+        return float3(0, 0, 0);
+
+    SphereInfo light = gSpheres[r.light];
+    float3 toLight = r.position - p;
+    float distance = length(toLight);
+    float3 direction = toLight / distance;
+
+    float cosP = dot(n, direction);
+    float cosL = dot(normalize(r.position - light.Center), -direction);
+    if (cosP <= 0.0f || cosL <= 0.0f || !isVisible(p, direction, distance))
+        return float3(0, 0, 0);
+
+    return light.Albedo * albedo / PI * cosP * cosL / (distance * distance) * r.W;
+}
+
+#endif // RESTIR_HLSLI
@@ -1,4 +1,6 @@
 #include "Common.hlsli"
+#include "LightSampling.hlsli"
+#include "Restir.hlsli"
 
 struct HitInfo
 {
@@ -46,11 +48,23 @@ bool scatterDiffuse(in IntersectionAttributes attribs, inout Payload payload, in
 {
     uint instanceID = attribs.instanceID;
     HitInfo hit = getHitInfo(attribs);
+    float3 albedo = gSpheres[instanceID].Albedo;
     
     float3 randomPoint = getRandInUnitSphere(payload);
     float3 scatterDir = normalize((hit.Point + hit.Normal + randomPoint) - hit.Point);
     
-    payload.color *= gSpheres[instanceID].Albedo;
+    if (RayTraceCB.LightCount > 0)
+    {
+        uint seed = initRandomSeed(payload);
+        float3 origin = offsetRay(hit.Point, hit.Normal);
+        if (payload.recursions == 1 && (RayTraceCB.Restir & RestirFlags::RestirEnabled))
+            payload.radiance += payload.color * restirDirectLight(payload, origin, hit.Normal, albedo, seed);
+        else
+            payload.radiance += payload.color * estimateDirectLight(origin, hit.Normal, albedo, seed);
+        payload.flags |= PAYLOAD_FLAG_DIRECT_LIGHT_SAMPLED;
+    }
+    
+    payload.color *= albedo;
     scatterRay.Origin = offsetRay(hit.Point, hit.Normal);
     scatterRay.Direction = scatterDir;
 
@@ -64,8 +78,9 @@ bool scatterMetal(in IntersectionAttributes attribs, inout Payload payload, inou
     HitInfo hit = getHitInfo(attribs);
     float3 reflectionVector = reflect(normalize(WorldRayDirection()), hit.Normal);
     
-    float roughness = gMaterials[sphere.Type].Roughness;
+    float roughness = gMaterials[sphere.MaterialIndex].Roughness;
 
+    payload.flags &= ~PAYLOAD_FLAG_DIRECT_LIGHT_SAMPLED;
     payload.color *= gSpheres[instanceID].Albedo;
     scatterRay.Origin = offsetRay(hit.Point, hit.Normal);
     scatterRay.Direction = reflectionVector + pow(roughness, 2.0f) * getRandInUnitSphere(payload);
@@ -79,8 +94,9 @@ bool scatterDielectric(in IntersectionAttributes attribs, inout Payload payload,
     float3 indidentRay = WorldRayDirection();
     HitInfo hit = getHitInfo(attribs);
     
+    payload.flags &= ~PAYLOAD_FLAG_DIRECT_LIGHT_SAMPLED;
     payload.color *= sphere.Albedo;
-    float refIdx = gMaterials[sphere.Type].Eta;
+    float refIdx = gMaterials[sphere.MaterialIndex].Eta;
     
     float3 outwardNormal = float3(0, 0, 0);
     float3 reflected = reflect(indidentRay, hit.Normal);
@@ -111,6 +127,15 @@ bool scatterDielectric(in IntersectionAttributes attribs, inout Payload payload,
     return true;
 }
 
+// Emissive spheres terminate the path; Albedo holds the emitted radiance
+void emit(in IntersectionAttributes attribs, inout Payload payload)
+{
+    if (payload.flags & PAYLOAD_FLAG_DIRECT_LIGHT_SAMPLED)
+        payload.color = float3(0, 0, 0);
+    else
+        payload.color *= gSpheres[attribs.instanceID].Albedo;
+}
+
 bool scatter(in IntersectionAttributes attribs, inout Payload payload, inout RayDesc scatterRay)
 {
     MaterialType type = gSpheres[attribs.instanceID].Type;
@@ -122,6 +147,9 @@ bool scatter(in IntersectionAttributes attribs, inout Payload payload, inout Ray
             return scatterMetal(attribs, payload, scatterRay);
         case MaterialType::Dielectric:
             return scatterDielectric(attribs, payload, scatterRay);
+        case MaterialType::Emissive:
+            emit(attribs, payload);
+            return false;
         default:
             return false;
     }
@@ -0,0 +1,7 @@
+#include "Common.hlsli"
+
+[shader("miss")]
+void shadowMiss(inout ShadowPayload payload)
+{
+    payload.occluded = 0;
+}
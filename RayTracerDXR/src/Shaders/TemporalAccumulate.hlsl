@@ -0,0 +1,92 @@
+#include "PostProcess.hlsli"
+
+static const float maxHistoryLength = 32.0f;
+static const float normalThreshold = 0.9f;
+static const float depthThreshold = 0.05f;
+
+uint historyIndex(uint kind, uint parity)
+{
+    return RayTraceCB.HistoryOffset + 2 * kind + parity;
+}
+
+// Reprojects the primary hit of pixel p into the previous frame and blends the history with the
+// current radiance. Each of the bilinear history taps is rejected on instance ID, normal and
+// depth mismatch; the blend factor follows the length of the surviving history, so freshly
+// disoccluded pixels converge quickly and stable ones average up to maxHistoryLength frames
+[numthreads(PostProcessGroupSize, PostProcessGroupSize, 1)]
+void temporalAccumulate(uint3 dispatchThreadID : SV_DispatchThreadID)
+{
+    uint current = RayTraceCB.FrameIndex & 1;
+    uint previous = current ^ 1;
+
+    RWTexture2D<float4> radiance = globalFloat4Textures[PassCB.SourceIndex];
+    RWTexture2D<float4> colorOut = globalFloat4Textures[historyIndex(HistoryTexture::HistoryColor, current)];
+    RWTexture2D<float4> surfaceOut = globalFloat4Textures[historyIndex(HistoryTexture::HistorySurface, current)];
+    RWTexture2D<uint> instanceOut = globalUintTextures[historyIndex(HistoryTexture::HistoryInstanceID, current)];
+    RWTexture2D<float4> colorIn = globalFloat4Textures[historyIndex(HistoryTexture::HistoryColor, previous)];
+    RWTexture2D<float4> surfaceIn = globalFloat4Textures[historyIndex(HistoryTexture::HistorySurface, previous)];
+    RWTexture2D<uint> instanceIn = globalUintTextures[historyIndex(HistoryTexture::HistoryInstanceID, previous)];
+
+    uint2 dims = RayTraceCB.RenderSize;
+    int2 p = int2(dispatchThreadID.xy);
+    if (isOutside(p, dims))
+        return;
+
+    float3 color = radiance[p].rgb;
+    float3 normal = gNormal[p].xyz;
+    float depth = gDepth[p];
+    uint instanceID = gInstanceIDs[p];
+
+    float3 history = float3(0, 0, 0);
+    float historyLength = 0.0f;
+    float confidence = 0.0f;
+
+    float3 position = RayTraceCB.CameraPosition + depth * primaryRayDirection(p, dims);
+    float4 clip = mul(float4(position, 1.0f), RayTraceCB.PreviousViewProjection);
+    if ((PassCB.Flags & PostProcessFlags::PostProcessHistoryValid) && clip.w > 0.0f)
+    {
+        float2 ndc = clip.xy / clip.w;
+        float2 uv = float2(0.5f * ndc.x + 0.5f, 0.5f - 0.5f * ndc.y);
+        float2 previousPixel = uv * float2(dims) - 0.5f;
+        int2 base = int2(floor(previousPixel));
+        float2 f = previousPixel - float2(base);
+        float expectedDepth = length(position - RayTraceCB.PreviousCameraPosition);
+
+        float weightSum = 0.0f;
+        for (int i = 0; i < 4; i++)
+        {
+            int2 offset = int2(i & 1, i >> 1);
+            int2 q = base + offset;
+            if (isOutside(q, dims) || instanceIn[q] != instanceID)
+                continue;
+
+            float4 surface = surfaceIn[q];
+            if (dot(surface.xyz, normal) < normalThreshold ||
+                abs(surface.w - expectedDepth) > depthThreshold * expectedDepth)
+                continue;
+
+            float2 bilinear = select(offset == int2(1, 1), f, 1.0f - f);
+            float weight = bilinear.x * bilinear.y;
+            float4 tap = colorIn[q];
+            history += tap.rgb * weight;
+            historyLength += tap.a * weight;
+            weightSum += weight;
+        }
+
+        if (weightSum > 0.01f)
+        {
+            history /= weightSum;
+            historyLength /= weightSum;
+            confidence = weightSum;
+        }
+    }
+
+    // Partially rejected footprints keep only a part of their history
+    float accumulated = min(historyLength * confidence + 1.0f, maxHistoryLength);
+    float alpha = 1.0f / accumulated;
+    float3 blended = lerp(history, color, alpha);
+
+    colorOut[p] = float4(blended, accumulated);
+    surfaceOut[p] = float4(normal, depth);
+    instanceOut[p] = instanceID;
+}
@@ -0,0 +1,78 @@
+#include "PostProcess.hlsli"
+
+// sRGB to ACES AP1 with the RRT saturation folded in and back, from Stephen Hill's fit of the
+// ACES reference rendering and output transforms
+static const float3x3 acesInputMatrix =
+{
+    0.59719f, 0.35458f, 0.04823f,
+    0.07600f, 0.90834f, 0.01566f,
+    0.02840f, 0.13383f, 0.83777f
+};
+
+static const float3x3 acesOutputMatrix =
+{
+     1.60475f, -0.53108f, -0.07367f,
+    -0.10208f,  1.10813f, -0.00605f,
+    -0.00327f, -0.07276f,  1.07602f
+};
+
+float3 rrtAndOdtFit(in float3 v)
+{
+    float3 a = v * (v + 0.0245786f) - 0.000090537f;
+    float3 b = v * (0.983729f * v + 0.4329510f) + 0.238081f;
+    return a / b;
+}
+
+float3 acesFitted(in float3 c)
+{
+    c = mul(acesInputMatrix, c);
+    c = rrtAndOdtFit(c);
+    return saturate(mul(acesOutputMatrix, c));
+}
+
+uint hashPixel(in uint2 p, in uint frame)
+{
+    uint h = p.x * 73856093u ^ p.y * 19349663u ^ frame * 83492791u;
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    h *= 0x846ca68bu;
+    h ^= h >> 16;
+    return h;
+}
+
+// Triangular noise of one 8-bit step amplitude, turns banding in dark gradients into grain that
+// averages out over frames
+float3 dither(in float3 c, in uint2 p)
+{
+    uint h = hashPixel(p, RayTraceCB.FrameIndex);
+    float u1 = float(h & 0xFFFF) / 65535.0f;
+    float u2 = float(h >> 16) / 65535.0f;
+    return c + (u1 + u2 - 1.0f) / 255.0f;
+}
+
+// Output stage: exposure, ACES tonemap, sRGB encoding and dithering of the resolved linear frame
+// into the 8-bit output texture. AOV views skip the exposure and the tonemap
+[numthreads(PostProcessGroupSize, PostProcessGroupSize, 1)]
+void tonemap(uint3 dispatchThreadID : SV_DispatchThreadID)
+{
+    RWTexture2D<float4> source = globalFloat4Textures[PassCB.SourceIndex];
+
+    uint2 dims;
+    gOutput.GetDimensions(dims.x, dims.y);
+    int2 p = int2(dispatchThreadID.xy);
+    if (isOutside(p, dims))
+        return;
+
+    // Negative lobes of the pixel filter can leave pixels slightly below zero
+    float3 c = max(source[p].rgb, 0.0f);
+    if (PassCB.View == AOVView::AOVViewNone)
+    {
+        float exposure = exp2(PassCB.ExposureBias);
+        if (PassCB.Flags & PostProcessFlags::PostProcessAutoExposure)
+            exposure *= globalFloat4Buffers[PassCB.ExposureIndex][0].x;
+        c = acesFitted(c * exposure);
+    }
+
+    gOutput[p] = float4(saturate(dither(linearToSrgb(c), p)), 1.0f);
+}
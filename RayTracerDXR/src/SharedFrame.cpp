@@ -0,0 +1,112 @@
+#include "SharedFrame.h"
+#include "ErrorLog.h"
+
+#include <new>
+
+SharedFrameServer::~SharedFrameServer()
+{
+	Buffer = nullptr;
+	Heap = nullptr;
+	if (Header)
+		UnmapViewOfFile(Header);
+	if (Mapping)
+		CloseHandle(Mapping);
+}
+
+bool SharedFrameServer::Create(ID3D12Device5Ptr device, const wchar_t* name, const glm::uvec2& size)
+{
+	const uint32_t rowPitch = (size.x * 4 + D3D12_TEXTURE_DATA_PITCH_ALIGNMENT - 1) &
+		~(D3D12_TEXTURE_DATA_PITCH_ALIGNMENT - 1);
+	SlotSize = (static_cast<uint64_t>(rowPitch) * size.y + SharedFrameLayout::Alignment - 1) &
+		~(SharedFrameLayout::Alignment - 1);
+	const uint64_t total = SharedFrameLayout::Alignment + SharedFrameLayout::SlotCount * SlotSize;
+
+	Mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, static_cast<DWORD>(total >> 32),
+								 static_cast<DWORD>(total), name);
+	if (!Mapping)
+		return false;
+
+	void* view = MapViewOfFile(Mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+	if (!view)
+		return false;
+
+	Header = new (view) SharedFrameHeader{};
+	Header->Magic = SharedFrameLayout::Magic;
+	Header->Version = SharedFrameLayout::Version;
+	Header->Width = size.x;
+	Header->Height = size.y;
+	Header->RowPitch = rowPitch;
+	Header->SlotCount = SharedFrameLayout::SlotCount;
+	Header->PublishedFrames.store(0, std::memory_order_relaxed);
+	for (uint32_t i = 0; i < SharedFrameLayout::SlotCount; i++)
+	{
+		Header->Slots[i].Sequence.store(0, std::memory_order_relaxed);
+		Header->Slots[i].DataOffset = SharedFrameLayout::Alignment + i * SlotSize;
+	}
+	Header->LatestSlot.store(~0u, std::memory_order_release);
+
+	// The whole mapping becomes a heap in system memory that the copy queue writes into
+	if (FAILED(device->OpenExistingHeapFromFileMapping(Mapping, IID_PPV_ARGS(&Heap))))
+		return false;
+
+	const D3D12_RESOURCE_DESC desc = CD3DX12_RESOURCE_DESC::Buffer(SharedFrameLayout::SlotCount * SlotSize,
+																	D3D12_RESOURCE_FLAG_ALLOW_CROSS_ADAPTER);
+	GRAPHICS_ASSERT(device->CreatePlacedResource(Heap, SharedFrameLayout::Alignment, &desc,
+												 D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&Buffer)));
+	return true;
+}
+
+uint32_t SharedFrameServer::BeginFrame()
+{
+	const uint32_t slot = NextSlot;
+	NextSlot = (NextSlot + 1) % SharedFrameLayout::SlotCount;
+
+	std::atomic<uint32_t>& sequence = Header->Slots[slot].Sequence;
+	sequence.store(sequence.load(std::memory_order_relaxed) | 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	return slot;
+}
+
+void SharedFrameServer::PublishFrame(uint32_t slot, const SharedFrameStats& stats)
+{
+	SharedFrameSlot& target = Header->Slots[slot];
+	target.FrameNumber = stats.FrameNumber;
+	target.RaysPerPixel = stats.RaysPerPixel;
+	target.AccumulatedFrames = stats.AccumulatedFrames;
+	target.GpuMilliseconds = stats.GpuMilliseconds;
+	target.CpuMilliseconds = stats.CpuMilliseconds;
+
+	target.Sequence.store(target.Sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	Header->LatestSlot.store(slot, std::memory_order_release);
+	Header->PublishedFrames.fetch_add(1, std::memory_order_release);
+}
+
+D3D12_PLACED_SUBRESOURCE_FOOTPRINT SharedFrameServer::GetFootprint(uint32_t slot) const
+{
+	D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint{};
+	footprint.Offset = slot * SlotSize;
+	footprint.Footprint.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	footprint.Footprint.Width = Header->Width;
+	footprint.Footprint.Height = Header->Height;
+	footprint.Footprint.Depth = 1;
+	footprint.Footprint.RowPitch = Header->RowPitch;
+	return footprint;
+}
+
+SharedFrameReader::~SharedFrameReader()
+{
+	if (Header)
+		UnmapViewOfFile(Header);
+	if (Mapping)
+		CloseHandle(Mapping);
+}
+
+bool SharedFrameReader::Open(const wchar_t* name)
+{
+	Mapping = OpenFileMappingW(FILE_MAP_READ, FALSE, name);
+	if (!Mapping)
+		return false;
+
+	Header = static_cast<const SharedFrameHeader*>(MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0));
+	return Header && Header->Magic == SharedFrameLayout::Magic && Header->Version == SharedFrameLayout::Version;
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "Core.h"
+
+#include <atomic>
+
+// Layout of the shared memory frame server. A viewer process opens the named mapping, reads the
+// header from the start of it and the pixels of a slot straight from the mapping. The render side
+// has the GPU copy each frame into a slot of the mapping, so neither side copies on the CPU.
+//
+// Every slot is guarded by a seqlock: Sequence is odd while the GPU may be writing the slot and
+// advances to the next even value once the frame is complete. LatestSlot names the newest complete
+// one. A reader takes LatestSlot, reads Sequence, uses the pixels and accepts them if Sequence is
+// still the same even value. There are more slots than frames in flight, so the latest complete
+// slot is only rewritten after SlotCount - 1 newer frames, readers practically never retry
+namespace SharedFrameLayout
+{
+	static constexpr wchar_t DefaultName[] = L"Local\\RayTracerDXR.Frame";
+	static constexpr uint32_t Magic = 0x53465452; // "RTFS"
+	static constexpr uint32_t Version = 1;
+	static constexpr uint32_t SlotCount = kDefaultSwapChainBuffers + 1;
+	// Placed resources start at 64KB boundaries
+	static constexpr uint64_t Alignment = 65536;
+}
+
+struct SharedFrameSlot
+{
+	std::atomic<uint32_t> Sequence;
+	uint32_t RaysPerPixel;
+	// Frame counter of the renderer and frames accumulated since the last restart
+	uint64_t FrameNumber;
+	uint32_t AccumulatedFrames;
+	float GpuMilliseconds;
+	float CpuMilliseconds;
+	uint32_t Reserved;
+	// From the start of the mapping
+	uint64_t DataOffset;
+};
+
+// RGBA8 sRGB rows of RowPitch bytes, the displayed frame
+struct SharedFrameHeader
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint32_t Width;
+	uint32_t Height;
+	uint32_t RowPitch;
+	uint32_t SlotCount;
+	// Frames published so far and the slot of the newest one, ~0 before the first
+	std::atomic<uint64_t> PublishedFrames;
+	std::atomic<uint32_t> LatestSlot;
+	uint32_t Reserved;
+	SharedFrameSlot Slots[SharedFrameLayout::SlotCount];
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free && std::atomic<uint64_t>::is_always_lock_free,
+			  "The shared header needs address free atomics");
+static_assert(sizeof(SharedFrameHeader) <= SharedFrameLayout::Alignment);
+
+struct SharedFrameStats
+{
+	uint64_t FrameNumber = 0;
+	uint32_t RaysPerPixel = 0;
+	uint32_t AccumulatedFrames = 0;
+	float GpuMilliseconds = 0.0f;
+	float CpuMilliseconds = 0.0f;
+};
+
+// Render side. The mapping is opened as a D3D12 heap, so the copies of the frame land in it
+// directly. Slots are handed out round robin and published once their frame completed
+struct SharedFrameServer
+{
+	SharedFrameServer() = default;
+	~SharedFrameServer();
+	SharedFrameServer(const SharedFrameServer&) = delete;
+	SharedFrameServer& operator=(const SharedFrameServer&) = delete;
+
+	bool Create(ID3D12Device5Ptr device, const wchar_t* name, const glm::uvec2& size);
+
+	// Marks the next slot as being written by the GPU and returns its index
+	uint32_t BeginFrame();
+	void PublishFrame(uint32_t slot, const SharedFrameStats& stats);
+
+	inline ID3D12ResourcePtr GetBuffer() const { return Buffer; }
+	D3D12_PLACED_SUBRESOURCE_FOOTPRINT GetFootprint(uint32_t slot) const;
+
+private:
+	HANDLE Mapping = nullptr;
+	SharedFrameHeader* Header = nullptr;
+	ID3D12HeapPtr Heap;
+	// One buffer over all slots, placed after the header page
+	ID3D12ResourcePtr Buffer;
+	uint64_t SlotSize = 0;
+	uint32_t NextSlot = 0;
+};
+
+// Viewer side, only reads the mapping
+struct SharedFrameReader
+{
+	SharedFrameReader() = default;
+	~SharedFrameReader();
+	SharedFrameReader(const SharedFrameReader&) = delete;
+	SharedFrameReader& operator=(const SharedFrameReader&) = delete;
+
+	bool Open(const wchar_t* name = SharedFrameLayout::DefaultName);
+
+	// Calls consume(header, slot, pixels) on the newest complete frame. Returns false if there is
+	// none yet, or if the renderer overwrote the slot while consume was running; the pixels seen
+	// by consume must be discarded in that case
+	template<typename Consumer>
+	bool ReadLatest(Consumer&& consume) const
+	{
+		const uint32_t slotIndex = Header->LatestSlot.load(std::memory_order_acquire);
+		if (slotIndex >= SharedFrameLayout::SlotCount)
+			return false;
+
+		const SharedFrameSlot& slot = Header->Slots[slotIndex];
+		const uint32_t before = slot.Sequence.load(std::memory_order_acquire);
+		if (before & 1)
+			return false;
+
+		consume(*Header, slot, reinterpret_cast<const uint8_t*>(Header) + slot.DataOffset);
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return slot.Sequence.load(std::memory_order_relaxed) == before;
+	}
+
+	inline const SharedFrameHeader* GetHeader() const { return Header; }
+
+private:
+	HANDLE Mapping = nullptr;
+	const SharedFrameHeader* Header = nullptr;
+};
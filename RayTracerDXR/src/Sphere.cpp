@@ -1,11 +1,16 @@
 #include "Sphere.h"
 #include "Utils.h"
 
+#include <algorithm>
+#include <cassert>
+
 Sphere::Sphere(glm::vec3 center,
 			   float radius,
 			   glm::vec3 albedo,
-			   MaterialType type)
-	:Center(center), Radius(radius), Albedo(albedo), Type(type)
+			   MaterialType type,
+			   uint32_t materialIndex)
+	:Center(center), Radius(radius), Albedo(albedo), Type(type),
+	MaterialIndex(materialIndex != ~0u ? materialIndex : static_cast<uint32_t>(type))
 {}
 
 Sphere::Sphere(const Sphere & other)
@@ -14,6 +19,7 @@ Sphere::Sphere(const Sphere & other)
 	Radius = other.Radius;
 	Albedo = other.Albedo;
 	Type = other.Type;
+	MaterialIndex = other.MaterialIndex;
 }
 
 D3D12_RAYTRACING_AABB Sphere::GetAABB() const
@@ -49,20 +55,118 @@ ID3D12ResourcePtr Sphere::CreateSphereAABB(ID3D12Device5Ptr pDevice)
 
 void SphereComposite::AddSphere(const Sphere& sphere)
 {
-	Spheres.push_back(sphere);
-	UpdateBuffer();
+	Insert(std::span<const Sphere>(&sphere, 1));
+	Commit();
 }
 
-void SphereComposite::UpdateBuffer()
+void SphereComposite::AddSpheres(std::span<const Sphere> spheres)
 {
-	if (Buffer != nullptr)
-		Buffer.Release();
-	
-	Buffer = D3D::CreateBuffer(Device, sizeof(SphereInfo) * Spheres.size(), D3D12_RESOURCE_FLAG_NONE,
-							   D3D12_RESOURCE_STATE_GENERIC_READ, D3D::UploadHeapProps);
+	Insert(spheres);
+	Commit();
+}
 
-	uint8_t* pData;
-	Buffer->Map(0, nullptr, (void**)&pData);
-	std::memcpy(pData, Spheres.data(), sizeof(SphereInfo) * Spheres.size());
-	Buffer->Unmap(0, nullptr);
-}
\ No newline at end of file
+void SphereComposite::Reference(std::span<const Sphere> spheres)
+{
+	Spheres.clear();
+	View = spheres;
+	Dirty.clear();
+	MarkDirty(0, Size());
+	Commit();
+}
+
+void SphereComposite::SetSphere(uint32_t index, const Sphere& sphere)
+{
+	Update(index, sphere);
+	Commit();
+}
+
+uint32_t SphereComposite::Insert(std::span<const Sphere> spheres)
+{
+	MakeOwned();
+	const uint32_t first = Size();
+	Spheres.insert(Spheres.end(), spheres.begin(), spheres.end());
+	View = Spheres;
+	MarkDirty(first, Size());
+	return first;
+}
+
+void SphereComposite::Update(uint32_t index, const Sphere& sphere)
+{
+	assert(index < Size() && "Sphere index out of range");
+	MakeOwned();
+	Spheres[index] = sphere;
+	MarkDirty(index, index + 1);
+}
+
+// Without a device the composite only lives on the CPU, as in the scene converter
+SphereChanges SphereComposite::Commit()
+{
+	SphereChanges changes;
+	changes.Resized = Size() != CommittedSize;
+
+	// Ranges are recorded in edit order, merged here once per commit
+	std::sort(Dirty.begin(), Dirty.end(), [](const SphereRange& a, const SphereRange& b) { return a.Begin < b.Begin; });
+	for (const SphereRange& range : Dirty)
+	{
+		if (range.Begin >= range.End)
+			continue;
+		if (!changes.Ranges.empty() && range.Begin <= changes.Ranges.back().End)
+			changes.Ranges.back().End = std::max(changes.Ranges.back().End, range.End);
+		else
+			changes.Ranges.push_back(range);
+	}
+	Dirty.clear();
+
+	if (changes.Resized)
+		Epoch++;
+	CommittedSize = Size();
+	if (!Device)
+		return changes;
+
+	if (!Buffer || Size() > BufferCapacity)
+	{
+		BufferCapacity = std::max({ Size(), 2 * BufferCapacity, 1u });
+		Buffer = D3D::CreateBuffer(Device, sizeof(SphereInfo) * BufferCapacity, D3D12_RESOURCE_FLAG_NONE,
+								   D3D12_RESOURCE_STATE_COMMON, D3D::DefaultHeapProps);
+		Uploads.assign(1, SphereRange{ 0, Size() });
+		changes.Reallocated = true;
+		return changes;
+	}
+
+	Uploads.insert(Uploads.end(), changes.Ranges.begin(), changes.Ranges.end());
+	return changes;
+}
+
+void SphereComposite::Upload(ID3D12GraphicsCommandList4Ptr cmdList, D3D::UploadRing& uploads)
+{
+	if (Uploads.empty())
+		return;
+
+	D3D::ResourceBarrier(cmdList, Buffer, D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_COPY_DEST);
+	for (const SphereRange& range : Uploads)
+		uploads.Copy(cmdList, Buffer, sizeof(SphereInfo) * range.Begin, View.data() + range.Begin,
+					 sizeof(SphereInfo) * (range.End - range.Begin));
+	D3D::ResourceBarrier(cmdList, Buffer, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+	Uploads.clear();
+}
+
+void SphereComposite::MakeOwned()
+{
+	if (View.data() == Spheres.data())
+		return;
+
+	Spheres.assign(View.begin(), View.end());
+	View = Spheres;
+}
+
+// Consecutive edits of neighbouring spheres extend the last range instead of adding one
+void SphereComposite::MarkDirty(uint32_t begin, uint32_t end)
+{
+	if (!Dirty.empty() && begin <= Dirty.back().End && end >= Dirty.back().Begin)
+	{
+		Dirty.back().Begin = std::min(Dirty.back().Begin, begin);
+		Dirty.back().End = std::max(Dirty.back().End, end);
+		return;
+	}
+	Dirty.push_back(SphereRange{ begin, end });
+}
@@ -3,12 +3,21 @@
 #include "Core.h"
 #include "Shaders/HLSLCompat.h"
 
+#include <span>
+
+namespace D3D
+{
+	struct UploadRing;
+}
+
 struct Sphere
 {
+	// The materials of the default scene are in the order of their types, materialIndex defaults to it
 	Sphere(glm::vec3 center = glm::vec3(0.0f), 
 		   float radius = 1.0f, 
 		   glm::vec3 albedo = glm::vec3(1.0f),
-		   MaterialType type = MaterialType::Diffuse);
+		   MaterialType type = MaterialType::Diffuse,
+		   uint32_t materialIndex = ~0u);
 	Sphere(const Sphere& other);
 	D3D12_RAYTRACING_AABB GetAABB() const;
 	glm::mat4x4 GetInstanceTransform() const;
@@ -25,33 +34,89 @@ struct Sphere
 			float Radius;
 			glm::vec3 Albedo;
 			MaterialType Type;
+			uint32_t MaterialIndex;
 		};
 		SphereInfo Data;
 	};
 };
 
+// Spheres are uploaded and stored in scene files exactly as the shaders read them
+static_assert(sizeof(Sphere) == sizeof(SphereInfo));
+
+// Half-open range of sphere indices
+struct SphereRange
+{
+	uint32_t Begin = 0;
+	uint32_t End = 0;
+};
+
+// What a commit changed, for the structures derived from the spheres. Ranges are sorted and
+// disjoint and cover every sphere that was added or updated
+struct SphereChanges
+{
+	std::vector<SphereRange> Ranges;
+	// The buffer was created anew, views of it have to be created again
+	bool Reallocated = false;
+	// The number of spheres changed
+	bool Resized = false;
+};
+
 struct SphereComposite
 {
 	using ValueType = Sphere;
 	
 	SphereComposite() = default;
 
+	// Like Reference, these build the scene before the renderer records frames with it. The
+	// buffer, its views, the acceleration structures and the lights are created for that set of
+	// spheres and are not rebuilt, so afterwards spheres only change through Update
 	void AddSphere(const Sphere& sphere);
+	void AddSpheres(std::span<const Sphere> spheres);
+	// Uses spheres that live elsewhere, e.g. in a mapped scene file, without copying them. The
+	// memory has to stay valid until the composite is destroyed or the first edit copies it
+	void Reference(std::span<const Sphere> spheres);
+	// Overwrites one sphere in place, views of the buffer stay valid
+	void SetSphere(uint32_t index, const Sphere& sphere);
+
+	// Batched edits only change the spheres on the CPU and record the ranges they touch, Commit
+	// then queues just those ranges for the next Upload
+	void Update(uint32_t index, const Sphere& sphere);
+	SphereChanges Commit();
+	// Records the copies of everything committed since the last upload on the command list, so
+	// frames in flight keep reading the spheres they were recorded with. A reallocated buffer is
+	// copied as a whole
+	void Upload(ID3D12GraphicsCommandList4Ptr cmdList, D3D::UploadRing& uploads);
 
 	inline void SetDevice(ID3D12Device5Ptr device) { Device = device; }
 	
-	inline uint32_t Size() const { return static_cast<uint32_t>(Spheres.size()); }
-	inline const ValueType* Data() const { return Spheres.data(); }
+	inline uint32_t Size() const { return static_cast<uint32_t>(View.size()); }
+	inline uint32_t Capacity() const { return BufferCapacity; }
+	inline const ValueType* Data() const { return View.data(); }
 	inline ID3D12Resource* GetBufferPtr() { return Buffer.GetInterfacePtr(); }
+	// Incremented when the number of spheres changes, updates are tracked by their screen footprint
+	inline uint64_t GetEpoch() const { return Epoch; }
 
-	inline ValueType& operator[](size_t i) { return Spheres[i]; }
-	inline const ValueType& operator[](size_t i) const { return Spheres[i]; }
+	inline const ValueType& operator[](size_t i) const { return View[i]; }
 
 private:
-	void UpdateBuffer();
+	// Appends without committing. The buffer doubles its capacity when it runs out, so N single
+	// AddSphere calls cost O(N) copies in total
+	uint32_t Insert(std::span<const Sphere> spheres);
+	// Copies referenced spheres before the first edit
+	void MakeOwned();
+	void MarkDirty(uint32_t begin, uint32_t end);
 
 private:
 	std::vector<ValueType> Spheres;
+	// Either Spheres or the referenced memory
+	std::span<const ValueType> View;
+	std::vector<SphereRange> Dirty;
+	uint32_t CommittedSize = 0;
+
 	ID3D12ResourcePtr Buffer;
+	// Committed but not uploaded yet
+	std::vector<SphereRange> Uploads;
+	uint32_t BufferCapacity = 0;
 	ID3D12Device5Ptr Device;
-};
\ No newline at end of file
+	uint64_t Epoch = 0;
+};
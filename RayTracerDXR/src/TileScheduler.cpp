@@ -0,0 +1,191 @@
+#include "TileScheduler.h"
+
+#include <algorithm>
+#include <numeric>
+#include <utility>
+
+bool TileRect::Overlaps(const TileRect& other) const
+{
+	return glm::all(glm::lessThan(Min, other.Max)) && glm::all(glm::lessThan(other.Min, Max));
+}
+
+void TileScheduler::Reset(const glm::uvec2& size, uint32_t tileSize)
+{
+	TileSize = std::max(tileSize, 1u);
+	const glm::uvec2 count = (size + TileSize - 1u) / TileSize;
+
+	Tiles.clear();
+	Tiles.reserve(count.x * count.y);
+	for (uint32_t y = 0; y < count.y; y++)
+	{
+		for (uint32_t x = 0; x < count.x; x++)
+		{
+			TileInfo tile;
+			tile.Bounds.Min = glm::uvec2(x, y) * TileSize;
+			tile.Bounds.Max = glm::min(tile.Bounds.Min + TileSize, size);
+			Tiles.push_back(tile);
+		}
+	}
+
+	Order.resize(Tiles.size());
+	std::iota(Order.begin(), Order.end(), 0u);
+	UpdatePriorities();
+}
+
+void TileScheduler::SetPriority(PriorityFunction priority)
+{
+	Priority = std::move(priority);
+	UpdatePriorities();
+}
+
+const std::vector<uint32_t>& TileScheduler::Schedule(uint32_t count)
+{
+	UpdatePriorities();
+
+	count = std::min(count, Size());
+	auto due = [this](uint32_t a, uint32_t b)
+	{
+		if (Tiles[a].VirtualTime != Tiles[b].VirtualTime)
+			return Tiles[a].VirtualTime < Tiles[b].VirtualTime;
+		return Tiles[a].Priority > Tiles[b].Priority;
+	};
+	std::partial_sort(Order.begin(), Order.begin() + count, Order.end(), due);
+
+	Scheduled.assign(Order.begin(), Order.begin() + count);
+	for (uint32_t i : Scheduled)
+	{
+		Tiles[i].VirtualTime += 1.0f / Tiles[i].Priority;
+		Tiles[i].Visits++;
+	}
+	return Scheduled;
+}
+
+void TileScheduler::ReportError(uint32_t tile, float error)
+{
+	if (tile < Size())
+		Tiles[tile].Error = error;
+}
+
+void TileScheduler::Invalidate(const TileRect& region)
+{
+	const float now = GetVirtualTime();
+	for (TileInfo& tile : Tiles)
+	{
+		if (!tile.Bounds.Overlaps(region))
+			continue;
+
+		tile.Visits = 0;
+		tile.Error = 1.0f;
+		tile.VirtualTime = now;
+		tile.ResetPending = true;
+	}
+}
+
+bool TileScheduler::ConsumeReset(uint32_t tile)
+{
+	return std::exchange(Tiles[tile].ResetPending, false);
+}
+
+TileSchedulerState TileScheduler::GetState() const
+{
+	return TileSchedulerState{ .Tiles = Tiles, .Order = Order };
+}
+
+bool TileScheduler::SetState(TileSchedulerState state)
+{
+	if (state.Tiles.size() != Tiles.size() || state.Order.size() != Order.size())
+		return false;
+
+	for (size_t i = 0; i < Tiles.size(); i++)
+	{
+		if (state.Order[i] >= Tiles.size())
+			return false;
+		// Bounds follow from the size, only the progress of the tiles is taken over
+		state.Tiles[i].Bounds = Tiles[i].Bounds;
+	}
+
+	Tiles = std::move(state.Tiles);
+	Order = std::move(state.Order);
+	UpdatePriorities();
+	return true;
+}
+
+float TileScheduler::GetVirtualTime() const
+{
+	float now = Tiles.empty() ? 0.0f : Tiles[0].VirtualTime;
+	for (const TileInfo& tile : Tiles)
+		now = std::min(now, tile.VirtualTime);
+	return now;
+}
+
+// A tile that just became important must not wait until the others caught up with the virtual
+// time it accumulated while it was not, so it is pulled back to at most one visit ahead
+void TileScheduler::UpdatePriorities()
+{
+	const float now = GetVirtualTime();
+	for (TileInfo& tile : Tiles)
+	{
+		tile.Priority = std::clamp(Priority ? Priority(tile) : 1.0f, MinPriority, 1.0f);
+		tile.VirtualTime = std::min(tile.VirtualTime, now + 1.0f / tile.Priority);
+	}
+}
+
+TileScheduler::PriorityFunction TileScheduler::FocusPriority(const glm::vec2& focus, float radius)
+{
+	return [focus, radius](const TileInfo& tile)
+	{
+		glm::vec2 center = 0.5f * glm::vec2(tile.Bounds.Min + tile.Bounds.Max);
+		float d = glm::length(center - focus) / radius;
+		return 1.0f / (1.0f + d * d);
+	};
+}
+
+TileScheduler::PriorityFunction TileScheduler::RegionPriority(std::vector<TileRect> regions)
+{
+	return [regions = std::move(regions)](const TileInfo& tile)
+	{
+		bool inside = std::any_of(regions.begin(), regions.end(),
+								  [&tile](const TileRect& region) { return region.Overlaps(tile.Bounds); });
+		return inside ? 1.0f : 0.0f;
+	};
+}
+
+TileScheduler::PriorityFunction TileScheduler::ErrorPriority()
+{
+	// Relative change of the tile mean at which a tile counts as far from converged
+	constexpr float errorScale = 0.05f;
+	return [](const TileInfo& tile) { return tile.Error / errorScale; };
+}
+
+// Walks the curve over the enclosing power of two square and skips the points outside the grid,
+// which keeps neighbours adjacent except where the curve leaves and reenters the grid
+std::vector<glm::uvec2> TileScheduler::HilbertOrder(const glm::uvec2& count)
+{
+	uint32_t side = 1;
+	while (side < count.x || side < count.y)
+		side *= 2;
+
+	std::vector<glm::uvec2> order;
+	order.reserve(count.x * count.y);
+	for (uint64_t d = 0; d < uint64_t(side) * side; d++)
+	{
+		glm::uvec2 p(0);
+		uint64_t t = d;
+		for (uint32_t s = 1; s < side; s *= 2)
+		{
+			const uint32_t rx = 1 & static_cast<uint32_t>(t / 2);
+			const uint32_t ry = 1 & static_cast<uint32_t>(t ^ rx);
+			if (ry == 0)
+			{
+				if (rx == 1)
+					p = glm::uvec2(s - 1) - p;
+				std::swap(p.x, p.y);
+			}
+			p += glm::uvec2(s * rx, s * ry);
+			t /= 4;
+		}
+		if (p.x < count.x && p.y < count.y)
+			order.push_back(p);
+	}
+	return order;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "Core.h"
+
+#include <functional>
+
+struct TileRect
+{
+	glm::uvec2 Min = glm::uvec2(0);
+	glm::uvec2 Max = glm::uvec2(0);
+
+	bool Overlaps(const TileRect& other) const;
+};
+
+struct TileInfo
+{
+	TileRect Bounds;
+	// Visits since the last reset and the relative change of the tile mean on the last one
+	uint32_t Visits = 0;
+	float Error = 1.0f;
+	// Grows by 1 / priority with every visit, the tiles furthest behind are scheduled first
+	float VirtualTime = 0.0f;
+	float Priority = 1.0f;
+	// Set by Invalidate, the next visit starts the accumulation of the tile over
+	bool ResetPending = false;
+};
+
+// Everything that decides the next schedules, Order breaks ties between equally urgent tiles
+struct TileSchedulerState
+{
+	std::vector<TileInfo> Tiles;
+	std::vector<uint32_t> Order;
+};
+
+// Hands out the tiles of the progressive passes in priority order. Every tile advances its
+// virtual time by the inverse of its priority per visit, so a tile with twice the priority is
+// visited twice as often, and ties at the start go to the more important tile. Priorities are
+// clamped to MinPriority, which keeps the rest of the image converging in the background
+struct TileScheduler
+{
+	using PriorityFunction = std::function<float(const TileInfo&)>;
+
+	TileScheduler() = default;
+
+	void Reset(const glm::uvec2& size, uint32_t tileSize);
+	void SetPriority(PriorityFunction priority);
+
+	// Up to count distinct tiles for the next frame, most urgent first
+	const std::vector<uint32_t>& Schedule(uint32_t count);
+	void ReportError(uint32_t tile, float error);
+	// Restarts all tiles overlapping the region and moves them to the front of the queue
+	void Invalidate(const TileRect& region);
+	// Whether the tile has to discard its accumulation on this visit, clears the flag
+	bool ConsumeReset(uint32_t tile);
+
+	// Saves and restores the schedule for checkpoints. The state must come from a scheduler of
+	// the same size and tile size, false if it does not fit
+	TileSchedulerState GetState() const;
+	bool SetState(TileSchedulerState state);
+
+	inline uint32_t Size() const { return static_cast<uint32_t>(Tiles.size()); }
+	inline uint32_t GetTileSize() const { return TileSize; }
+	inline const TileInfo& operator[](size_t i) const { return Tiles[i]; }
+
+	// Close to 1 around the focus point and falling off with the squared distance in tiles
+	static PriorityFunction FocusPriority(const glm::vec2& focus, float radius);
+	// Full priority for tiles that overlap one of the regions
+	static PriorityFunction RegionPriority(std::vector<TileRect> regions);
+	// Tiles whose mean still changes a lot between visits
+	static PriorityFunction ErrorPriority();
+	// Every tile of a count.x x count.y grid once, each one next to the one before, so that a
+	// walk touches few distinct rows and columns of tiles at any time
+	static std::vector<glm::uvec2> HilbertOrder(const glm::uvec2& count);
+
+	static constexpr float MinPriority = 0.05f;
+
+private:
+	void UpdatePriorities();
+	float GetVirtualTime() const;
+
+private:
+	std::vector<TileInfo> Tiles;
+	std::vector<uint32_t> Order;
+	std::vector<uint32_t> Scheduled;
+	PriorityFunction Priority;
+	uint32_t TileSize = 64;
+};
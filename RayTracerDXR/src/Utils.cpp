@@ -2,6 +2,7 @@
 #include "Shader.h"
 #include "Sphere.h"
 
+#include <algorithm>
 #include <locale>
 #include <codecvt>
 
@@ -31,10 +32,9 @@ std::string wstring_2_string(const std::wstring& ws)
 	return s;
 }
 
-std::vector<glm::vec3> GenerateTextureData(const glm::uvec2& dims)
+std::vector<glm::vec3> GenerateTextureData(const glm::uvec2& dims, uint32_t seed)
 {
-	std::random_device r;
-	std::mt19937 gen(r());
+	std::mt19937 gen(seed);
 	std::uniform_real_distribution<float> distr(-1.0f, 1.0f);
 	std::vector<glm::vec3> v(dims.x * dims.y);
 	for (auto& element : v)
@@ -155,6 +155,76 @@ namespace D3D
 														initState, nullptr, IID_PPV_ARGS(&buffer)));
 		return buffer;
 	}
+
+	ID3D12ResourcePtr CreateTexture2D(ID3D12Device5Ptr device,
+									  const glm::uvec2& size,
+									  DXGI_FORMAT format,
+									  D3D12_RESOURCE_FLAGS flags,
+									  D3D12_RESOURCE_STATES initState)
+	{
+		D3D12_RESOURCE_DESC desc{};
+		desc.DepthOrArraySize = 1;
+		desc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+		desc.Format = format;
+		desc.Flags = flags;
+		desc.Width = size.x;
+		desc.Height = size.y;
+		desc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
+		desc.MipLevels = 1;
+		desc.SampleDesc.Count = 1;
+		desc.SampleDesc.Quality = 0;
+
+		ID3D12ResourcePtr texture;
+		GRAPHICS_ASSERT(device->CreateCommittedResource(&DefaultHeapProps, D3D12_HEAP_FLAG_NONE, &desc,
+														initState, nullptr, IID_PPV_ARGS(&texture)));
+		return texture;
+	}
+
+	void UploadRing::Initialize(ID3D12Device5Ptr device, uint32_t slotCount)
+	{
+		Device = device;
+		Slots.resize(slotCount);
+		Current = 0;
+	}
+
+	void UploadRing::Begin(uint32_t slot)
+	{
+		Current = slot;
+		Slot& current = Slots[Current];
+		current.Outgrown.clear();
+		current.Used = 0;
+		if (current.Capacity > RetainedCapacity)
+		{
+			current.Buffer = nullptr;
+			current.Mapped = nullptr;
+			current.Capacity = 0;
+		}
+	}
+
+	void UploadRing::Copy(ID3D12GraphicsCommandList4Ptr cmdList, ID3D12ResourcePtr dest, uint64_t offset, const void* data, uint64_t size)
+	{
+		if (size == 0)
+			return;
+
+		Slot& current = Slots[Current];
+		current.Used = (current.Used + 15) & ~15ull;
+		if (current.Used + size > current.Capacity)
+		{
+			// Copies recorded earlier in the frame still read the old buffer
+			if (current.Buffer)
+				current.Outgrown.push_back(current.Buffer);
+			current.Capacity = std::max({ size, 2 * current.Capacity, MinCapacity });
+			current.Buffer = CreateBuffer(Device, current.Capacity, D3D12_RESOURCE_FLAG_NONE,
+										  D3D12_RESOURCE_STATE_GENERIC_READ, UploadHeapProps);
+			D3D12_RANGE read{ 0, 0 };
+			current.Buffer->Map(0, &read, (void**)&current.Mapped);
+			current.Used = 0;
+		}
+
+		std::memcpy(current.Mapped + current.Used, data, size);
+		cmdList->CopyBufferRegion(dest, offset, current.Buffer, current.Used, size);
+		current.Used += size;
+	}
 }
 
 namespace DXR
@@ -200,47 +270,34 @@ namespace DXR
 		return buffers;
 	}
 
-	AccelerationStructureBuffers CreateTopLevelAS(ID3D12Device5Ptr device,
-												  ID3D12GraphicsCommandList4Ptr cmdList,
-												  ID3D12ResourcePtr bottomLevelAS,
-												  SphereComposite& spheres,
-												  uint64_t& tLasSize)
+	static D3D12_RAYTRACING_INSTANCE_DESC GetInstanceDesc(ID3D12ResourcePtr bottomLevelAS, const Sphere& sphere, uint32_t index)
 	{
-		D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS inputs{};
-		inputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
-		inputs.Flags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_NONE;
-		inputs.NumDescs = spheres.Size();
-		inputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL;
+		D3D12_RAYTRACING_INSTANCE_DESC instanceDesc{};
+		instanceDesc.InstanceID = index;
+		instanceDesc.InstanceContributionToHitGroupIndex = 0;
+		instanceDesc.Flags = D3D12_RAYTRACING_INSTANCE_FLAG_NONE;
+		glm::mat4 m = sphere.GetInstanceTransform();
+		std::memcpy(instanceDesc.Transform, &m, sizeof(instanceDesc.Transform));
+		instanceDesc.AccelerationStructure = bottomLevelAS->GetGPUVirtualAddress();
+		instanceDesc.InstanceMask = 0xFF;
+		return instanceDesc;
+	}
 
-		D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO info{};
-		device->GetRaytracingAccelerationStructurePrebuildInfo(&inputs, &info);
+	static std::vector<D3D12_RAYTRACING_INSTANCE_DESC> GetInstanceDescs(ID3D12ResourcePtr bottomLevelAS,
+																		 const SphereComposite& spheres)
+	{
+		std::vector<D3D12_RAYTRACING_INSTANCE_DESC> instanceDesc(spheres.Size(), D3D12_RAYTRACING_INSTANCE_DESC{});
 
-		AccelerationStructureBuffers buffers;
-		buffers.Scratch = D3D::CreateBuffer(device, info.ScratchDataSizeInBytes, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D::DefaultHeapProps);
-		buffers.Result = D3D::CreateBuffer(device, info.ResultDataMaxSizeInBytes, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE, D3D::DefaultHeapProps);
-		tLasSize = info.ResultDataMaxSizeInBytes;
+		for (uint32_t i = 0; i < spheres.Size(); i++)
+			instanceDesc[i] = GetInstanceDesc(bottomLevelAS, spheres[i], i);
 
-		buffers.InstanceDesc = D3D::CreateAndInitializeBuffer(device, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_GENERIC_READ,
-															  D3D::UploadHeapProps,
-															  [&spheres, &bottomLevelAS]()
-															  {
-																  std::vector<D3D12_RAYTRACING_INSTANCE_DESC> instanceDesc(spheres.Size(),
-																  D3D12_RAYTRACING_INSTANCE_DESC{});
-
-																  for (uint32_t i = 0; i < spheres.Size(); i++)
-																  {
-																	instanceDesc[i].InstanceID = i;
-																	instanceDesc[i].InstanceContributionToHitGroupIndex = 0;
-																	instanceDesc[i].Flags = D3D12_RAYTRACING_INSTANCE_FLAG_NONE;
-																	glm::mat4 m = spheres[i].GetInstanceTransform();
-																	std::memcpy(instanceDesc[i].Transform, &m, sizeof(instanceDesc[i].Transform));
-																	instanceDesc[i].AccelerationStructure = bottomLevelAS->GetGPUVirtualAddress();
-																	instanceDesc[i].InstanceMask = 0xFF;
-																  }
-
-																  return instanceDesc;
-															  });
+		return instanceDesc;
+	}
 
+	static void BuildTopLevelAS(ID3D12GraphicsCommandList4Ptr cmdList,
+								const D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS& inputs,
+								const AccelerationStructureBuffers& buffers)
+	{
 		D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC asDesc{};
 		asDesc.Inputs = inputs;
 		asDesc.Inputs.InstanceDescs = buffers.InstanceDesc->GetGPUVirtualAddress();
@@ -253,8 +310,62 @@ namespace DXR
 		barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
 		barrier.UAV.pResource = buffers.Result;
 		cmdList->ResourceBarrier(1, &barrier);
+	}
+
+	static D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS GetTopLevelInputs(const SphereComposite& spheres)
+	{
+		D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS inputs{};
+		inputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
+		inputs.Flags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_NONE;
+		inputs.NumDescs = spheres.Size();
+		inputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL;
+		return inputs;
+	}
+
+	AccelerationStructureBuffers CreateTopLevelAS(ID3D12Device5Ptr device,
+												  ID3D12GraphicsCommandList4Ptr cmdList,
+												  ID3D12ResourcePtr bottomLevelAS,
+												  SphereComposite& spheres,
+												  D3D::UploadRing& uploads,
+												  uint64_t& tLasSize)
+	{
+		D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS inputs = GetTopLevelInputs(spheres);
 
+		D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO info{};
+		device->GetRaytracingAccelerationStructurePrebuildInfo(&inputs, &info);
+
+		AccelerationStructureBuffers buffers;
+		buffers.Scratch = D3D::CreateBuffer(device, info.ScratchDataSizeInBytes, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D::DefaultHeapProps);
+		buffers.Result = D3D::CreateBuffer(device, info.ResultDataMaxSizeInBytes, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE, D3D::DefaultHeapProps);
+		tLasSize = info.ResultDataMaxSizeInBytes;
+
+		buffers.InstanceDesc = D3D::CreateBuffer(device, sizeof(D3D12_RAYTRACING_INSTANCE_DESC) * spheres.Size(), D3D12_RESOURCE_FLAG_NONE,
+												 D3D12_RESOURCE_STATE_COMMON, D3D::DefaultHeapProps);
+		uploads.Write(cmdList, buffers.InstanceDesc, GetInstanceDescs(bottomLevelAS, spheres));
+
+		BuildTopLevelAS(cmdList, inputs, buffers);
 		return buffers;
 	}
 
+	void UpdateTopLevelAS(ID3D12GraphicsCommandList4Ptr cmdList,
+						  ID3D12ResourcePtr bottomLevelAS,
+						  const SphereComposite& spheres,
+						  const SphereChanges& changes,
+						  const AccelerationStructureBuffers& buffers,
+						  D3D::UploadRing& uploads)
+	{
+		std::vector<D3D12_RAYTRACING_INSTANCE_DESC> instanceDescs;
+		D3D::ResourceBarrier(cmdList, buffers.InstanceDesc, D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_COPY_DEST);
+		for (const SphereRange& range : changes.Ranges)
+		{
+			instanceDescs.clear();
+			for (uint32_t i = range.Begin; i < range.End; i++)
+				instanceDescs.push_back(GetInstanceDesc(bottomLevelAS, spheres[i], i));
+			uploads.Copy(cmdList, buffers.InstanceDesc, sizeof(D3D12_RAYTRACING_INSTANCE_DESC) * range.Begin, instanceDescs.data(),
+						 sizeof(D3D12_RAYTRACING_INSTANCE_DESC) * instanceDescs.size());
+		}
+		D3D::ResourceBarrier(cmdList, buffers.InstanceDesc, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+		BuildTopLevelAS(cmdList, GetTopLevelInputs(spheres), buffers);
+	}
+
 }
\ No newline at end of file
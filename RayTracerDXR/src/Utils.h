@@ -10,6 +10,9 @@
 // Globals
 constexpr const uint32_t NumUserDescriptorRanges = 16;
 constexpr const uint32_t NumGlobalSRVDescriptorRanges = 7 + NumUserDescriptorRanges;
+constexpr const uint32_t NumUserUAVDescriptorRanges = 8;
+constexpr const uint32_t NumGlobalUAVDescriptorRanges = 1 + NumUserUAVDescriptorRanges;
+constexpr const uint32_t NumUAVDescriptors = 64;
 
 extern ID3D12CommandQueuePtr CmdQueue;
 extern ID3D12GraphicsCommandList4Ptr CmdList;
@@ -42,7 +45,8 @@ std::string convertBlobToString(BlotType* pBlob)
 	return std::string(infoLog.data());
 }
 
-std::vector<glm::vec3> GenerateTextureData(const glm::uvec2& dims);
+// Uniform in [-1, 1], the same seed always gives the same texture
+std::vector<glm::vec3> GenerateTextureData(const glm::uvec2& dims, uint32_t seed);
 
 template<typename T>
 concept IsContainer = requires(T container)
@@ -78,6 +82,15 @@ namespace D3D
 		0,
 	};
 
+	static const D3D12_HEAP_PROPERTIES ReadbackHeapProps =
+	{
+		D3D12_HEAP_TYPE_READBACK,
+		D3D12_CPU_PAGE_PROPERTY_UNKNOWN,
+		D3D12_MEMORY_POOL_UNKNOWN,
+		0,
+		0,
+	};
+
 	ID3D12DescriptorHeapPtr CreateDescriptorHeap(ID3D12Device5Ptr device,
 												 uint32_t count,
 												 D3D12_DESCRIPTOR_HEAP_TYPE type,
@@ -110,6 +123,12 @@ namespace D3D
 								   D3D12_RESOURCE_STATES initState,
 								   const D3D12_HEAP_PROPERTIES& heapProperties);
 
+	ID3D12ResourcePtr CreateTexture2D(ID3D12Device5Ptr device,
+									  const glm::uvec2& size,
+									  DXGI_FORMAT format,
+									  D3D12_RESOURCE_FLAGS flags,
+									  D3D12_RESOURCE_STATES initState);
+
 	template<typename Fn, typename... Args>
 	requires ValidResourceFactory<Fn, Args...>
 	ID3D12ResourcePtr CreateAndInitializeBuffer(ID3D12Device5Ptr device,
@@ -130,11 +149,58 @@ namespace D3D
 		return pBuffer;
 	}
 
+	// Upload buffer per frame in flight, through which CPU data is copied into default heap buffers
+	// on the command list. Frames still in flight keep reading what the buffers held when they were
+	// recorded, a slot is only written again once the frame that used it has completed
+	struct UploadRing
+	{
+		void Initialize(ID3D12Device5Ptr device, uint32_t slotCount);
+		// Starts the uploads of the frame that uses the slot, the last frame that used it has to be
+		// complete
+		void Begin(uint32_t slot);
+		// dest has to be in the COPY_DEST state
+		void Copy(ID3D12GraphicsCommandList4Ptr cmdList, ID3D12ResourcePtr dest, uint64_t offset, const void* data, uint64_t size);
+
+		// Overwrites the start of a buffer that is in the COMMON state buffers decay to between
+		// command lists, and leaves it in state
+		template<IsContainer Container>
+		void Write(ID3D12GraphicsCommandList4Ptr cmdList, ID3D12ResourcePtr dest, const Container& data,
+				   D3D12_RESOURCE_STATES state = D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE)
+		{
+			using Type = Container::value_type;
+
+			ResourceBarrier(cmdList, dest, D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_COPY_DEST);
+			Copy(cmdList, dest, 0, data.data(), sizeof(Type) * data.size());
+			ResourceBarrier(cmdList, dest, D3D12_RESOURCE_STATE_COPY_DEST, state);
+		}
+
+	private:
+		struct Slot
+		{
+			ID3D12ResourcePtr Buffer;
+			uint8_t* Mapped = nullptr;
+			uint64_t Capacity = 0;
+			uint64_t Used = 0;
+			// Buffers the slot outgrew during its frame, released once the frame has completed
+			std::vector<ID3D12ResourcePtr> Outgrown;
+		};
+
+		// Slots that grew beyond it for a one-off upload, e.g. the scene at load, give the memory back
+		static constexpr uint64_t RetainedCapacity = 16 << 20;
+		static constexpr uint64_t MinCapacity = 64 << 10;
+
+		ID3D12Device5Ptr Device;
+		std::vector<Slot> Slots;
+		uint32_t Current = 0;
+	};
+
+	// Waits for the upload, state is the one the texture is in before and after it
 	template<IsContainer Container>
 	void UploadTexture(ID3D12Device5Ptr device,
 					   ID3D12CommandAllocatorPtr cmdAllocator,
 					   ID3D12ResourcePtr destResource,
-					   const Container& data)
+					   const Container& data,
+					   D3D12_RESOURCE_STATES state = D3D12_RESOURCE_STATE_GENERIC_READ)
 	{
 		using Type = Container::value_type;
 		const uint64_t uploadBufferSize = GetRequiredIntermediateSize(destResource, 0, 1);
@@ -156,9 +222,9 @@ namespace D3D
 		textureData.RowPitch = textureDesc.Width * sizeof(Type);
 		textureData.SlicePitch = textureData.RowPitch * textureDesc.Height;
 
-		CmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(destResource, D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_COPY_DEST));
+		CmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(destResource, state, D3D12_RESOURCE_STATE_COPY_DEST));
 		UpdateSubresources(CmdList, destResource, stagingBuffer, 0, 0, 1, &textureData);
-		CmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(destResource, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ));
+		CmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(destResource, D3D12_RESOURCE_STATE_COPY_DEST, state));
 
 		FenceValue = D3D::SubmitCommandList(CmdList, CmdQueue, Fence, FenceValue);
 		Fence->SetEventOnCompletion(FenceValue, FenceEvent);
@@ -170,6 +236,7 @@ namespace D3D
 
 struct RootSignatureDesc;
 struct SphereComposite;
+struct SphereChanges;
 
 namespace DXR
 {
@@ -188,6 +255,17 @@ namespace DXR
 												  ID3D12GraphicsCommandList4Ptr cmdList,
 												  ID3D12ResourcePtr bottomLevelAS,
 												  SphereComposite& spheres,
+												  D3D::UploadRing& uploads,
 												  uint64_t& tLasSize);
 
+	// Copies the instances of the changed spheres and rebuilds the top level structure in place,
+	// after the frames in flight on the queue. The number of spheres must be the one it was created
+	// with
+	void UpdateTopLevelAS(ID3D12GraphicsCommandList4Ptr cmdList,
+						  ID3D12ResourcePtr bottomLevelAS,
+						  const SphereComposite& spheres,
+						  const SphereChanges& changes,
+						  const AccelerationStructureBuffers& buffers,
+						  D3D::UploadRing& uploads);
+
 }
\ No newline at end of file
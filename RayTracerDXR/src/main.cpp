@@ -1,11 +1,47 @@
 #include "Window.h"
 
 #include "Application.h"
+#include "SceneArchive.h"
+#include "SceneGenerator.h"
 #include "Utils.h"
 
 int WINAPI WinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _In_ LPSTR lpCmdLine, _In_ int nShowCmd)
 {
-	Application::Init(800, 600, GetModuleHandle(nullptr), "Direct X Ray Tracing");
+	// RayTracerDXR [scene] renders a JSON scene or a scene archive,
+	// RayTracerDXR --convert scene.json scene.rtscene writes the archive of a JSON scene,
+	// RayTracerDXR --generate count uniform|clustered|layered seed [scene.rtscene] renders a
+	// generated scene or writes its archive
+	const std::vector<std::string> arguments(__argv + 1, __argv + __argc);
+
+	Scene scene = Scene::Default();
+	std::string error;
+	if (arguments.size() == 3 && arguments[0] == "--convert")
+	{
+		const bool converted = scene.Load(arguments[1], error) && SceneArchive::Write(arguments[2], scene, error);
+		OutputDebugStringA(converted ? ("Wrote " + arguments[2] + "\n").c_str() : (error + "\n").c_str());
+		return converted ? 0 : 1;
+	}
+	if ((arguments.size() == 4 || arguments.size() == 5) && arguments[0] == "--generate")
+	{
+		const std::string distributions[] = { "uniform", "clustered", "layered" };
+		const auto distribution = std::find(std::begin(distributions), std::end(distributions), arguments[2]);
+		scene = GenerateScene(SceneGeneratorSettings{
+			.Seed = std::strtoull(arguments[3].c_str(), nullptr, 10),
+			.SphereCount = std::strtoull(arguments[1].c_str(), nullptr, 10),
+			.Distribution = distribution != std::end(distributions) ?
+				static_cast<SceneDistribution>(distribution - std::begin(distributions)) : SceneDistribution::Uniform });
+		if (arguments.size() == 5)
+		{
+			const bool written = SceneArchive::Write(arguments[4], scene, error);
+			OutputDebugStringA(written ? ("Wrote " + arguments[4] + "\n").c_str() : (error + "\n").c_str());
+			return written ? 0 : 1;
+		}
+	}
+	else if (!arguments.empty() && !scene.Load(arguments[0], error))
+		OutputDebugStringA((error + ", using the default scene\n").c_str());
+
+	const glm::uvec2 size = glm::all(glm::notEqual(scene.Settings.Resolution, glm::uvec2(0))) ? scene.Settings.Resolution : glm::uvec2(800, 600);
+	Application::Init(size.x, size.y, GetModuleHandle(nullptr), "Direct X Ray Tracing", scene);
 
 	int msg{ 0 };
 	EXCEPTION_WRAP(
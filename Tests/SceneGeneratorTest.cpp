@@ -0,0 +1,63 @@
+#include "SceneGenerator.h"
+
+#include <algorithm>
+#include <cstdio>
+
+// Generated scenes may only depend on the settings, not on how many threads generate them. The
+// counts cross the ranges the generator hands to its threads, 1 << 16 spheres each, so that
+// every thread count splits the work differently
+namespace
+{
+	constexpr uint64_t SpheresPerRange = 1 << 16;
+	constexpr uint32_t ThreadCounts[] = { 0, 2, 3, 7 };
+
+	bool IsSame(const Sphere& a, const Sphere& b)
+	{
+		return a.Center == b.Center && a.Radius == b.Radius && a.Albedo == b.Albedo && a.Type == b.Type &&
+			a.MaterialIndex == b.MaterialIndex;
+	}
+
+	bool IsSame(const Scene& a, const Scene& b)
+	{
+		return a.Materials.size() == b.Materials.size() &&
+			std::equal(a.Spheres.begin(), a.Spheres.end(), b.Spheres.begin(), b.Spheres.end(),
+					   [](const Sphere& x, const Sphere& y) { return IsSame(x, y); });
+	}
+}
+
+int main()
+{
+	uint32_t failures = 0;
+	uint32_t scenes = 0;
+	for (const SceneDistribution distribution : { SceneDistribution::Uniform, SceneDistribution::Clustered, SceneDistribution::Layered })
+	{
+		for (const uint64_t count : { SpheresPerRange - 1, SpheresPerRange + 4, 3 * SpheresPerRange + 1234 })
+		{
+			SceneGeneratorSettings settings{ .Seed = 42, .SphereCount = count, .Distribution = distribution,
+											 .EmissiveWeight = 0.05f, .ThreadCount = 1 };
+			const Scene serial = GenerateScene(settings);
+			if (serial.Spheres.size() != count)
+				failures++;
+
+			for (const uint32_t threads : ThreadCounts)
+			{
+				settings.ThreadCount = threads;
+				if (!IsSame(GenerateScene(settings), serial))
+				{
+					std::printf("Distribution %u, %llu spheres, %u threads differ from one thread\n",
+								static_cast<uint32_t>(distribution), static_cast<unsigned long long>(count), threads);
+					failures++;
+				}
+			}
+
+			// The seed has to matter, or the comparison above proves nothing
+			settings.Seed = 43;
+			if (IsSame(GenerateScene(settings), serial))
+				failures++;
+			scenes++;
+		}
+	}
+
+	std::printf("SceneGeneratorTest: %u failures in %u scenes\n", failures, scenes);
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,118 @@
+#include "SceneSnapshot.h"
+
+#include <cstdio>
+#include <thread>
+
+// Writers, readers and a reclaiming thread run against the same snapshots. Every published sphere
+// keeps Center.x equal to its Radius, so a reader that sees a freed or half written version finds
+// a sphere that breaks it. Run it with the address sanitizer to catch use after free directly
+namespace
+{
+	constexpr uint32_t SphereCount = 3 * SceneSnapshot::ChunkSize + 100;
+	constexpr uint32_t WriterCount = 4;
+	constexpr uint32_t ReaderCount = 4;
+	constexpr uint32_t PublishesPerWriter = 2000;
+	constexpr uint32_t EditsPerPublish = 8;
+
+	Sphere MakeSphere(float value)
+	{
+		return Sphere(glm::vec3(value, 0.0f, 0.0f), value);
+	}
+
+	bool IsConsistent(const Sphere& sphere)
+	{
+		return sphere.Center.x == sphere.Radius;
+	}
+}
+
+int main()
+{
+	std::vector<Sphere> spheres(SphereCount, MakeSphere(1.0f));
+	SceneSnapshots snapshots(spheres, true, 1);
+
+	std::atomic<bool> writing{ true };
+	std::atomic<uint32_t> failures{ 0 };
+	std::vector<std::thread> threads;
+
+	// Every writer owns the spheres with index % WriterCount == writer, and all of them share the
+	// first chunk through the sphere with their own index, so publishes race for it constantly
+	for (uint32_t writer = 0; writer < WriterCount; writer++)
+	{
+		threads.emplace_back([&, writer]()
+		{
+			for (uint32_t publish = 1; publish <= PublishesPerWriter; publish++)
+			{
+				std::vector<SphereEdit> edits{ SphereEdit{ .Index = writer, .Value = MakeSphere(float(publish)) } };
+				for (uint32_t edit = 1; edit < EditsPerPublish; edit++)
+				{
+					const uint32_t index = ((publish * 7919 + edit * 104729) % (SphereCount / WriterCount)) * WriterCount + writer;
+					edits.push_back(SphereEdit{ .Index = index, .Value = MakeSphere(float(publish)) });
+				}
+				if (snapshots.Publish(edits) == 0)
+					failures++;
+			}
+		});
+	}
+
+	for (uint32_t reader = 0; reader < ReaderCount; reader++)
+	{
+		threads.emplace_back([&]()
+		{
+			uint64_t lastVersion = 0;
+			while (writing)
+			{
+				const SnapshotPin snapshot = snapshots.Pin();
+				if (snapshot->Version < lastVersion || snapshot->Size != SphereCount)
+					failures++;
+				lastVersion = snapshot->Version;
+				// Hold the pin for a while like a frame does, so that writers retire it meanwhile
+				std::this_thread::yield();
+				for (uint32_t i = 0; i < snapshot->Size; i += 61)
+				{
+					if (!IsConsistent((*snapshot)[i]))
+						failures++;
+				}
+			}
+		});
+	}
+
+	threads.emplace_back([&]()
+	{
+		while (writing)
+			snapshots.Reclaim();
+	});
+
+	for (uint32_t writer = 0; writer < WriterCount; writer++)
+		threads[writer].join();
+	writing = false;
+	for (size_t i = WriterCount; i < threads.size(); i++)
+		threads[i].join();
+
+	// No edit may get lost when a writer loses the race and publishes again
+	const SnapshotPin last = snapshots.Pin();
+	if (last->Version != WriterCount * PublishesPerWriter)
+		failures++;
+	for (uint32_t writer = 0; writer < WriterCount; writer++)
+	{
+		if ((*last)[writer].Radius != float(PublishesPerWriter))
+			failures++;
+	}
+
+	// Invalid edits are rejected with the whole batch they are in
+	Sphere light = MakeSphere(2.0f);
+	light.Type = MaterialType::Emissive;
+	Sphere unknownMaterial = MakeSphere(2.0f);
+	unknownMaterial.MaterialIndex = 1;
+	for (const SphereEdit& invalid : { SphereEdit{ .Index = SphereCount, .Value = MakeSphere(2.0f) },
+									   SphereEdit{ .Index = 1, .Value = light },
+									   SphereEdit{ .Index = 1, .Value = unknownMaterial } })
+	{
+		const SphereEdit batch[] = { SphereEdit{ .Index = 0, .Value = MakeSphere(2.0f) }, invalid };
+		if (snapshots.Publish(batch) != 0 || snapshots.Pin()->Version != last->Version)
+			failures++;
+	}
+
+	std::printf("SceneSnapshotTest: %u failures in %llu versions\n", failures.load(),
+				static_cast<unsigned long long>(last->Version));
+	return failures == 0 ? 0 : 1;
+}
@@ -67,3 +67,69 @@ project "RayTracerDXR"
         {
             "NDEBUG"
         }
+
+-- Console programs over the renderer sources without its entry point, one per file in Tests
+function TestProject(name)
+    project(name)
+        location "Tests"
+        kind "ConsoleApp"
+        language "C++"
+        cppdialect "C++latest"
+        staticruntime "off"
+        floatingpoint "fast"
+        conformancemode "off"
+
+        targetdir ("bin/")
+        objdir ("bin-int/" .. OutputDir .. "/%{prj.name}")
+
+        includedirs
+        {
+            "RayTracerDXR/src",
+            "%{wks.location}/ThirdParty/core",
+            "%{wks.location}/ThirdParty/dxc",
+            "%{wks.location}/ThirdParty/glm"
+        }
+
+        links
+        {
+            "d3d12.lib",
+            "DXGI.lib",
+            "dxguid.lib"
+        }
+
+        files
+        {
+            "Tests/" .. name .. ".cpp",
+            "RayTracerDXR/src/**.h",
+            "RayTracerDXR/src/**.cpp"
+        }
+
+        removefiles
+        {
+            "RayTracerDXR/src/main.cpp"
+        }
+
+        filter "configurations:Debug"
+            runtime "Debug"
+            symbols "on"
+            sanitize { "Address" }
+            targetname "%{prj.name}_d"
+
+        filter "configurations:Release"
+            runtime "Release"
+            symbols "on"
+            targetname "%{prj.name}"
+            optimize "Full"
+
+            defines
+            {
+                "NDEBUG"
+            }
+
+        filter {}
+end
+
+-- Stress test of the scene snapshots, the sanitizer of the debug build catches use after free
+TestProject("SceneSnapshotTest")
+-- Generated scenes have to be the same for every thread count
+TestProject("SceneGeneratorTest")